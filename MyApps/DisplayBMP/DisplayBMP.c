@@ -1,7 +1,7 @@
 //
 //  Copyright (c) 2015-2019   Finnbarr P. Murphy.   All rights reserved.
 //
-//  Display an uncompressed BMP image 
+//  Display an uncompressed or RLE compressed BMP image 
 //
 //  License: BSD 2 clause License
 //
@@ -29,9 +29,32 @@
 
 #include <IndustryStandard/Bmp.h>
 
+#include <Library/BmpDecodeLib.h>
+#include <Library/TscTimerLib.h>
+
 #define UTILITY_VERSION L"20190201"
 #undef DEBUG
 
+//
+// Conversion from blt pixels to the framebuffer format of the current mode.
+// Each color channel is looked up in a table holding its value already
+// scaled and shifted into place for the mode's mask.
+//
+typedef struct {
+    UINT8        *Base;                 // Gop->Mode->FrameBufferBase
+    UINTN        Stride;                // bytes per scan line
+    UINTN        BytesPerPixel;
+    UINTN        Height;                // visible scan lines
+    BOOLEAN      Direct;                // BGRX, rows are copied unchanged
+    CONST CHAR16 *FormatName;
+    UINT8        *LineBuffer;           // one converted row
+    UINT32       Red[256];
+    UINT32       Green[256];
+    UINT32       Blue[256];
+} FRAME_BUFFER;
+
+FRAME_BUFFER GopFrameBuffer;
+
 EFI_GRAPHICS_OUTPUT_BLT_PIXEL EfiGraphicsColors[16] = {
     // B    G    R   reserved
     {0x00, 0x00, 0x00, 0x00},  // BLACK
@@ -97,116 +120,256 @@ AsciiToUnicodeSize( CHAR8 *String,
 
 
 //
-// Display the BMP image, convert to 24-bit if necessary, scroll screen if necessary
+// Size to display the image at: as is, scaled by Scale percent, or with Fit
+// as large as fits the screen less the margins, keeping the aspect ratio.
+// Scale is ignored with Fit; the command line does not allow both.
 //
 EFI_STATUS
-DisplayImage( EFI_GRAPHICS_OUTPUT_PROTOCOL *Gop, 
-              EFI_HANDLE *BmpBuffer )
+GetImageSize( EFI_GRAPHICS_OUTPUT_PROTOCOL *Gop,
+              EFI_HANDLE *BmpBuffer,
+              BOOLEAN Fit,
+              UINTN Scale,
+              UINTN *ImageWidth,
+              UINTN *ImageHeight )
 {
     EFI_GRAPHICS_OUTPUT_MODE_INFORMATION *Info;
-    EFI_GRAPHICS_OUTPUT_BLT_PIXEL Background;
-    EFI_GRAPHICS_OUTPUT_BLT_PIXEL *BltBuffer;
-    EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Blt;
-    BMP_IMAGE_HEADER *BmpHeader;
-    BMP_COLOR_MAP *BmpColorMap;
-    EFI_STATUS Status = EFI_SUCCESS;
-    UINT32 *Palette;
-    UINT8  *BitmapData;
-    UINT8  *Image;
-    UINT8  *ImageHeader;
+    BMP_IMAGE_HEADER *BmpHeader = (BMP_IMAGE_HEADER *) BmpBuffer;
     UINTN  SizeOfInfo;
-    UINTN  Pixels;
-    UINTN  Width, Height;
-    UINTN  ImageIndex;
-    UINTN  Index;
-    UINTN  ImageHeight;
-    UINTN  ImageRows;
-    UINTN  CurRow, CurCol;
-    UINTN  MaxRows, MaxCols;
-    UINTN  VertPixelDelta = 0;		
-    UINTN  ImagePixelDelta = 0;		
+    UINTN  MaxWidth, MaxHeight;
 
-    if (BmpBuffer == NULL) {
-        return RETURN_INVALID_PARAMETER;
+    Gop->QueryMode( Gop, 
+                    Gop->Mode->Mode, 
+                    &SizeOfInfo, 
+                    &Info );
+
+    MaxWidth  = Info->HorizontalResolution - EFI_GLYPH_WIDTH*5;
+    MaxHeight = Info->VerticalResolution - EFI_GLYPH_HEIGHT*5;
+
+    if (Fit) {
+        *ImageWidth  = MaxWidth;
+        *ImageHeight = (UINTN)(((UINT64)BmpHeader->PixelHeight * MaxWidth) / BmpHeader->PixelWidth);
+        if (*ImageHeight > MaxHeight) {
+            *ImageHeight = MaxHeight;
+            *ImageWidth  = (UINTN)(((UINT64)BmpHeader->PixelWidth * MaxHeight) / BmpHeader->PixelHeight);
+        }
+    } else {
+        *ImageWidth  = (UINTN)(((UINT64)BmpHeader->PixelWidth * Scale) / 100);
+        *ImageHeight = (UINTN)(((UINT64)BmpHeader->PixelHeight * Scale) / 100);
     }
+    *ImageWidth  = MAX( *ImageWidth, 1 );
+    *ImageHeight = MAX( *ImageHeight, 1 );
 
-    BmpHeader  = (BMP_IMAGE_HEADER *) BmpBuffer;
-    BitmapData = (UINT8*)BmpBuffer + BmpHeader->ImageOffset;
-    Palette    = (UINT32*) ((UINT8*)BmpBuffer + 0x36);
-    Pixels     = BmpHeader->PixelWidth * BmpHeader->PixelHeight;
+    // image size less than screen size
+    if ((*ImageWidth > MaxWidth) || (*ImageHeight > MaxHeight)) {
+        Print(L"ERROR: Image too big for screen at current resolution\n");
+        return EFI_UNSUPPORTED;
+    }
 
-    BltBuffer = AllocateZeroPool( sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL) * Pixels);
-    if (BltBuffer == NULL) {
-        Print(L"ERROR: BltBuffer. No memory resources\n");
+    return EFI_SUCCESS;
+}
+
+
+//
+// Table of Value << Shift for every 8-bit channel value, scaled to the
+// width of Mask
+//
+VOID
+InitChannelTable( UINT32 *Table,
+                  UINT32 Mask )
+{
+    INTN Shift = LowBitSet32( Mask );
+    INTN Bits = HighBitSet32( Mask ) - Shift + 1;
+
+    for (UINT32 Value = 0; Value < 256; Value++) {
+        if (Bits >= 8) {
+            Table[Value] = ((Value << (Bits - 8)) << Shift) & Mask;
+        } else {
+            Table[Value] = ((Value >> (8 - Bits)) << Shift) & Mask;
+        }
+    }
+}
+
+
+//
+// Set up direct writes to the framebuffer for the current mode. Returns
+// EFI_UNSUPPORTED for PixelBltOnly modes, which must go through Gop->Blt.
+//
+EFI_STATUS
+InitFrameBuffer( EFI_GRAPHICS_OUTPUT_PROTOCOL *Gop,
+                 FRAME_BUFFER *FrameBuffer )
+{
+    EFI_GRAPHICS_OUTPUT_MODE_INFORMATION *Info = Gop->Mode->Info;
+    EFI_PIXEL_BITMASK Masks;
+    UINT32 AllMasks;
+
+    ZeroMem( FrameBuffer, sizeof(FRAME_BUFFER) );
+
+    if (Gop->Mode->FrameBufferBase == 0) {
+        return EFI_UNSUPPORTED;
+    }
+
+    switch (Info->PixelFormat) {
+        case PixelBlueGreenRedReserved8BitPerColor:
+            Masks.RedMask      = 0x00ff0000;
+            Masks.GreenMask    = 0x0000ff00;
+            Masks.BlueMask     = 0x000000ff;
+            Masks.ReservedMask = 0xff000000;
+            FrameBuffer->Direct = TRUE;
+            FrameBuffer->FormatName = L"BGRX";
+            break;
+        case PixelRedGreenBlueReserved8BitPerColor:
+            Masks.RedMask      = 0x000000ff;
+            Masks.GreenMask    = 0x0000ff00;
+            Masks.BlueMask     = 0x00ff0000;
+            Masks.ReservedMask = 0xff000000;
+            FrameBuffer->FormatName = L"RGBX";
+            break;
+        case PixelBitMask:
+            Masks = Info->PixelInformation;
+            FrameBuffer->FormatName = L"bit mask";
+            break;
+        default:
+            return EFI_UNSUPPORTED;
+    }
+
+    if (Masks.RedMask == 0 || Masks.GreenMask == 0 || Masks.BlueMask == 0) {
+        return EFI_UNSUPPORTED;
+    }
+
+    // the highest mask bit sets the pixel size
+    AllMasks = Masks.RedMask | Masks.GreenMask | Masks.BlueMask | Masks.ReservedMask;
+    FrameBuffer->BytesPerPixel = ((UINTN)HighBitSet32( AllMasks ) + 8) / 8;
+    FrameBuffer->Stride = Info->PixelsPerScanLine * FrameBuffer->BytesPerPixel;
+    FrameBuffer->Height = Info->VerticalResolution;
+    FrameBuffer->Base = (UINT8 *)(UINTN)Gop->Mode->FrameBufferBase;
+
+    InitChannelTable( FrameBuffer->Red, Masks.RedMask );
+    InitChannelTable( FrameBuffer->Green, Masks.GreenMask );
+    InitChannelTable( FrameBuffer->Blue, Masks.BlueMask );
+
+    FrameBuffer->LineBuffer = AllocatePool( Info->HorizontalResolution * FrameBuffer->BytesPerPixel );
+    if (FrameBuffer->LineBuffer == NULL) {
         return EFI_OUT_OF_RESOURCES;
     }
 
-    Image       = (UINT8 *)BmpBuffer;
-    BmpColorMap = (BMP_COLOR_MAP *) (Image + sizeof (BMP_IMAGE_HEADER));
+    return EFI_SUCCESS;
+}
+
+
+//
+// Write Height rows of Width blt pixels, Delta bytes apart, to the
+// framebuffer at column 0, row DestY. Rows are converted into the line
+// buffer and copied out whole, so that the framebuffer, which is often
+// uncached or write combining, only sees wide sequential stores.
+//
+VOID
+WriteFrameBuffer( FRAME_BUFFER *FrameBuffer,
+                  EFI_GRAPHICS_OUTPUT_BLT_PIXEL *BltBuffer,
+                  UINTN DestY,
+                  UINTN Width,
+                  UINTN Height,
+                  UINTN Delta )
+{
+    EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Src;
+    UINT8  *Dst;
+    UINT8  *Line = FrameBuffer->LineBuffer;
+    UINTN  BytesPerPixel = FrameBuffer->BytesPerPixel;
+    UINT32 Pixel;
+
+    if (DestY >= FrameBuffer->Height) {
+        return;
+    }
+    Height = MIN( Height, FrameBuffer->Height - DestY );
+    if (Delta == 0) {
+        Delta = Width * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL);
+    }
+
+    Dst = FrameBuffer->Base + DestY * FrameBuffer->Stride;
+    for (UINTN y = 0; y < Height; y++, Dst += FrameBuffer->Stride) {
+        Src = (EFI_GRAPHICS_OUTPUT_BLT_PIXEL *)((UINT8 *)BltBuffer + y * Delta);
 
-    Image       = ((UINT8 *)BmpBuffer) + BmpHeader->ImageOffset;
-    ImageHeader = Image;
-
-    // fill blt buffer
-    for (Height = 0; Height < BmpHeader->PixelHeight; Height++) {
-        Blt = &BltBuffer[(BmpHeader->PixelHeight - Height - 1) * BmpHeader->PixelWidth];
-        for (Width = 0; Width < BmpHeader->PixelWidth; Width++, Image++, Blt++) {
-            switch (BmpHeader->BitPerPixel) {
-                case 1:                                 // Convert 1-bit BMP to 24-bit color
-                    for (Index = 0; Index < 8 && Width < BmpHeader->PixelWidth; Index++) {
-                        Blt->Blue  = BmpColorMap[((*Image) >> (7 - Index)) & 0x1].Blue;
-                        Blt->Green = BmpColorMap[((*Image) >> (7 - Index)) & 0x1].Green;
-                        Blt->Red   = BmpColorMap[((*Image) >> (7 - Index)) & 0x1].Red;
-                        Blt++; Width++;
-                    }
-                    Blt--; Width--;
-                    break;
-
-                case 4:                                 // Convert 4-bit BMP Palette to 24-bit color
-                    Index      = (*Image) >> 4;
-                    Blt->Blue  = BmpColorMap[Index].Blue;
-                    Blt->Green = BmpColorMap[Index].Green;
-                    Blt->Red   = BmpColorMap[Index].Red;
-                    if (Width < (BmpHeader->PixelWidth - 1)) {
-                        Blt++; Width++;
-                        Index      = (*Image) & 0x0f;
-                        Blt->Blue  = BmpColorMap[Index].Blue;
-                        Blt->Green = BmpColorMap[Index].Green;
-                        Blt->Red   = BmpColorMap[Index].Red;
-                    }
-                    break;
-
-                case 8:                                 // Convert 8-bit BMP palette to 24-bit color
-                    Blt->Blue  = BmpColorMap[*Image].Blue;
-                    Blt->Green = BmpColorMap[*Image].Green;
-                    Blt->Red   = BmpColorMap[*Image].Red;
-                    break;
-
-                case 24:                                // No conversion needed
-                    Blt->Blue  = *Image++;
-                    Blt->Green = *Image++;
-                    Blt->Red   = *Image;
-                    break;
-
-                case 32:                                // Convert to 24-bit by ignoring final byte of each pixel.
-                    Blt->Blue  = *Image++;
-                    Blt->Green = *Image++;
-                    Blt->Red   = *Image++;
-                    break;
-
-                default:
-                    FreePool(BltBuffer);
-                    return EFI_UNSUPPORTED;
-                    break;
-            };
+        if (FrameBuffer->Direct) {
+            CopyMem( Dst, Src, Width * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL) );
+            continue;
         }
 
-        // start each row on a 32-bit boundary!
-        ImageIndex = (UINTN)Image - (UINTN)ImageHeader;
-        if ((ImageIndex % 4) != 0) {
-             Image = Image + (4 - (ImageIndex % 4));
+        if (BytesPerPixel == 4) {
+            for (UINTN x = 0; x < Width; x++) {
+                ((UINT32 *)Line)[x] = FrameBuffer->Red[Src[x].Red] |
+                                      FrameBuffer->Green[Src[x].Green] |
+                                      FrameBuffer->Blue[Src[x].Blue];
+            }
+        } else {
+            for (UINTN x = 0; x < Width; x++) {
+                Pixel = FrameBuffer->Red[Src[x].Red] |
+                        FrameBuffer->Green[Src[x].Green] |
+                        FrameBuffer->Blue[Src[x].Blue];
+                for (UINTN Byte = 0; Byte < BytesPerPixel; Byte++) {
+                    Line[x * BytesPerPixel + Byte] = (UINT8)(Pixel >> (Byte * 8));
+                }
+            }
         }
+        CopyMem( Dst, Line, Width * BytesPerPixel );
     }
+}
+
+
+//
+// Display Height rows of Width blt pixels, Delta bytes apart, at column 0,
+// row DestY, directly in the framebuffer if there is one or else by Gop->Blt
+//
+EFI_STATUS
+DrawImage( EFI_GRAPHICS_OUTPUT_PROTOCOL *Gop,
+           FRAME_BUFFER *FrameBuffer,
+           EFI_GRAPHICS_OUTPUT_BLT_PIXEL *BltBuffer,
+           UINTN DestY,
+           UINTN Width,
+           UINTN Height,
+           UINTN Delta )
+{
+    EFI_STATUS Status = EFI_SUCCESS;
+
+    if (FrameBuffer != NULL) {
+        WriteFrameBuffer( FrameBuffer, BltBuffer, DestY, Width, Height, Delta );
+        return Status;
+    }
+
+    Status = Gop->Blt( Gop,
+                       BltBuffer,
+                       EfiBltBufferToVideo,
+                       0, 0,                      // Source X,Y 
+                       0, DestY,                  // Destination X,Y 
+                       Width, Height, 
+                       Delta );
+    if (EFI_ERROR (Status)) {
+        Print(L"ERROR: Image Display Gop->Blt [%d]\n", Status);
+    } 
+
+    return Status;
+}
+
+
+//
+// Make room below the cursor for an image ImageHeight pixels high, scrolling
+// the screen up if necessary. Returns the pixel row to display the image at
+// and the text row to leave the cursor on afterwards.
+//
+EFI_STATUS
+MakeImageRoom( EFI_GRAPHICS_OUTPUT_PROTOCOL *Gop, 
+               UINTN ImageHeight,
+               UINTN *DestY,
+               UINTN *CursorRow )
+{
+    EFI_GRAPHICS_OUTPUT_MODE_INFORMATION *Info;
+    EFI_GRAPHICS_OUTPUT_BLT_PIXEL Background;
+    EFI_STATUS Status = EFI_SUCCESS;
+    UINTN  SizeOfInfo;
+    UINTN  Width;
+    UINTN  ImageRows;
+    UINTN  CurRow, CurCol;
+    UINTN  MaxRows, MaxCols;
+    UINTN  VertPixelDelta = 0;		
+    UINTN  ImagePixelDelta = 0;		
 
     // get max rows and columns for current mode
     gST->ConOut->QueryMode( gST->ConOut,
@@ -227,7 +390,6 @@ DisplayImage( EFI_GRAPHICS_OUTPUT_PROTOCOL *Gop,
 
     // calculate required image and screen properties
     Width  = Info->HorizontalResolution;
-    ImageHeight = BmpHeader->PixelHeight;
     ImageRows = ImageHeight/EFI_GLYPH_HEIGHT;
     if ((ImageRows * EFI_GLYPH_HEIGHT) < ImageHeight) {
         ImagePixelDelta = (ImageHeight - (ImageRows * EFI_GLYPH_HEIGHT))/2;
@@ -258,7 +420,7 @@ DisplayImage( EFI_GRAPHICS_OUTPUT_PROTOCOL *Gop,
                            0 );
         if (EFI_ERROR (Status)) {
             Print(L"ERROR: Scroll Up, Gop->Blt [%d]\n", Status);
-            goto cleanup;
+            return Status;
         } 
 
         // color background of the scrolled area
@@ -271,41 +433,233 @@ DisplayImage( EFI_GRAPHICS_OUTPUT_PROTOCOL *Gop,
                            0 );
         if (EFI_ERROR (Status)) {
             Print(L"ERROR: Color Fill, Gop->Blt [%d]\n", Status);
-            goto cleanup;
+            return Status;
         } 
 
-        // display the image
-        Status = Gop->Blt( Gop,
-                           BltBuffer,
-                           EfiBltBufferToVideo,
-                           0, 0,                                                              // Source X,Y 
-                           0, ImagePixelDelta + ((MaxRows - ImageRows) * EFI_GLYPH_HEIGHT),   // Destination X,Y
-                           BmpHeader->PixelWidth, BmpHeader->PixelHeight, 
-                           0 );
-        if (EFI_ERROR (Status)) {
-            Print(L"ERROR: Image Display Gop->Blt [%d]\n", Status);
+        *DestY = ImagePixelDelta + ((MaxRows - ImageRows) * EFI_GLYPH_HEIGHT);
+        *CursorRow = MaxRows - 1;
+    } else {
+        *DestY = ImagePixelDelta + ((CurRow + 1) * EFI_GLYPH_HEIGHT);
+        *CursorRow = CurRow + ImageRows;
+    }
+
+    return Status;
+}
+
+
+//
+// Display the BMP image, convert to 24-bit if necessary, scroll screen if necessary
+//
+EFI_STATUS
+DisplayImage( EFI_GRAPHICS_OUTPUT_PROTOCOL *Gop, 
+              FRAME_BUFFER *FrameBuffer,
+              EFI_HANDLE *BmpBuffer,
+              UINTN ImageWidth,
+              UINTN ImageHeight,
+              UINT32 ScaleFlags,
+              BOOLEAN Timing )
+{
+    EFI_GRAPHICS_OUTPUT_BLT_PIXEL *BltBuffer;
+    BMP_IMAGE_HEADER *BmpHeader;
+    BMP_DECODER Decoder;
+    EFI_STATUS Status = EFI_SUCCESS;
+    UINTN  DestY;
+    UINTN  CursorRow;
+    UINT64 DecodeTicks;
+    UINT64 DrawTicks;
+    UINT64 BltTicks = 0;
+    UINT64 PortableTicks = 0;
+
+    if (BmpBuffer == NULL) {
+        return RETURN_INVALID_PARAMETER;
+    }
+
+    BmpHeader = (BMP_IMAGE_HEADER *) BmpBuffer;
+
+    // picks the row converter for the bit depth once for the whole image
+    Status = BmpDecoderInit( &Decoder, BmpBuffer, BmpHeader->Size, 0 );
+    if (EFI_ERROR (Status)) {
+        Print(L"ERROR: Unsupported or truncated BMP image [%r]\n", Status);
+        return Status;
+    }
+
+    BltBuffer = AllocatePool( sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL) * ImageWidth * ImageHeight );
+    if (BltBuffer == NULL) {
+        Print(L"ERROR: BltBuffer. No memory resources\n");
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    // fill blt buffer, scaling row by row if the size differs
+    DecodeTicks = AsmReadTsc();
+    Status = BmpScaleImage( &Decoder, ImageWidth, ImageHeight, ScaleFlags, BltBuffer );
+    DecodeTicks = AsmReadTsc() - DecodeTicks;
+    if (EFI_ERROR (Status)) {
+        Print(L"ERROR: Decoding %s image data [%r]\n", Decoder.ConverterName, Status);
+        goto cleanup;
+    }
+
+    if (Timing) {
+        PortableTicks = BmpTimePortableDecode( BmpBuffer, BmpHeader->Size,
+                                               ImageWidth, ImageHeight, ScaleFlags, BltBuffer );
+    }
+
+    // scroll the screen if necessary to make room below the cursor
+    Status = MakeImageRoom( Gop, ImageHeight, &DestY, &CursorRow );
+    if (EFI_ERROR (Status)) {
+        goto cleanup;
+    }
+
+    // display the image
+    DrawTicks = AsmReadTsc();
+    Status = DrawImage( Gop, FrameBuffer, BltBuffer, DestY, ImageWidth, ImageHeight, 0 );
+    DrawTicks = AsmReadTsc() - DrawTicks;
+    if (EFI_ERROR (Status)) {
+        goto cleanup;
+    } 
+    SetCursorPosition( 0, CursorRow );
+
+    // draw the same pixels again with Gop->Blt for comparison
+    if (Timing && FrameBuffer != NULL) {
+        BltTicks = AsmReadTsc();
+        DrawImage( Gop, NULL, BltBuffer, DestY, ImageWidth, ImageHeight, 0 );
+        BltTicks = AsmReadTsc() - BltTicks;
+    }
+
+    if (Timing) {
+        UINT64 Frequency = TscFrequency();
+
+        Print(L"Decode: %ld us (%s, %d x %d to %d x %d)  Portable: %ld us",
+              TscToMicroseconds( DecodeTicks, Frequency ), Decoder.ConverterName,
+              Decoder.Width, Decoder.Height, ImageWidth, ImageHeight,
+              TscToMicroseconds( PortableTicks, Frequency ));
+        if (FrameBuffer != NULL) {
+            Print(L"  Framebuffer: %ld us (%s)  Blt: %ld us\n",
+                  TscToMicroseconds( DrawTicks, Frequency ), FrameBuffer->FormatName,
+                  TscToMicroseconds( BltTicks, Frequency ));
+        } else {
+            Print(L"  Blt: %ld us\n", TscToMicroseconds( DrawTicks, Frequency ));
+        }
+    }
+
+cleanup:
+    FreePool(BltBuffer);
+
+    return Status;
+}
+
+
+//
+// Display an uncompressed BMP image read from the file BandRows rows at a
+// time, bottom up as stored, so that only one band of file data and of blt
+// pixels is held in memory rather than the whole file and image
+//
+EFI_STATUS
+StreamImage( EFI_GRAPHICS_OUTPUT_PROTOCOL *Gop, 
+             FRAME_BUFFER *FrameBuffer,
+             SHELL_FILE_HANDLE FileHandle,
+             EFI_HANDLE *BmpBuffer,
+             UINTN BandRows,
+             BOOLEAN Timing )
+{
+    EFI_GRAPHICS_OUTPUT_BLT_PIXEL *BltBuffer = NULL;
+    BMP_IMAGE_HEADER *BmpHeader;
+    BMP_DECODER Decoder;
+    EFI_STATUS Status = EFI_SUCCESS;
+    UINT8  *BandBuffer = NULL;
+    UINTN  DestY;
+    UINTN  CursorRow;
+    UINTN  Top;
+    UINTN  Rows;
+    UINTN  ReadSize;
+    UINT64 Ticks;
+    UINT64 ReadTicks = 0;
+    UINT64 DecodeTicks = 0;
+    UINT64 DrawTicks = 0;
+
+    if (BmpBuffer == NULL || BandRows == 0) {
+        return RETURN_INVALID_PARAMETER;
+    }
+
+    BmpHeader = (BMP_IMAGE_HEADER *) BmpBuffer;
+
+    // only the header and color map are in memory
+    Status = BmpDecoderInit( &Decoder, BmpBuffer, BmpHeader->ImageOffset, BMP_DECODE_HEADER_ONLY );
+    if (EFI_ERROR (Status)) {
+        Print(L"ERROR: Only uncompressed BMP images can be streamed [%r]\n", Status);
+        return Status;
+    }
+
+    BandRows = MIN( BandRows, Decoder.Height );
+    BandBuffer = AllocatePool( Decoder.RowSize * BandRows );
+    BltBuffer = AllocatePool( sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL) * Decoder.Width * BandRows );
+    if (BandBuffer == NULL || BltBuffer == NULL) {
+        Print(L"ERROR: Band buffers. No memory resources\n");
+        Status = EFI_OUT_OF_RESOURCES;
+        goto cleanup;
+    }
+
+    Status = ShellSetFilePosition( FileHandle, BmpHeader->ImageOffset );
+    if (EFI_ERROR (Status)) {
+        Print(L"ERROR: ShellSetFilePosition failed [%d]\n", Status);
+        goto cleanup;
+    }
+
+    // scroll the screen if necessary to make room below the cursor
+    Status = MakeImageRoom( Gop, Decoder.Height, &DestY, &CursorRow );
+    if (EFI_ERROR (Status)) {
+        goto cleanup;
+    }
+
+    // Top is the first image row below the bands still to be displayed
+    for (Top = Decoder.Height; Top > 0; Top -= Rows) {
+        Rows = MIN( BandRows, Top );
+
+        Ticks = AsmReadTsc();
+        ReadSize = Decoder.RowSize * Rows;
+        Status = ShellReadFile( FileHandle,
+                                &ReadSize,
+                                BandBuffer );
+        ReadTicks += AsmReadTsc() - Ticks;
+        if (EFI_ERROR (Status) || ReadSize != Decoder.RowSize * Rows) {
+            Print(L"ERROR: ShellReadFile failed or image data truncated [%d]\n", Status);
+            Status = EFI_ERROR (Status) ? Status : EFI_END_OF_FILE;
             goto cleanup;
-        } 
+        }
 
-        SetCursorPosition(  0, MaxRows - 1 );
-    } else {
-        // just display the image
-        Status = Gop->Blt( Gop,
-                           BltBuffer,
-                           EfiBltBufferToVideo,
-                           0, 0,                                                        // Source X,Y 
-                           0, ImagePixelDelta + ((CurRow + 1) * EFI_GLYPH_HEIGHT),      // Destination X,Y 
-                           BmpHeader->PixelWidth, BmpHeader->PixelHeight, 
-                           0 );
+        Ticks = AsmReadTsc();
+        BmpDecodeBand( &Decoder, BandBuffer, Rows, BltBuffer );
+        DecodeTicks += AsmReadTsc() - Ticks;
+
+        // Delta is the stride of the band buffer
+        Ticks = AsmReadTsc();
+        Status = DrawImage( Gop, FrameBuffer, BltBuffer, DestY + Top - Rows, Decoder.Width, Rows,
+                            Decoder.Width * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL) );
+        DrawTicks += AsmReadTsc() - Ticks;
         if (EFI_ERROR (Status)) {
-            Print(L"ERROR: Image Display Gop->Blt [%d]\n", Status);
             goto cleanup;
         } 
-        SetCursorPosition(  0, CurRow + ImageRows );
+    }
+    SetCursorPosition( 0, CursorRow );
+
+    if (Timing) {
+        UINT64 Frequency = TscFrequency();
+
+        Print(L"Read: %ld us  Decode: %ld us (%s, %d x %d, %d row bands)  %s: %ld us  Buffers: %d KB\n",
+              TscToMicroseconds( ReadTicks, Frequency ),
+              TscToMicroseconds( DecodeTicks, Frequency ), Decoder.ConverterName,
+              Decoder.Width, Decoder.Height, BandRows,
+              (FrameBuffer != NULL) ? L"Framebuffer" : L"Blt",
+              TscToMicroseconds( DrawTicks, Frequency ),
+              (BandRows * (Decoder.RowSize + Decoder.Width * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL)) + 1023) / 1024);
     }
 
 cleanup:
-    FreePool(BltBuffer);
+    if (BandBuffer != NULL) {
+        FreePool( BandBuffer );
+    }
+    if (BltBuffer != NULL) {
+        FreePool( BltBuffer );
+    }
 
     return Status;
 }
@@ -351,7 +705,6 @@ CheckBMPHeader( EFI_GRAPHICS_OUTPUT_PROTOCOL *Gop,
                 EFI_HANDLE *BmpBuffer,
                 INTN   BmpImageSize )
 {
-    EFI_GRAPHICS_OUTPUT_MODE_INFORMATION *Info;
     BMP_IMAGE_HEADER *BmpHeader;
     BMP_COLOR_MAP *BmpColorMap;
     EFI_STATUS Status = EFI_SUCCESS;
@@ -359,7 +712,6 @@ CheckBMPHeader( EFI_GRAPHICS_OUTPUT_PROTOCOL *Gop,
     UINT32 ColorMapNum;
     UINT32 DataSize;
     UINT32 DataSizePerLine;
-    UINTN  SizeOfInfo;
     UINT8  *Image;
 
     // check parameters
@@ -386,9 +738,11 @@ CheckBMPHeader( EFI_GRAPHICS_OUTPUT_PROTOCOL *Gop,
         return EFI_UNSUPPORTED;
     }
 
-    // compression type not 0
-    if (BmpHeader->CompressionType != 0) {
-        Print(L"ERROR: Compression type not 0\n");
+    // compression type 0, or RLE8 or RLE4 at the matching bit depth
+    if (BmpHeader->CompressionType != BMP_COMPRESSION_NONE &&
+        !(BmpHeader->CompressionType == BMP_COMPRESSION_RLE8 && BmpHeader->BitPerPixel == 8) &&
+        !(BmpHeader->CompressionType == BMP_COMPRESSION_RLE4 && BmpHeader->BitPerPixel == 4)) {
+        Print(L"ERROR: Compression type not 0, RLE8 or RLE4\n");
         return EFI_UNSUPPORTED;
     }
 
@@ -433,7 +787,8 @@ CheckBMPHeader( EFI_GRAPHICS_OUTPUT_PROTOCOL *Gop,
 
     if ((BmpHeader->Size != BmpImageSize) || 
         (BmpHeader->Size < BmpHeader->ImageOffset) ||
-        (BmpHeader->Size - BmpHeader->ImageOffset !=  DataSize)) {
+        (BmpHeader->CompressionType == BMP_COMPRESSION_NONE &&
+         BmpHeader->Size - BmpHeader->ImageOffset !=  DataSize)) {
         Print(L"ERROR: Invalid image size\n");
         return EFI_UNSUPPORTED;
     }
@@ -467,26 +822,13 @@ CheckBMPHeader( EFI_GRAPHICS_OUTPUT_PROTOCOL *Gop,
         }
     }
 
-    // image size less than screen size
-    Gop->QueryMode( Gop, 
-                    Gop->Mode->Mode, 
-                    &SizeOfInfo, 
-                    &Info );
-
-    if ((BmpHeader->PixelWidth > (Info->HorizontalResolution - EFI_GLYPH_WIDTH*5)) || 
-        (BmpHeader->PixelHeight > (Info->VerticalResolution - EFI_GLYPH_HEIGHT*5))) {
-            Print(L"ERROR: Image too big for screen at current resolution\n");
-            return EFI_UNSUPPORTED;
-    }
-
     // supported bits per pixel
     if (BmpHeader->BitPerPixel != 1 &&
+        BmpHeader->BitPerPixel != 4 &&
         BmpHeader->BitPerPixel != 8 &&
-        BmpHeader->BitPerPixel != 8 &&
-        BmpHeader->BitPerPixel != 12 &&
         BmpHeader->BitPerPixel != 24 &&
         BmpHeader->BitPerPixel != 32) {
-        Print(L"ERROR: BitPerPixel is not one of 1, 4, 8, 12, 24 or 32\n");
+        Print(L"ERROR: BitPerPixel is not one of 1, 4, 8, 24 or 32\n");
         return EFI_UNSUPPORTED;
     }
 
@@ -494,6 +836,57 @@ CheckBMPHeader( EFI_GRAPHICS_OUTPUT_PROTOCOL *Gop,
 }
 
 
+//
+// Read only the header and color map of a BMP file, for streaming
+//
+EFI_STATUS
+ReadBMPHeader( SHELL_FILE_HANDLE FileHandle,
+               EFI_HANDLE **BmpBuffer )
+{
+    BMP_IMAGE_HEADER BmpHeader;
+    EFI_STATUS Status;
+    UINTN  ReadSize;
+
+    ReadSize = sizeof (BMP_IMAGE_HEADER);
+    Status = ShellReadFile( FileHandle,
+                            &ReadSize,
+                            &BmpHeader );
+    if (EFI_ERROR (Status)) {
+        Print(L"ERROR: ShellReadFile failed [%d]\n", Status);
+        return Status;
+    }
+    if (ReadSize < sizeof (BMP_IMAGE_HEADER)) {
+        Print(L"ERROR: BmpImageSize too small\n");
+        return EFI_INVALID_PARAMETER;
+    }
+
+    // at most a 256 entry color map precedes the pixel data
+    if ((BmpHeader.ImageOffset < sizeof (BMP_IMAGE_HEADER)) ||
+        (BmpHeader.ImageOffset > sizeof (BMP_IMAGE_HEADER) + 256 * sizeof (BMP_COLOR_MAP))) {
+        Print(L"ERROR: Invalid colormap offset\n");
+        return EFI_UNSUPPORTED;
+    }
+
+    *BmpBuffer = AllocateZeroPool( BmpHeader.ImageOffset );
+    if (*BmpBuffer == NULL) {
+        Print(L"ERROR: File buffer. No memory resources\n");
+        return EFI_OUT_OF_RESOURCES;
+    }
+    CopyMem( *BmpBuffer, &BmpHeader, sizeof (BMP_IMAGE_HEADER) );
+
+    ReadSize = BmpHeader.ImageOffset - sizeof (BMP_IMAGE_HEADER);
+    Status = ShellReadFile( FileHandle,
+                            &ReadSize,
+                            (UINT8 *)*BmpBuffer + sizeof (BMP_IMAGE_HEADER) );
+    if (EFI_ERROR (Status) || ReadSize != BmpHeader.ImageOffset - sizeof (BMP_IMAGE_HEADER)) {
+        Print(L"ERROR: ShellReadFile failed or colormap truncated [%d]\n", Status);
+        return EFI_ERROR (Status) ? Status : EFI_END_OF_FILE;
+    }
+
+    return EFI_SUCCESS;
+}
+
+
 VOID
 Usage( BOOLEAN ErrorMsg )
 {
@@ -501,7 +894,8 @@ Usage( BOOLEAN ErrorMsg )
         Print(L"ERROR: Unknown option(s).\n");
     }
 
-    Print(L"Usage: DisplayBMP [-v | --verbose] BMPfile\n"); 
+    Print(L"Usage: DisplayBMP [-v | --verbose] [-t | --timing] [--blt] [--fit | --scale N] [--nearest] BMPfile\n"); 
+    Print(L"       DisplayBMP [-v | --verbose] [-t | --timing] [--blt] --stream N BMPfile\n"); 
     Print(L"       DisplayBMP [-V | --version]\n"); 
 }
 
@@ -512,6 +906,7 @@ ShellAppMain( UINTN Argc,
               CHAR16 **Argv )
 {
     EFI_GRAPHICS_OUTPUT_PROTOCOL *Gop;
+    FRAME_BUFFER                 *Screen = NULL;
     EFI_DEVICE_PATH_PROTOCOL     *Dpp;
     SHELL_FILE_HANDLE            FileHandle;
     EFI_FILE_INFO                *FileInfo = NULL;
@@ -519,33 +914,63 @@ ShellAppMain( UINTN Argc,
     EFI_HANDLE                   *Handles = NULL;
     EFI_HANDLE                   *FileBuffer = NULL;
     BOOLEAN                      Verbose = FALSE;
+    BOOLEAN                      Timing = FALSE;
+    BOOLEAN                      Fit = FALSE;
+    BOOLEAN                      Scaled = FALSE;
+    BOOLEAN                      Stream = FALSE;
+    BOOLEAN                      BltOnly = FALSE;
+    UINT32                       ScaleFlags = 0;
+    UINTN                        Scale = 100;
+    UINTN                        BandRows = 0;
+    UINTN                        ImageWidth;
+    UINTN                        ImageHeight;
     UINTN                        HandleCount = 0;
     UINTN                        FileSize;
 
-    if (Argc == 2) {
-        if (!StrCmp(Argv[1], L"--version") ||
-            !StrCmp(Argv[1], L"-V")) {
+    if (Argc < 2) {
+        Usage(FALSE);
+        return Status;
+    }
+
+    for (UINTN i = 1; i < Argc; i++) {
+        if (!StrCmp(Argv[i], L"--version") ||
+            !StrCmp(Argv[i], L"-V")) {
             Print(L"Version: %s\n", UTILITY_VERSION);
             return Status;
-        } else if (!StrCmp(Argv[1], L"--help") ||
-            !StrCmp(Argv[1], L"-h")) {
+        } else if (!StrCmp(Argv[i], L"--help") ||
+            !StrCmp(Argv[i], L"-h")) {
             Usage(FALSE);
             return Status;
-        } else if (Argv[1][0] == L'-') {
-            Usage(TRUE);
-            return Status;
-        }
-    } else if (Argc == 3) {
-        if (!StrCmp(Argv[1], L"--verbose") ||
-            !StrCmp(Argv[1], L"-v")) {
+        } else if (!StrCmp(Argv[i], L"--verbose") ||
+            !StrCmp(Argv[i], L"-v")) {
             Verbose = TRUE;
-        } else if (Argv[1][0] == L'-') {
-            Usage(FALSE);
+        } else if (!StrCmp(Argv[i], L"--timing") ||
+            !StrCmp(Argv[i], L"-t")) {
+            Timing = TRUE;
+        } else if (!StrCmp(Argv[i], L"--fit")) {
+            Fit = TRUE;
+        } else if (!StrCmp(Argv[i], L"--scale") && i + 2 < Argc) {
+            Scale = StrDecimalToUintn( Argv[++i] );
+            if (Scale == 0) {
+                Print(L"ERROR: Scale must be a percentage greater than 0\n");
+                return Status;
+            }
+            Scaled = TRUE;
+        } else if (!StrCmp(Argv[i], L"--stream") && i + 2 < Argc) {
+            BandRows = StrDecimalToUintn( Argv[++i] );
+            if (BandRows == 0) {
+                Print(L"ERROR: Stream band must be at least 1 row\n");
+                return Status;
+            }
+            Stream = TRUE;
+        } else if (!StrCmp(Argv[i], L"--blt")) {
+            BltOnly = TRUE;
+        } else if (!StrCmp(Argv[i], L"--nearest")) {
+            ScaleFlags |= BMP_SCALE_NEAREST;
+        } else if (Argv[i][0] == L'-' || i != Argc - 1) {
+            Usage(TRUE);
             return Status;
         }
-    } else {
-        Usage(FALSE);
-        return Status;
     }
 
     // Check last argument is not an option!  
@@ -554,6 +979,18 @@ ShellAppMain( UINTN Argc,
         return Status;
     }
 
+    // --fit picks the size itself, so a scale can not also be given
+    if (Fit && Scaled) {
+        Usage(TRUE);
+        return Status;
+    }
+
+    // bands are displayed as read, so can not be scaled
+    if (Stream && (Fit || Scaled)) {
+        Usage(TRUE);
+        return Status;
+    }
+
     // Open the file (has to be LAST arguement on command line)
     Status = ShellOpenFileByName( Argv[Argc - 1], 
                                   &FileHandle,
@@ -563,25 +1000,35 @@ ShellAppMain( UINTN Argc,
         return Status;
     }            
 
-    // Allocate buffer for file contents
     FileInfo = ShellGetFileInfo( FileHandle );    
-    FileBuffer = AllocateZeroPool( (UINTN)FileInfo->FileSize );
-    if (FileBuffer == NULL) {
-        Print(L"ERROR: File buffer. No memory resources\n");
-        return (SHELL_OUT_OF_RESOURCES);   
-    }
-
-    // Read file contents into allocated buffer
     FileSize = (UINTN) FileInfo->FileSize;
-    Status = ShellReadFile( FileHandle,
-                            &FileSize,
-                            FileBuffer );
-    if (EFI_ERROR (Status)) {
-        Print(L"ERROR: ShellReadFile failed [%d]\n", Status);
-        goto cleanup;
-    }            
+
+    if (Stream) {
+        // the file stays open, pixel data is read a band at a time
+        Status = ReadBMPHeader( FileHandle, &FileBuffer );
+        if (EFI_ERROR (Status)) {
+            goto cleanup;
+        }
+    } else {
+        // Allocate buffer for file contents
+        FileBuffer = AllocateZeroPool( FileSize );
+        if (FileBuffer == NULL) {
+            Print(L"ERROR: File buffer. No memory resources. Try --stream N\n");
+            ShellCloseFile( &FileHandle );
+            return (SHELL_OUT_OF_RESOURCES);   
+        }
+
+        // Read file contents into allocated buffer
+        Status = ShellReadFile( FileHandle,
+                                &FileSize,
+                                FileBuffer );
+        if (EFI_ERROR (Status)) {
+            Print(L"ERROR: ShellReadFile failed [%d]\n", Status);
+            goto cleanup;
+        }            
   
-    ShellCloseFile( &FileHandle );
+        ShellCloseFile( &FileHandle );
+    }
 
     // Try locating GOP by handle
     Status = gBS->LocateHandleBuffer( ByProtocol,
@@ -628,9 +1075,31 @@ ShellAppMain( UINTN Argc,
         PrintBMPHeader( FileBuffer );
     }
 
-    DisplayImage( Gop, FileBuffer );
+    Status = GetImageSize( Gop, FileBuffer, Fit, Scale, &ImageWidth, &ImageHeight );
+    if (EFI_ERROR (Status)) {
+        goto cleanup;
+    }
+
+    // write the framebuffer directly unless the mode is PixelBltOnly
+    if (!BltOnly && !EFI_ERROR (InitFrameBuffer( Gop, &GopFrameBuffer ))) {
+        Screen = &GopFrameBuffer;
+    }
+
+    if (Stream) {
+        StreamImage( Gop, Screen, FileHandle, FileBuffer, BandRows, Timing );
+    } else {
+        DisplayImage( Gop, Screen, FileBuffer, ImageWidth, ImageHeight, ScaleFlags, Timing );
+    }
     
 cleanup:
-    FreePool( FileBuffer );
+    if (Stream) {
+        ShellCloseFile( &FileHandle );
+    }
+    if (FileBuffer != NULL) {
+        FreePool( FileBuffer );
+    }
+    if (GopFrameBuffer.LineBuffer != NULL) {
+        FreePool( GopFrameBuffer.LineBuffer );
+    }
     return Status;
 }
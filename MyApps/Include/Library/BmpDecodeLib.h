@@ -0,0 +1,151 @@
+//
+//  Copyright (c) 2015 - 2019   Finnbarr P. Murphy.   All rights reserved.
+//
+//  BMP decoding library shared by DisplayBMP and ShowBGRT
+//
+//  Converts the rows of an uncompressed 1, 4, 8, 24 or 32 bit BMP into
+//  EFI_GRAPHICS_OUTPUT_BLT_PIXELs. The row converter for the image's bit
+//  depth is chosen once, when the decoder is initialized, rather than
+//  per pixel. On X64 the 24 and 32 bit converters use SSSE3 and SSE2.
+//
+//  RLE8 and RLE4 compressed images are decoded as a stream directly into
+//  the blt buffer.
+//
+//  Images can also be decoded to a different size, reduced with a box
+//  filter or enlarged with a bilinear or nearest neighbour filter.
+//
+//  A decoder can be set up from the header and color map alone, with the
+//  caller reading the pixel rows of an uncompressed image in bands, so
+//  that large images need not be held in memory whole.
+//
+//  License: BSD 2 clause License
+//
+
+#ifndef _BMP_DECODE_LIB_H_
+#define _BMP_DECODE_LIB_H_
+
+#include <Protocol/GraphicsOutput.h>
+
+#include <IndustryStandard/Bmp.h>
+
+// BmpDecoderInit() flags
+#define BMP_DECODE_PORTABLE      0x0001     // do not use the SIMD row converters
+#define BMP_DECODE_HEADER_ONLY   0x0002     // Image is the header and color map only
+
+// BmpScaleImage() flags
+#define BMP_SCALE_NEAREST        0x0001     // enlarge by nearest neighbour, not bilinear
+
+// BMP_IMAGE_HEADER.CompressionType
+#define BMP_COMPRESSION_NONE     0
+#define BMP_COMPRESSION_RLE8     1          // 8 bit images only
+#define BMP_COMPRESSION_RLE4     2          // 4 bit images only
+
+//
+// Convert Width pixels of one stored row. Palette is only used by the
+// 1, 4 and 8 bit converters.
+//
+typedef
+VOID
+(EFIAPI *BMP_ROW_CONVERTER)( CONST UINT8 *Src,
+                             EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Dst,
+                             UINTN Width,
+                             CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Palette );
+
+typedef struct {
+   CONST BMP_IMAGE_HEADER         *Header;
+   CONST UINT8                    *Pixels;         // bottom stored row, NULL if BMP_DECODE_HEADER_ONLY
+   UINTN                          Width;
+   UINTN                          Height;
+   UINT32                         Compression;     // BMP_COMPRESSION_*
+   UINTN                          DataSize;        // bytes of pixel data in the image
+   UINTN                          RowSize;         // bytes per stored row, padded to 4 bytes
+   BMP_ROW_CONVERTER              ConvertRow;      // NULL for RLE images
+   CONST CHAR16                   *ConverterName;  // e.g. L"24-bit SSSE3", for timing readouts
+   EFI_GRAPHICS_OUTPUT_BLT_PIXEL  Palette[256];    // unused entries are black
+} BMP_DECODER;
+
+
+//
+// Check that Image is an uncompressed, RLE8 or RLE4 BMP whose pixel data
+// lies within ImageSize bytes and select the row converter. Returns
+// EFI_UNSUPPORTED for other formats or bit depths, or if Width * Height
+// blt pixels would not fit in a UINTN, and EFI_INVALID_PARAMETER if an
+// uncompressed image is truncated.
+//
+// With BMP_DECODE_HEADER_ONLY, Image need only hold the ImageOffset bytes
+// before the pixel data and the image must be uncompressed. Such a decoder
+// can only be used with BmpDecodeBand().
+//
+EFI_STATUS
+EFIAPI
+BmpDecoderInit( BMP_DECODER *Decoder,
+                CONST VOID *Image,
+                UINTN ImageSize,
+                UINT32 Flags );
+
+//
+// Convert RowCount rows starting at FirstRow, counted from the top of the
+// image, into Blt as consecutive rows of Decoder->Width pixels. Only for
+// uncompressed images, as RLE rows can not be located without decoding
+// everything below them.
+//
+VOID
+EFIAPI
+BmpDecodeRows( CONST BMP_DECODER *Decoder,
+               UINTN FirstRow,
+               UINTN RowCount,
+               EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Blt );
+
+//
+// Convert RowCount stored rows of Decoder->RowSize bytes each, as read
+// sequentially from the pixel data, into Blt. Stored rows run bottom up,
+// so the first row of Rows becomes the last row of Blt.
+//
+VOID
+EFIAPI
+BmpDecodeBand( CONST BMP_DECODER *Decoder,
+               CONST UINT8 *Rows,
+               UINTN RowCount,
+               EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Blt );
+
+//
+// Convert the whole image into Blt, Width * Height pixels. Pixels that an
+// RLE image skips with delta or end of line escapes are black. Returns
+// EFI_INVALID_PARAMETER if an RLE stream ends early; the rows decoded up
+// to that point are kept.
+//
+EFI_STATUS
+EFIAPI
+BmpDecodeImage( CONST BMP_DECODER *Decoder,
+                EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Blt );
+
+//
+// Convert the image into Blt scaled to Width * Height pixels. The aspect
+// ratio is not preserved; callers choose Width and Height. Uncompressed
+// images are decoded a row at a time, so that besides Blt only one source
+// row and a few rows of Width pixels are allocated. RLE images are decoded
+// in full first.
+//
+EFI_STATUS
+EFIAPI
+BmpScaleImage( CONST BMP_DECODER *Decoder,
+               UINTN Width,
+               UINTN Height,
+               UINT32 Flags,
+               EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Blt );
+
+//
+// Decode Image into Blt as BmpScaleImage() does, but with the portable row
+// converters, and return the TSC ticks taken, for comparison with the SIMD
+// converters in timing readouts. Returns 0 if Image can not be decoded.
+//
+UINT64
+EFIAPI
+BmpTimePortableDecode( CONST VOID *Image,
+                       UINTN ImageSize,
+                       UINTN Width,
+                       UINTN Height,
+                       UINT32 Flags,
+                       EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Blt );
+
+#endif
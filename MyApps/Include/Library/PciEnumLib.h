@@ -0,0 +1,163 @@
+//
+//  Copyright (c) 2017 - 2019   Finnbarr P. Murphy.   All rights reserved.
+//
+//  PCI enumeration library shared by ShowPCI and ShowPCIx
+//
+//  Enumerates every PCI function below every root bridge in one pass into
+//  a compact array of device records sorted by segment, bus, device and
+//  function. The array is kept until freed so that it can be queried
+//  repeatedly without touching configuration space again.
+//
+//  License: UDK2015 license applies to code from UDK2015 source,
+//           BSD 2 clause license applies to all other code.
+//
+
+#ifndef _PCI_ENUM_LIB_H_
+#define _PCI_ENUM_LIB_H_
+
+#include <Protocol/PciRootBridgeIo.h>
+
+#include <IndustryStandard/Pci.h>
+#include <IndustryStandard/Acpi.h>
+#include <IndustryStandard/MemoryMappedConfigurationSpaceAccessTable.h>
+
+// PciEnumInit() flags
+#define PCI_ENUM_NO_ECAM         0x0001     // only use the root bridge I/O protocol
+#define PCI_ENUM_TOPOLOGY        0x0002     // follow bridges instead of scanning every bus
+#define PCI_ENUM_PARALLEL        0x0004     // scan ECAM covered bus ranges on the APs
+
+// wildcard for the PciEnumFindNext() and PciEnumFindNextClass() queries
+#define PCI_ENUM_ANY             0xffff
+
+// configuration space sizes
+#define PCI_ENUM_HEADER_SIZE     0x40       // common header plus type specific registers
+#define PCI_ENUM_CONFIG_SIZE     0x100
+#define PCI_ENUM_EXTENDED_SIZE   0x1000     // PCI Express, only reachable through ECAM
+
+// one MCFG allocation structure per ECAM window
+typedef EFI_ACPI_MEMORY_MAPPED_ENHANCED_CONFIGURATION_SPACE_BASE_ADDRESS_ALLOCATION_STRUCTURE PCI_ECAM_WINDOW;
+
+// one record per function found
+typedef struct {
+   UINT32  Segment;
+   UINT16  RootBridge;              // index into PCI_ENUM_CONTEXT.RootBridges
+   UINT8   Bus;
+   UINT8   Device;
+   UINT8   Function;
+   UINT8   HeaderType;
+   UINT8   RevisionId;
+   UINT8   ClassCode[3];            // programming interface, subclass, base class
+   UINT8   SecondaryBus;            // PCI-to-PCI and CardBus bridges only
+   UINT8   SubordinateBus;
+   UINT16  VendorId;
+   UINT16  DeviceId;
+   UINT16  SubsystemVendorId;       // type 0 headers only
+   UINT16  SubsystemId;
+} PCI_DEVICE_RECORD;
+
+typedef struct {
+   UINT32                           Flags;
+   EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL  **RootBridges;
+   UINTN                            RootBridgeCount;
+   PCI_ECAM_WINDOW                  *EcamWindows;
+   UINTN                            EcamWindowCount;
+   PCI_DEVICE_RECORD                *Devices;
+   UINTN                            DeviceCount;
+   UINTN                            DeviceCapacity;
+   BOOLEAN                          Scanned;
+   BOOLEAN                          FixedCapacity;   // Devices cannot grow (AP workers)
+   // statistics, accumulated over the life of the context
+   UINTN                            BusesScanned;
+   UINTN                            Probes;           // vendor ID reads
+   UINTN                            ProbesSkipped;    // versus scanning every bus
+   UINTN                            ConfigCalls;
+   UINTN                            ConfigDwords;
+   UINTN                            ApWorkers;       // APs used by the last parallel scan
+} PCI_ENUM_CONTEXT;
+
+
+//
+// Locate the root bridges and, unless PCI_ENUM_NO_ECAM is set, the ECAM
+// windows described by the ACPI MCFG table. Returns EFI_NOT_READY if PCI
+// enumeration has not completed and EFI_NOT_FOUND if there are no root
+// bridges.
+//
+EFI_STATUS
+EFIAPI
+PciEnumInit( PCI_ENUM_CONTEXT *Ctx,
+             UINT32 Flags );
+
+//
+// Enumerate all functions into Ctx->Devices. The result is cached; later
+// calls return immediately unless Refresh is TRUE.
+//
+// With PCI_ENUM_PARALLEL, bus ranges reachable through ECAM are scanned by
+// the application processors into per-AP buffers that are merged on the
+// BSP. Ranges that need the root bridge I/O protocol are always scanned
+// on the BSP, as protocols may not be called from an AP. The scan falls
+// back to serial mode if MP services are unavailable.
+//
+EFI_STATUS
+EFIAPI
+PciEnumScan( PCI_ENUM_CONTEXT *Ctx,
+             BOOLEAN Refresh );
+
+//
+// Look up a function by its address, NULL if not present
+//
+PCI_DEVICE_RECORD *
+EFIAPI
+PciEnumFindDevice( PCI_ENUM_CONTEXT *Ctx,
+                   UINT32 Segment,
+                   UINT8 Bus,
+                   UINT8 Device,
+                   UINT8 Function );
+
+//
+// Return the next function after Previous (NULL to start) matching the
+// vendor and device IDs, either of which may be PCI_ENUM_ANY
+//
+PCI_DEVICE_RECORD *
+EFIAPI
+PciEnumFindNext( PCI_ENUM_CONTEXT *Ctx,
+                 PCI_DEVICE_RECORD *Previous,
+                 UINT16 VendorId,
+                 UINT16 DeviceId );
+
+//
+// Return the next function after Previous (NULL to start) matching the
+// base class and subclass, either of which may be PCI_ENUM_ANY
+//
+PCI_DEVICE_RECORD *
+EFIAPI
+PciEnumFindNextClass( PCI_ENUM_CONTEXT *Ctx,
+                      PCI_DEVICE_RECORD *Previous,
+                      UINT16 BaseClass,
+                      UINT16 SubClass );
+
+//
+// Size of the configuration space reachable for a function: 4 KiB through
+// ECAM, 256 bytes otherwise
+//
+UINTN
+EFIAPI
+PciEnumConfigSize( PCI_ENUM_CONTEXT *Ctx,
+                   CONST PCI_DEVICE_RECORD *Record );
+
+//
+// Read Count dwords of a function's configuration space starting at the
+// dword aligned Offset
+//
+EFI_STATUS
+EFIAPI
+PciEnumReadConfig( PCI_ENUM_CONTEXT *Ctx,
+                   CONST PCI_DEVICE_RECORD *Record,
+                   UINTN Offset,
+                   UINTN Count,
+                   UINT32 *Buffer );
+
+VOID
+EFIAPI
+PciEnumFree( PCI_ENUM_CONTEXT *Ctx );
+
+#endif
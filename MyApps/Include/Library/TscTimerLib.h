@@ -0,0 +1,33 @@
+//
+//  Copyright (c) 2017 - 2019   Finnbarr P. Murphy.   All rights reserved.
+//
+//  TSC timing helpers shared by DisplayBMP, ShowBGRT and ShowPCIx
+//
+//  The applications time their phases with AsmReadTsc() and convert the
+//  tick counts for display using a frequency calibrated once against the
+//  boot services stall.
+//
+//  License: BSD 2 clause License
+//
+
+#ifndef _TSC_TIMER_LIB_H_
+#define _TSC_TIMER_LIB_H_
+
+//
+// Calibrate the TSC against a 10 ms boot services stall and return its
+// frequency in ticks per second
+//
+UINT64
+EFIAPI
+TscFrequency( VOID );
+
+//
+// Convert Ticks to microseconds at Frequency ticks per second. Returns 0
+// if Frequency is 0.
+//
+UINT64
+EFIAPI
+TscToMicroseconds( UINT64 Ticks,
+                   UINT64 Frequency );
+
+#endif
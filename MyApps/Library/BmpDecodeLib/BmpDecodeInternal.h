@@ -0,0 +1,48 @@
+//
+//  Copyright (c) 2015 - 2019   Finnbarr P. Murphy.   All rights reserved.
+//
+//  BMP decoding library, row converters shared between its source files
+//
+//  License: BSD 2 clause License
+//
+
+#ifndef _BMP_DECODE_INTERNAL_H_
+#define _BMP_DECODE_INTERNAL_H_
+
+#include <Library/BmpDecodeLib.h>
+
+VOID
+EFIAPI
+BmpConvertRow24( CONST UINT8 *Src,
+                 EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Dst,
+                 UINTN Width,
+                 CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Palette );
+
+VOID
+EFIAPI
+BmpConvertRow32( CONST UINT8 *Src,
+                 EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Dst,
+                 UINTN Width,
+                 CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Palette );
+
+#if defined (MDE_CPU_X64)
+//
+// BmpDecodeSse.c. The SSSE3 converter must only be selected after CPUID
+// has reported SSSE3; SSE2 is architectural on X64.
+//
+VOID
+EFIAPI
+BmpConvertRow24Ssse3( CONST UINT8 *Src,
+                      EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Dst,
+                      UINTN Width,
+                      CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Palette );
+
+VOID
+EFIAPI
+BmpConvertRow32Sse2( CONST UINT8 *Src,
+                     EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Dst,
+                     UINTN Width,
+                     CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Palette );
+#endif
+
+#endif
@@ -0,0 +1,389 @@
+//
+//  Copyright (c) 2015 - 2019   Finnbarr P. Murphy.   All rights reserved.
+//
+//  BMP decoding library shared by DisplayBMP and ShowBGRT
+//
+//  Portable row converters, the per-image converter selection and the
+//  RLE8/RLE4 decoder. The SIMD converters are in BmpDecodeSse.c.
+//
+//  License: BSD 2 clause License
+//
+//  Portions Copyright (c) 2016-2017, Microsoft Corporation
+//           Copyright (c) 2018, Intel Corporation. All rights reserved.
+//           See relevant code in EDK11 for exact details
+//
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+
+#include "BmpDecodeInternal.h"
+
+#define CPUID_SSSE3              BIT9       // CPUID leaf 1 ECX
+
+// RLE escapes, the second byte of a pair whose count is zero
+#define RLE_END_OF_LINE          0
+#define RLE_END_OF_BITMAP        1
+#define RLE_DELTA                2          // followed by right and up offsets
+                                            // 3 or more starts an absolute run
+
+
+STATIC
+VOID
+EFIAPI
+BmpConvertRow1( CONST UINT8 *Src,
+                EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Dst,
+                UINTN Width,
+                CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Palette )
+{
+    UINTN Index;
+    UINT8 Byte;
+
+    for (; Width >= 8; Width -= 8, Dst += 8) {
+        Byte = *Src++;
+        for (Index = 0; Index < 8; Index++) {
+            Dst[Index] = Palette[(Byte >> (7 - Index)) & 0x1];
+        }
+    }
+    for (Index = 0; Index < Width; Index++) {
+        Dst[Index] = Palette[(*Src >> (7 - Index)) & 0x1];
+    }
+}
+
+
+STATIC
+VOID
+EFIAPI
+BmpConvertRow4( CONST UINT8 *Src,
+                EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Dst,
+                UINTN Width,
+                CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Palette )
+{
+    for (; Width >= 2; Width -= 2, Dst += 2, Src++) {
+        Dst[0] = Palette[*Src >> 4];
+        Dst[1] = Palette[*Src & 0x0f];
+    }
+    if (Width > 0) {
+        Dst[0] = Palette[*Src >> 4];
+    }
+}
+
+
+STATIC
+VOID
+EFIAPI
+BmpConvertRow8( CONST UINT8 *Src,
+                EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Dst,
+                UINTN Width,
+                CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Palette )
+{
+    for (UINTN Index = 0; Index < Width; Index++) {
+        Dst[Index] = Palette[Src[Index]];
+    }
+}
+
+
+VOID
+EFIAPI
+BmpConvertRow24( CONST UINT8 *Src,
+                 EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Dst,
+                 UINTN Width,
+                 CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Palette )
+{
+    for (UINTN Index = 0; Index < Width; Index++, Src += 3) {
+        Dst[Index].Blue     = Src[0];
+        Dst[Index].Green    = Src[1];
+        Dst[Index].Red      = Src[2];
+        Dst[Index].Reserved = 0;
+    }
+}
+
+
+VOID
+EFIAPI
+BmpConvertRow32( CONST UINT8 *Src,
+                 EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Dst,
+                 UINTN Width,
+                 CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Palette )
+{
+    // the alpha byte of BGRA is dropped
+    for (UINTN Index = 0; Index < Width; Index++, Src += 4) {
+        Dst[Index].Blue     = Src[0];
+        Dst[Index].Green    = Src[1];
+        Dst[Index].Red      = Src[2];
+        Dst[Index].Reserved = 0;
+    }
+}
+
+
+EFI_STATUS
+EFIAPI
+BmpDecoderInit( BMP_DECODER *Decoder,
+                CONST VOID *Image,
+                UINTN ImageSize,
+                UINT32 Flags )
+{
+    CONST BMP_IMAGE_HEADER *BmpHeader = Image;
+    CONST BMP_COLOR_MAP    *BmpColorMap;
+    BOOLEAN Simd = FALSE;
+    UINT64  RowSize;
+    UINTN   ColorMapNum;
+    UINT32  Ecx = 0;
+
+    if (Decoder == NULL || Image == NULL) {
+        return EFI_INVALID_PARAMETER;
+    }
+    ZeroMem( Decoder, sizeof(BMP_DECODER) );
+
+    if (ImageSize < sizeof(BMP_IMAGE_HEADER) ||
+        BmpHeader->CharB != 'B' || BmpHeader->CharM != 'M') {
+        return EFI_UNSUPPORTED;
+    }
+    if (BmpHeader->PixelWidth == 0 || BmpHeader->PixelHeight == 0) {
+        return EFI_UNSUPPORTED;
+    }
+    if (BmpHeader->ImageOffset > ImageSize) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+#if defined (MDE_CPU_X64)
+    if ((Flags & BMP_DECODE_PORTABLE) == 0) {
+        AsmCpuid( 1, NULL, NULL, &Ecx, NULL );
+        Simd = TRUE;
+    }
+#endif
+
+    switch (BmpHeader->CompressionType) {
+        case BMP_COMPRESSION_NONE:
+            break;
+        case BMP_COMPRESSION_RLE8:
+            if (BmpHeader->BitPerPixel != 8) {
+                return EFI_UNSUPPORTED;
+            }
+            break;
+        case BMP_COMPRESSION_RLE4:
+            if (BmpHeader->BitPerPixel != 4) {
+                return EFI_UNSUPPORTED;
+            }
+            break;
+        default:
+            return EFI_UNSUPPORTED;
+    }
+
+    switch (BmpHeader->BitPerPixel) {
+        case 1:
+            Decoder->ConvertRow = BmpConvertRow1;
+            Decoder->ConverterName = L"1-bit palette";
+            break;
+        case 4:
+            Decoder->ConvertRow = BmpConvertRow4;
+            Decoder->ConverterName = L"4-bit palette";
+            break;
+        case 8:
+            Decoder->ConvertRow = BmpConvertRow8;
+            Decoder->ConverterName = L"8-bit palette";
+            break;
+        case 24:
+            Decoder->ConvertRow = BmpConvertRow24;
+            Decoder->ConverterName = L"24-bit";
+#if defined (MDE_CPU_X64)
+            if (Simd && (Ecx & CPUID_SSSE3) != 0) {
+                Decoder->ConvertRow = BmpConvertRow24Ssse3;
+                Decoder->ConverterName = L"24-bit SSSE3";
+            }
+#endif
+            break;
+        case 32:
+            Decoder->ConvertRow = BmpConvertRow32;
+            Decoder->ConverterName = L"32-bit";
+#if defined (MDE_CPU_X64)
+            if (Simd) {
+                Decoder->ConvertRow = BmpConvertRow32Sse2;
+                Decoder->ConverterName = L"32-bit SSE2";
+            }
+#endif
+            break;
+        default:
+            return EFI_UNSUPPORTED;
+    }
+
+    // callers allocate Width * Height blt pixels, which must not overflow
+    if ((UINT64)BmpHeader->PixelWidth * BmpHeader->PixelHeight >
+        MAX_UINTN / sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL)) {
+        return EFI_UNSUPPORTED;
+    }
+
+    // each stored row is padded to a 32-bit boundary, at most 2^34 bytes,
+    // so divide rather than multiply by the height
+    RowSize = (((UINT64)BmpHeader->PixelWidth * BmpHeader->BitPerPixel + 31) >> 3) & ~0x3ULL;
+    if (BmpHeader->CompressionType == BMP_COMPRESSION_NONE) {
+        if ((Flags & BMP_DECODE_HEADER_ONLY) == 0 &&
+            BmpHeader->PixelHeight > (ImageSize - BmpHeader->ImageOffset) / RowSize) {
+            return EFI_INVALID_PARAMETER;
+        }
+    } else if ((Flags & BMP_DECODE_HEADER_ONLY) != 0) {
+        // RLE rows vary in length, so can not be read in bands
+        return EFI_UNSUPPORTED;
+    } else {
+        // the stream is checked as it is decoded; only the palette is used
+        Decoder->ConvertRow = NULL;
+        Decoder->ConverterName = (BmpHeader->CompressionType == BMP_COMPRESSION_RLE8) ? L"RLE8" : L"RLE4";
+        RowSize = 0;
+    }
+
+    // the color map runs from the end of the header to the pixel data
+    if (BmpHeader->BitPerPixel <= 8 && BmpHeader->ImageOffset > sizeof(BMP_IMAGE_HEADER)) {
+        BmpColorMap = (CONST BMP_COLOR_MAP *)(BmpHeader + 1);
+        ColorMapNum = (BmpHeader->ImageOffset - sizeof(BMP_IMAGE_HEADER)) / sizeof(BMP_COLOR_MAP);
+        ColorMapNum = MIN( ColorMapNum, (UINTN)1 << BmpHeader->BitPerPixel );
+        for (UINTN Index = 0; Index < ColorMapNum; Index++) {
+            Decoder->Palette[Index].Blue  = BmpColorMap[Index].Blue;
+            Decoder->Palette[Index].Green = BmpColorMap[Index].Green;
+            Decoder->Palette[Index].Red   = BmpColorMap[Index].Red;
+        }
+    }
+
+    Decoder->Header      = BmpHeader;
+    Decoder->Width       = BmpHeader->PixelWidth;
+    Decoder->Height      = BmpHeader->PixelHeight;
+    Decoder->Compression = BmpHeader->CompressionType;
+    Decoder->RowSize     = (UINTN)RowSize;
+    if ((Flags & BMP_DECODE_HEADER_ONLY) == 0) {
+        Decoder->Pixels   = (CONST UINT8 *)Image + BmpHeader->ImageOffset;
+        Decoder->DataSize = ImageSize - BmpHeader->ImageOffset;
+    }
+
+    return EFI_SUCCESS;
+}
+
+
+VOID
+EFIAPI
+BmpDecodeRows( CONST BMP_DECODER *Decoder,
+               UINTN FirstRow,
+               UINTN RowCount,
+               EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Blt )
+{
+    CONST UINT8 *Src;
+
+    // rows are stored bottom up
+    for (UINTN Row = FirstRow; Row < FirstRow + RowCount; Row++, Blt += Decoder->Width) {
+        Src = Decoder->Pixels + (Decoder->Height - Row - 1) * Decoder->RowSize;
+        Decoder->ConvertRow( Src, Blt, Decoder->Width, Decoder->Palette );
+    }
+}
+
+
+VOID
+EFIAPI
+BmpDecodeBand( CONST BMP_DECODER *Decoder,
+               CONST UINT8 *Rows,
+               UINTN RowCount,
+               EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Blt )
+{
+    // fill the band from its last row up
+    Blt += RowCount * Decoder->Width;
+    for (UINTN Row = 0; Row < RowCount; Row++, Rows += Decoder->RowSize) {
+        Blt -= Decoder->Width;
+        Decoder->ConvertRow( Rows, Blt, Decoder->Width, Decoder->Palette );
+    }
+}
+
+
+//
+// Decode an RLE8 or RLE4 stream row by row, bottom up, straight into the
+// blt buffer. Runs that extend past the right edge are clipped.
+//
+STATIC
+EFI_STATUS
+BmpDecodeRle( CONST BMP_DECODER *Decoder,
+              EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Blt )
+{
+    CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Palette = Decoder->Palette;
+    EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Row;
+    CONST UINT8 *Src = Decoder->Pixels;
+    CONST UINT8 *End = Src + Decoder->DataSize;
+    BOOLEAN     Rle4 = (Decoder->Compression == BMP_COMPRESSION_RLE4);
+    UINTN       Width = Decoder->Width;
+    UINTN       X = 0;
+    UINTN       Y = 0;                      // stored row, 0 is the bottom
+    UINTN       Count;
+    UINTN       Bytes;
+    UINTN       Index;
+    UINT8       Value;
+
+    ZeroMem( Blt, Decoder->Width * Decoder->Height * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL) );
+
+    while (Y < Decoder->Height) {
+        if (End - Src < 2) {
+            return EFI_INVALID_PARAMETER;
+        }
+        Count = *Src++;
+        Value = *Src++;
+        Row = Blt + (Decoder->Height - Y - 1) * Width;
+
+        if (Count > 0) {
+            // encoded run, RLE4 alternates the two pixels in Value
+            if (Rle4) {
+                for (Index = 0; Index < Count && X < Width; Index++, X++) {
+                    Row[X] = Palette[(Index & 1) ? (Value & 0x0f) : (Value >> 4)];
+                }
+            } else {
+                for (Index = 0; Index < Count && X < Width; Index++, X++) {
+                    Row[X] = Palette[Value];
+                }
+            }
+            X += Count - Index;
+        } else if (Value == RLE_END_OF_LINE) {
+            X = 0;
+            Y++;
+        } else if (Value == RLE_END_OF_BITMAP) {
+            break;
+        } else if (Value == RLE_DELTA) {
+            if (End - Src < 2) {
+                return EFI_INVALID_PARAMETER;
+            }
+            X += Src[0];
+            Y += Src[1];
+            Src += 2;
+        } else {
+            // absolute run of Value pixels, padded to a 16-bit boundary
+            Bytes = Rle4 ? (Value + 1) / 2 : Value;
+            if ((UINTN)(End - Src) < Bytes) {
+                return EFI_INVALID_PARAMETER;
+            }
+            Count = MIN( Value, (X < Width) ? Width - X : 0 );
+            if (Rle4) {
+                for (Index = 0; Index < Count; Index++) {
+                    Row[X + Index] = Palette[(Index & 1) ? (Src[Index / 2] & 0x0f) : (Src[Index / 2] >> 4)];
+                }
+            } else {
+                for (Index = 0; Index < Count; Index++) {
+                    Row[X + Index] = Palette[Src[Index]];
+                }
+            }
+            X += Value;
+            Src += MIN( Bytes + (Bytes & 1), (UINTN)(End - Src) );
+        }
+    }
+
+    return EFI_SUCCESS;
+}
+
+
+EFI_STATUS
+EFIAPI
+BmpDecodeImage( CONST BMP_DECODER *Decoder,
+                EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Blt )
+{
+    if (Decoder->Pixels == NULL) {
+        return EFI_INVALID_PARAMETER;
+    }
+    if (Decoder->Compression != BMP_COMPRESSION_NONE) {
+        return BmpDecodeRle( Decoder, Blt );
+    }
+
+    BmpDecodeRows( Decoder, 0, Decoder->Height, Blt );
+
+    return EFI_SUCCESS;
+}
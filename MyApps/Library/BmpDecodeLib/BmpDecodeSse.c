@@ -0,0 +1,80 @@
+//
+//  Copyright (c) 2015 - 2019   Finnbarr P. Murphy.   All rights reserved.
+//
+//  BMP decoding library, SSE2 and SSSE3 row converters (X64 only)
+//
+//  Both converters handle 16 pixels per iteration with unaligned loads
+//  and stores and finish a row with the portable converter. Only whole
+//  16 pixel groups are loaded, so nothing past the end of a row is read.
+//
+//  License: BSD 2 clause License
+//
+
+#include <Uefi.h>
+
+#include <emmintrin.h>
+#include <tmmintrin.h>
+
+#include "BmpDecodeInternal.h"
+
+// lets GCC and clang emit SSSE3 here without it for the whole module
+#if defined(__GNUC__)
+#define TARGET_SSSE3             __attribute__((target("ssse3")))
+#else
+#define TARGET_SSSE3
+#endif
+
+#define SIMD_PIXELS              16
+
+
+//
+// Each shuffle expands the four BGR pixels in the low 12 bytes of a
+// register to BGR0; PALIGNR lines up the pixels that straddle loads.
+//
+TARGET_SSSE3
+VOID
+EFIAPI
+BmpConvertRow24Ssse3( CONST UINT8 *Src,
+                      EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Dst,
+                      UINTN Width,
+                      CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Palette )
+{
+    CONST __m128i Expand = _mm_setr_epi8( 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1 );
+    __m128i       In0, In1, In2;
+    __m128i       *Out = (__m128i *)Dst;
+
+    for (; Width >= SIMD_PIXELS; Width -= SIMD_PIXELS, Src += SIMD_PIXELS * 3, Out += 4) {
+        In0 = _mm_loadu_si128( (CONST __m128i *)Src );            // bytes  0..15
+        In1 = _mm_loadu_si128( (CONST __m128i *)(Src + 16) );     // bytes 16..31
+        In2 = _mm_loadu_si128( (CONST __m128i *)(Src + 32) );     // bytes 32..47
+
+        _mm_storeu_si128( Out,     _mm_shuffle_epi8( In0, Expand ) );
+        _mm_storeu_si128( Out + 1, _mm_shuffle_epi8( _mm_alignr_epi8( In1, In0, 12 ), Expand ) );
+        _mm_storeu_si128( Out + 2, _mm_shuffle_epi8( _mm_alignr_epi8( In2, In1, 8 ), Expand ) );
+        _mm_storeu_si128( Out + 3, _mm_shuffle_epi8( _mm_srli_si128( In2, 4 ), Expand ) );
+    }
+
+    BmpConvertRow24( Src, (EFI_GRAPHICS_OUTPUT_BLT_PIXEL *)Out, Width, Palette );
+}
+
+
+VOID
+EFIAPI
+BmpConvertRow32Sse2( CONST UINT8 *Src,
+                     EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Dst,
+                     UINTN Width,
+                     CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Palette )
+{
+    CONST __m128i Mask = _mm_set1_epi32( 0x00ffffff );
+    CONST __m128i *In = (CONST __m128i *)Src;
+    __m128i       *Out = (__m128i *)Dst;
+
+    for (; Width >= SIMD_PIXELS; Width -= SIMD_PIXELS, In += 4, Out += 4) {
+        _mm_storeu_si128( Out,     _mm_and_si128( _mm_loadu_si128( In ), Mask ) );
+        _mm_storeu_si128( Out + 1, _mm_and_si128( _mm_loadu_si128( In + 1 ), Mask ) );
+        _mm_storeu_si128( Out + 2, _mm_and_si128( _mm_loadu_si128( In + 2 ), Mask ) );
+        _mm_storeu_si128( Out + 3, _mm_and_si128( _mm_loadu_si128( In + 3 ), Mask ) );
+    }
+
+    BmpConvertRow32( (CONST UINT8 *)In, (EFI_GRAPHICS_OUTPUT_BLT_PIXEL *)Out, Width, Palette );
+}
@@ -0,0 +1,285 @@
+//
+//  Copyright (c) 2015 - 2019   Finnbarr P. Murphy.   All rights reserved.
+//
+//  BMP decoding library, scaled decode
+//
+//  A separable filter in 16.16 fixed point. Each output pixel is a
+//  weighted sum of a few source pixels along each axis: a box filter
+//  (area average) when reducing, bilinear or nearest neighbour when
+//  enlarging. Source rows are decoded one at a time, scaled horizontally
+//  into a small ring of output width rows and combined vertically, so
+//  that apart from the output only one source row and as many scaled
+//  rows as one output row needs are held.
+//
+//  License: BSD 2 clause License
+//
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include "BmpDecodeInternal.h"
+
+#define FIXED_ONE                0x10000
+#define FIXED_HALF               0x8000
+
+// contributions of source pixels to each output pixel along one axis
+typedef struct {
+   UINTN   Taps;                    // maximum contributions to an output pixel
+   UINT32  *Start;                  // first contributing source pixel
+   UINT32  *Count;
+   UINT32  *Weights;                // Taps per output pixel, 16.16, summing to FIXED_ONE
+} SCALE_AXIS;
+
+
+STATIC
+VOID
+FreeScaleAxis( SCALE_AXIS *Axis )
+{
+    if (Axis->Start != NULL) {
+        FreePool( Axis->Start );
+    }
+    if (Axis->Count != NULL) {
+        FreePool( Axis->Count );
+    }
+    if (Axis->Weights != NULL) {
+        FreePool( Axis->Weights );
+    }
+}
+
+
+//
+// Build the contributions for Src pixels scaled to Dst, pixel centres
+// aligned
+//
+STATIC
+EFI_STATUS
+InitScaleAxis( SCALE_AXIS *Axis,
+               UINTN Src,
+               UINTN Dst,
+               UINT32 Flags )
+{
+    UINT64 From, To;
+    UINT64 Lo, Hi;
+    UINT64 Pos;
+    UINT32 *Weights;
+    UINT32 Sum;
+    UINTN  Index;
+
+    ZeroMem( Axis, sizeof(SCALE_AXIS) );
+
+    // a box covers at most ceil(Src / Dst) + 1 source pixels
+    Axis->Taps = (Dst < Src) ? (Src + Dst - 1) / Dst + 1 : 2;
+    Axis->Start = AllocatePool( Dst * sizeof(UINT32) );
+    Axis->Count = AllocatePool( Dst * sizeof(UINT32) );
+    Axis->Weights = AllocateZeroPool( Dst * Axis->Taps * sizeof(UINT32) );
+    if (Axis->Start == NULL || Axis->Count == NULL || Axis->Weights == NULL) {
+        FreeScaleAxis( Axis );
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    for (UINTN i = 0; i < Dst; i++) {
+        Weights = Axis->Weights + i * Axis->Taps;
+
+        if (Dst < Src) {
+            // the output pixel covers [From, To) of the source, To - From > 1
+            From = ((UINT64)i * Src << 16) / Dst;
+            To = ((UINT64)(i + 1) * Src << 16) / Dst;
+            Axis->Start[i] = (UINT32)(From >> 16);
+            Axis->Count[i] = (UINT32)(((To - 1) >> 16) - (From >> 16) + 1);
+            Sum = 0;
+            for (Index = 0; Index < Axis->Count[i]; Index++) {
+                Lo = MAX( From, (UINT64)(Axis->Start[i] + Index) << 16 );
+                Hi = MIN( To, (UINT64)(Axis->Start[i] + Index + 1) << 16 );
+                Weights[Index] = (UINT32)(((Hi - Lo) << 16) / (To - From));
+                Sum += Weights[Index];
+            }
+            // rounding goes to the first pixel so the weights sum to one
+            Weights[0] += FIXED_ONE - Sum;
+        } else if (Src == Dst || (Flags & BMP_SCALE_NEAREST) != 0) {
+            Axis->Start[i] = (UINT32)(((UINT64)(2 * i + 1) * Src) / (2 * Dst));
+            Axis->Count[i] = 1;
+            Weights[0] = FIXED_ONE;
+        } else {
+            // bilinear between the two source pixels either side of the centre
+            Pos = ((UINT64)(2 * i + 1) * Src << 16) / (2 * Dst);
+            Pos = (Pos > FIXED_HALF) ? Pos - FIXED_HALF : 0;
+            Pos = MIN( Pos, (UINT64)(Src - 1) << 16 );
+            Axis->Start[i] = (UINT32)(Pos >> 16);
+            Weights[1] = (UINT32)(Pos & 0xffff);
+            Weights[0] = FIXED_ONE - Weights[1];
+            Axis->Count[i] = (Weights[1] != 0) ? 2 : 1;
+        }
+    }
+
+    return EFI_SUCCESS;
+}
+
+
+STATIC
+VOID
+ScaleRow( CONST SCALE_AXIS *Axis,
+          CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Src,
+          EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Dst,
+          UINTN Width )
+{
+    CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL *In;
+    CONST UINT32 *Weights = Axis->Weights;
+    UINT32 Blue, Green, Red;
+
+    for (UINTN x = 0; x < Width; x++, Weights += Axis->Taps) {
+        In = Src + Axis->Start[x];
+        Blue = Green = Red = FIXED_HALF;
+        for (UINTN Index = 0; Index < Axis->Count[x]; Index++) {
+            Blue  += Weights[Index] * In[Index].Blue;
+            Green += Weights[Index] * In[Index].Green;
+            Red   += Weights[Index] * In[Index].Red;
+        }
+        Dst[x].Blue     = (UINT8)(Blue >> 16);
+        Dst[x].Green    = (UINT8)(Green >> 16);
+        Dst[x].Red      = (UINT8)(Red >> 16);
+        Dst[x].Reserved = 0;
+    }
+}
+
+
+EFI_STATUS
+EFIAPI
+BmpScaleImage( CONST BMP_DECODER *Decoder,
+               UINTN Width,
+               UINTN Height,
+               UINT32 Flags,
+               EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Blt )
+{
+    EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Image = NULL;
+    EFI_GRAPHICS_OUTPUT_BLT_PIXEL *SrcRow = NULL;
+    EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Ring = NULL;
+    CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Row;
+    CONST UINT32 *Weights;
+    SCALE_AXIS Horizontal;
+    SCALE_AXIS Vertical;
+    EFI_STATUS Status;
+    UINTN      Loaded = 0;              // source rows scaled into the ring so far
+    UINTN      Last;
+    UINT32     Blue, Green, Red;
+
+    if (Width == 0 || Height == 0 || Decoder->Pixels == NULL) {
+        return EFI_INVALID_PARAMETER;
+    }
+    if (Width == Decoder->Width && Height == Decoder->Height) {
+        return BmpDecodeImage( Decoder, Blt );
+    }
+
+    ZeroMem( &Vertical, sizeof(Vertical) );
+    Status = InitScaleAxis( &Horizontal, Decoder->Width, Width, Flags );
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+    Status = InitScaleAxis( &Vertical, Decoder->Height, Height, Flags );
+    if (EFI_ERROR(Status)) {
+        goto Done;
+    }
+
+    // a reduction to a few rows can need many scaled rows at once
+    if (Width > MAX_UINTN / sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL) / Vertical.Taps) {
+        Status = EFI_OUT_OF_RESOURCES;
+        goto Done;
+    }
+
+    // RLE rows can only be reached by decoding the whole image
+    if (Decoder->Compression != BMP_COMPRESSION_NONE) {
+        Image = AllocatePool( Decoder->Width * Decoder->Height * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL) );
+        if (Image == NULL) {
+            Status = EFI_OUT_OF_RESOURCES;
+            goto Done;
+        }
+        Status = BmpDecodeImage( Decoder, Image );
+        if (EFI_ERROR(Status)) {
+            goto Done;
+        }
+    }
+
+    SrcRow = AllocatePool( Decoder->Width * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL) );
+    Ring = AllocatePool( Vertical.Taps * Width * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL) );
+    if (SrcRow == NULL || Ring == NULL) {
+        Status = EFI_OUT_OF_RESOURCES;
+        goto Done;
+    }
+
+    Weights = Vertical.Weights;
+    for (UINTN y = 0; y < Height; y++, Weights += Vertical.Taps, Blt += Width) {
+        // windows only move down, so rows older than Taps are not needed again
+        Last = Vertical.Start[y] + Vertical.Count[y];
+        for (; Loaded < Last; Loaded++) {
+            if (Image != NULL) {
+                Row = Image + Loaded * Decoder->Width;
+            } else {
+                BmpDecodeRows( Decoder, Loaded, 1, SrcRow );
+                Row = SrcRow;
+            }
+            ScaleRow( &Horizontal, Row, Ring + (Loaded % Vertical.Taps) * Width, Width );
+        }
+
+        // a single row has a weight of one
+        if (Vertical.Count[y] == 1) {
+            CopyMem( Blt, Ring + (Vertical.Start[y] % Vertical.Taps) * Width,
+                     Width * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL) );
+            continue;
+        }
+
+        for (UINTN x = 0; x < Width; x++) {
+            Blue = Green = Red = FIXED_HALF;
+            for (UINTN Index = 0; Index < Vertical.Count[y]; Index++) {
+                Row = Ring + ((Vertical.Start[y] + Index) % Vertical.Taps) * Width;
+                Blue  += Weights[Index] * Row[x].Blue;
+                Green += Weights[Index] * Row[x].Green;
+                Red   += Weights[Index] * Row[x].Red;
+            }
+            Blt[x].Blue     = (UINT8)(Blue >> 16);
+            Blt[x].Green    = (UINT8)(Green >> 16);
+            Blt[x].Red      = (UINT8)(Red >> 16);
+            Blt[x].Reserved = 0;
+        }
+    }
+
+Done:
+    FreeScaleAxis( &Horizontal );
+    FreeScaleAxis( &Vertical );
+    if (Image != NULL) {
+        FreePool( Image );
+    }
+    if (SrcRow != NULL) {
+        FreePool( SrcRow );
+    }
+    if (Ring != NULL) {
+        FreePool( Ring );
+    }
+
+    return Status;
+}
+
+
+UINT64
+EFIAPI
+BmpTimePortableDecode( CONST VOID *Image,
+                       UINTN ImageSize,
+                       UINTN Width,
+                       UINTN Height,
+                       UINT32 Flags,
+                       EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Blt )
+{
+    BMP_DECODER Decoder;
+    UINT64      Ticks;
+
+    if (EFI_ERROR(BmpDecoderInit( &Decoder, Image, ImageSize, BMP_DECODE_PORTABLE ))) {
+        return 0;
+    }
+
+    Ticks = AsmReadTsc();
+    if (EFI_ERROR(BmpScaleImage( &Decoder, Width, Height, Flags, Blt ))) {
+        return 0;
+    }
+
+    return AsmReadTsc() - Ticks;
+}
@@ -0,0 +1,992 @@
+//
+//  Copyright (c) 2017 - 2019   Finnbarr P. Murphy.   All rights reserved.
+//
+//  PCI enumeration library shared by ShowPCI and ShowPCIx
+//
+//  Configuration space is read through the ECAM windows described by the
+//  ACPI MCFG table when present, otherwise through the root bridge I/O
+//  protocol. All accesses are dword sized.
+//
+//  License: UDK2015 license applies to code from UDK2015 source,
+//           BSD 2 clause license applies to all other code.
+//
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/IoLib.h>
+#include <Library/SortLib.h>
+#include <Library/PciEnumLib.h>
+
+#include <Protocol/PciEnumerationComplete.h>
+#include <Protocol/MpService.h>
+
+#include <Guid/Acpi.h>
+
+#define CALC_EFI_PCI_ADDRESS(Bus, Dev, Func, Reg) \
+    ((UINT64) ((((UINTN) Bus) << 24) + (((UINTN) Dev) << 16) + (((UINTN) Func) << 8) + ((UINTN) Reg)))
+
+#define CALC_ECAM_OFFSET(Bus, Dev, Func, Reg) \
+    ((UINT64) ((((UINTN) Bus) << 20) + (((UINTN) Dev) << 15) + (((UINTN) Func) << 12) + ((UINTN) Reg)))
+
+#define EFI_PCI_EMUMERATION_COMPLETE_GUID \
+    { 0x30cfe3e7, 0x3de1, 0x4586, {0xbe, 0x20, 0xde, 0xab, 0xa1, 0xb3, 0xb7, 0x93}}
+
+// all typedefs from EDKII sources
+#pragma pack(1)
+typedef union {
+   PCI_DEVICE_HEADER_TYPE_REGION  Device;
+   PCI_BRIDGE_CONTROL_REGISTER    Bridge;
+   PCI_CARDBUS_CONTROL_REGISTER   CardBus;
+} NON_COMMON_UNION;
+
+typedef struct {
+   PCI_DEVICE_INDEPENDENT_REGION  Common;
+   NON_COMMON_UNION               NonCommon;
+} PCI_CONFIG_HEADER;
+#pragma pack()
+
+// a contiguous bus range of one root bridge
+typedef struct {
+   UINT16   RootBridge;
+   UINT16   MinBus;
+   UINT16   MaxBus;
+   BOOLEAN  Done;                   // scanned by an AP
+} PCI_BUS_RANGE;
+
+typedef struct {
+   PCI_ENUM_CONTEXT  Ctx;
+   EFI_STATUS        Status;
+} PCI_ENUM_WORKER;
+
+// shared, read-only, state handed to every AP
+typedef struct {
+   EFI_MP_SERVICES_PROTOCOL  *Mp;
+   PCI_BUS_RANGE             *Items;
+   UINTN                     ItemCount;
+   PCI_ENUM_WORKER           *Workers;
+   UINTN                     WorkerCount;
+   UINTN                     *WorkerOfProcessor;  // processor number to worker index
+   UINTN                     ProcessorCount;
+} PCI_PARALLEL_SCAN;
+
+
+//
+// Copyed from UDK2015 Source.
+//
+STATIC
+EFI_STATUS
+PciGetNextBusRange( EFI_ACPI_ADDRESS_SPACE_DESCRIPTOR **Descriptors,
+                    UINT16 *MinBus,
+                    UINT16 *MaxBus,
+                    BOOLEAN *IsEnd )
+{
+    *IsEnd = FALSE;
+
+    if ((*Descriptors) == NULL) {
+        *MinBus = 0;
+        *MaxBus = PCI_MAX_BUS;
+        return EFI_SUCCESS;
+    }
+
+    while ((*Descriptors)->Desc != ACPI_END_TAG_DESCRIPTOR) {
+        if ((*Descriptors)->ResType == ACPI_ADDRESS_SPACE_TYPE_BUS) {
+            *MinBus = (UINT16) (*Descriptors)->AddrRangeMin;
+            *MaxBus = (UINT16) (*Descriptors)->AddrRangeMax;
+            (*Descriptors)++;
+            return (EFI_SUCCESS);
+        }
+
+        (*Descriptors)++;
+    }
+
+    if ((*Descriptors)->Desc == ACPI_END_TAG_DESCRIPTOR) {
+        *IsEnd = TRUE;
+    }
+
+    return EFI_SUCCESS;
+}
+
+
+//
+// Locate the ACPI MCFG table by walking the XSDT
+//
+STATIC
+EFI_ACPI_MEMORY_MAPPED_CONFIGURATION_BASE_ADDRESS_TABLE_HEADER *
+PciFindMcfgTable( VOID )
+{
+    EFI_ACPI_2_0_ROOT_SYSTEM_DESCRIPTION_POINTER *Rsdp = NULL;
+    EFI_ACPI_DESCRIPTION_HEADER *Xsdt;
+    EFI_ACPI_DESCRIPTION_HEADER *Entry;
+    EFI_GUID gAcpi20TableGuid = EFI_ACPI_20_TABLE_GUID;
+    UINT64 *EntryPtr;
+    UINT32 EntryCount;
+
+    for (UINTN i = 0; i < gST->NumberOfTableEntries; i++) {
+        if (CompareGuid( &(gST->ConfigurationTable[i].VendorGuid), &gAcpi20TableGuid ) &&
+            !AsciiStrnCmp( "RSD PTR ", (CHAR8 *)(gST->ConfigurationTable[i].VendorTable), 8 )) {
+            Rsdp = (EFI_ACPI_2_0_ROOT_SYSTEM_DESCRIPTION_POINTER *) gST->ConfigurationTable[i].VendorTable;
+            break;
+        }
+    }
+
+    if (Rsdp == NULL || Rsdp->Revision < EFI_ACPI_2_0_ROOT_SYSTEM_DESCRIPTION_POINTER_REVISION) {
+        return NULL;
+    }
+
+    Xsdt = (EFI_ACPI_DESCRIPTION_HEADER *)(UINTN)(Rsdp->XsdtAddress);
+    if (Xsdt == NULL || Xsdt->Signature != SIGNATURE_32('X', 'S', 'D', 'T')) {
+        return NULL;
+    }
+
+    EntryCount = (Xsdt->Length - sizeof(EFI_ACPI_DESCRIPTION_HEADER)) / sizeof(UINT64);
+    EntryPtr = (UINT64 *)(Xsdt + 1);
+    for (UINT32 Index = 0; Index < EntryCount; Index++, EntryPtr++) {
+        Entry = (EFI_ACPI_DESCRIPTION_HEADER *)(UINTN) ReadUnaligned64( EntryPtr );
+        if (Entry != NULL && Entry->Signature == SIGNATURE_32('M', 'C', 'F', 'G')) {
+            return (EFI_ACPI_MEMORY_MAPPED_CONFIGURATION_BASE_ADDRESS_TABLE_HEADER *) Entry;
+        }
+    }
+
+    return NULL;
+}
+
+
+//
+// Return the ECAM address of a function's configuration space, or 0 if
+// no window covers it. Window base addresses correspond to bus 0.
+//
+STATIC
+UINTN
+PciEcamAddress( PCI_ENUM_CONTEXT *Ctx,
+                UINT32 Segment,
+                UINT16 Bus,
+                UINT16 Device,
+                UINT16 Func )
+{
+    PCI_ECAM_WINDOW *Window;
+
+    for (UINTN Index = 0; Index < Ctx->EcamWindowCount; Index++) {
+        Window = &Ctx->EcamWindows[Index];
+        if (Window->PciSegmentGroupNumber == Segment &&
+            Bus >= Window->StartBusNumber && Bus <= Window->EndBusNumber) {
+            return (UINTN)(Window->BaseAddress + CALC_ECAM_OFFSET( Bus, Device, Func, 0 ));
+        }
+    }
+
+    return 0;
+}
+
+
+//
+// Read Count dwords of a function's configuration space starting at Offset,
+// through ECAM using aligned 32-bit loads when a window covers it, otherwise
+// through the root bridge I/O protocol with 32-bit width
+//
+STATIC
+EFI_STATUS
+PciReadConfig( PCI_ENUM_CONTEXT *Ctx,
+               EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *IoDev,
+               UINT16 Bus,
+               UINT16 Device,
+               UINT16 Func,
+               UINTN Offset,
+               UINTN Count,
+               UINT32 *Buffer )
+{
+    UINTN Base;
+
+    Ctx->ConfigCalls++;
+    Ctx->ConfigDwords += Count;
+
+    Base = PciEcamAddress( Ctx, IoDev->SegmentNumber, Bus, Device, Func );
+    if (Base != 0) {
+        for (UINTN Index = 0; Index < Count; Index++) {
+            Buffer[Index] = MmioRead32( Base + Offset + Index * sizeof(UINT32) );
+        }
+        return EFI_SUCCESS;
+    }
+
+    return IoDev->Pci.Read( IoDev,
+                            EfiPciWidthUint32,
+                            CALC_EFI_PCI_ADDRESS( Bus, Device, Func, Offset ),
+                            Count,
+                            Buffer );
+}
+
+
+//
+// Make room for Count more records
+//
+STATIC
+EFI_STATUS
+PciReserveRecords( PCI_ENUM_CONTEXT *Ctx,
+                   UINTN Count )
+{
+    PCI_DEVICE_RECORD *NewDevices;
+    UINTN NewCapacity;
+
+    if (Ctx->DeviceCount + Count <= Ctx->DeviceCapacity) {
+        return EFI_SUCCESS;
+    }
+
+    // pool services are not available on an AP
+    if (Ctx->FixedCapacity) {
+        return EFI_BUFFER_TOO_SMALL;
+    }
+
+    NewCapacity = (Ctx->DeviceCapacity == 0) ? 64 : Ctx->DeviceCapacity * 2;
+    if (NewCapacity < Ctx->DeviceCount + Count) {
+        NewCapacity = Ctx->DeviceCount + Count;
+    }
+
+    NewDevices = ReallocatePool( Ctx->DeviceCapacity * sizeof(PCI_DEVICE_RECORD),
+                                 NewCapacity * sizeof(PCI_DEVICE_RECORD),
+                                 Ctx->Devices );
+    if (NewDevices == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+    }
+    Ctx->Devices = NewDevices;
+    Ctx->DeviceCapacity = NewCapacity;
+
+    return EFI_SUCCESS;
+}
+
+
+STATIC
+EFI_STATUS
+PciAddRecord( PCI_ENUM_CONTEXT *Ctx,
+              UINT16 RootBridge,
+              UINT16 Bus,
+              UINT16 Device,
+              UINT16 Func,
+              PCI_CONFIG_HEADER *Header )
+{
+    PCI_DEVICE_RECORD *Record;
+    EFI_STATUS Status;
+
+    Status = PciReserveRecords( Ctx, 1 );
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+
+    Record = &Ctx->Devices[Ctx->DeviceCount++];
+    ZeroMem( Record, sizeof(PCI_DEVICE_RECORD) );
+    Record->Segment    = Ctx->RootBridges[RootBridge]->SegmentNumber;
+    Record->RootBridge = RootBridge;
+    Record->Bus        = (UINT8) Bus;
+    Record->Device     = (UINT8) Device;
+    Record->Function   = (UINT8) Func;
+    Record->HeaderType = Header->Common.HeaderType;
+    Record->RevisionId = Header->Common.RevisionID;
+    Record->VendorId   = Header->Common.VendorId;
+    Record->DeviceId   = Header->Common.DeviceId;
+    CopyMem( Record->ClassCode, Header->Common.ClassCode, sizeof(Record->ClassCode) );
+
+    switch (Header->Common.HeaderType & HEADER_LAYOUT_CODE) {
+        case HEADER_TYPE_DEVICE:
+            Record->SubsystemVendorId = Header->NonCommon.Device.SubsystemVendorID;
+            Record->SubsystemId       = Header->NonCommon.Device.SubsystemID;
+            break;
+        case HEADER_TYPE_PCI_TO_PCI_BRIDGE:
+            Record->SecondaryBus   = Header->NonCommon.Bridge.SecondaryBus;
+            Record->SubordinateBus = Header->NonCommon.Bridge.SubordinateBus;
+            break;
+        case HEADER_TYPE_CARDBUS_BRIDGE:
+            Record->SecondaryBus   = Header->NonCommon.CardBus.CardBusBusNumber;
+            Record->SubordinateBus = Header->NonCommon.CardBus.SubordinateBusNumber;
+            break;
+    }
+
+    return EFI_SUCCESS;
+}
+
+
+//
+// Probe every device and function on one bus. A probe is one dword read of
+// the vendor and device IDs; only present functions have the rest of their
+// header read. Secondary buses of PCI-to-PCI and CardBus bridges within
+// MinBus..MaxBus are marked in Pending.
+//
+STATIC
+EFI_STATUS
+PciScanBus( PCI_ENUM_CONTEXT *Ctx,
+            UINT16 RootBridge,
+            UINT16 Bus,
+            UINT16 MinBus,
+            UINT16 MaxBus,
+            UINT32 *Pending )
+{
+    EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *IoDev = Ctx->RootBridges[RootBridge];
+    PCI_CONFIG_HEADER Header;
+    UINT32 *Buffer = (UINT32 *) &Header;
+    EFI_STATUS Status;
+    UINT8 Secondary, Subordinate;
+
+    Ctx->BusesScanned++;
+
+    for ( UINT16 Device = 0; Device <= PCI_MAX_DEVICE; Device++ ) {
+        for ( UINT16 Func = 0; Func <= PCI_MAX_FUNC; Func++ ) {
+            Ctx->Probes++;
+            PciReadConfig( Ctx, IoDev, Bus, Device, Func, 0, 1, Buffer );
+            if ((Buffer[0] & 0xffff) == 0xffff) {
+                if ( Func == 0 ) {
+                    break;
+                }
+                continue;
+            }
+
+            PciReadConfig( Ctx, IoDev, Bus, Device, Func,
+                           sizeof(UINT32),
+                           sizeof(Header) / sizeof(UINT32) - 1,
+                           Buffer + 1 );
+
+            Status = PciAddRecord( Ctx, RootBridge, Bus, Device, Func, &Header );
+            if (EFI_ERROR(Status)) {
+                return Status;
+            }
+
+            switch (Header.Common.HeaderType & HEADER_LAYOUT_CODE) {
+                case HEADER_TYPE_PCI_TO_PCI_BRIDGE:
+                    Secondary   = Header.NonCommon.Bridge.SecondaryBus;
+                    Subordinate = Header.NonCommon.Bridge.SubordinateBus;
+                    break;
+                case HEADER_TYPE_CARDBUS_BRIDGE:
+                    Secondary   = Header.NonCommon.CardBus.CardBusBusNumber;
+                    Subordinate = Header.NonCommon.CardBus.SubordinateBusNumber;
+                    break;
+                default:
+                    Secondary = Subordinate = 0;
+                    break;
+            }
+            if (Secondary > Bus && Secondary <= Subordinate &&
+                Secondary >= MinBus && Secondary <= MaxBus) {
+                Pending[Secondary / 32] |= 1u << (Secondary % 32);
+            }
+
+            if ( Func == 0 && 
+                 ((Header.Common.HeaderType & HEADER_TYPE_MULTI_FUNCTION) == 0x00) ) {
+               break;
+            }
+        }
+    }
+
+    return EFI_SUCCESS;
+}
+
+
+//
+// Scan one bus range of a root bridge. In topology mode only the root bus
+// and buses found behind bridges are visited; a brute force scan would
+// have probed function 0 of every device on each bus skipped, and those
+// probes are counted as saved.
+//
+STATIC
+EFI_STATUS
+PciScanBusRange( PCI_ENUM_CONTEXT *Ctx,
+                 UINT16 RootBridge,
+                 UINT16 MinBus,
+                 UINT16 MaxBus )
+{
+    UINT32 Pending[(PCI_MAX_BUS + 1) / 32];
+    UINTN BusesScanned = Ctx->BusesScanned;
+    EFI_STATUS Status = EFI_SUCCESS;
+
+    ZeroMem( Pending, sizeof(Pending) );
+    Pending[MinBus / 32] |= 1u << (MinBus % 32);
+
+    // secondary buses are always above the bridge's own bus
+    for (UINT16 Bus = MinBus; Bus <= MaxBus && !EFI_ERROR(Status); Bus++) {
+        if ((Ctx->Flags & PCI_ENUM_TOPOLOGY) == 0 ||
+            (Pending[Bus / 32] & (1u << (Bus % 32)))) {
+            Status = PciScanBus( Ctx, RootBridge, Bus, MinBus, MaxBus, Pending );
+        }
+    }
+
+    BusesScanned = Ctx->BusesScanned - BusesScanned;
+    Ctx->ProbesSkipped += ((UINTN)(MaxBus - MinBus + 1) - BusesScanned) * (PCI_MAX_DEVICE + 1);
+
+    return Status;
+}
+
+
+STATIC
+INTN
+EFIAPI
+PciCompareRecord( CONST VOID *Left,
+                  CONST VOID *Right )
+{
+    CONST PCI_DEVICE_RECORD *L = (CONST PCI_DEVICE_RECORD *) Left;
+    CONST PCI_DEVICE_RECORD *R = (CONST PCI_DEVICE_RECORD *) Right;
+
+    if (L->Segment != R->Segment) {
+        return (L->Segment < R->Segment) ? -1 : 1;
+    }
+    if (L->Bus != R->Bus) {
+        return (INTN)L->Bus - (INTN)R->Bus;
+    }
+    if (L->Device != R->Device) {
+        return (INTN)L->Device - (INTN)R->Device;
+    }
+
+    return (INTN)L->Function - (INTN)R->Function;
+}
+
+
+//
+// Collect the bus ranges of every root bridge. Root bridges that do not
+// implement Configuration() decode all buses.
+//
+STATIC
+EFI_STATUS
+PciCollectBusRanges( PCI_ENUM_CONTEXT *Ctx,
+                     PCI_BUS_RANGE **Ranges,
+                     UINTN *RangeCount )
+{
+    EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *IoDev;
+    EFI_ACPI_ADDRESS_SPACE_DESCRIPTOR *Descriptors;
+    PCI_BUS_RANGE *NewRanges;
+    EFI_STATUS Status;
+    UINTN Capacity = 0;
+    BOOLEAN IsEnd;
+    UINT16 MinBus, MaxBus;
+
+    *Ranges = NULL;
+    *RangeCount = 0;
+
+    for (UINT16 Index = 0; Index < Ctx->RootBridgeCount; Index++) {
+        IoDev = Ctx->RootBridges[Index];
+        Status = IoDev->Configuration( IoDev, (VOID **) &Descriptors );
+        if (Status == EFI_UNSUPPORTED) {
+            Descriptors = NULL;
+        } else if (EFI_ERROR(Status)) {
+            goto Error;
+        }
+
+        while (TRUE) {
+            Status = PciGetNextBusRange( &Descriptors, &MinBus, &MaxBus, &IsEnd );
+            if (EFI_ERROR(Status)) {
+                goto Error;
+            }
+
+            if ( IsEnd ) {
+                break;
+            }
+
+            if (*RangeCount == Capacity) {
+                NewRanges = ReallocatePool( Capacity * sizeof(PCI_BUS_RANGE),
+                                            (Capacity + 8) * sizeof(PCI_BUS_RANGE),
+                                            *Ranges );
+                if (NewRanges == NULL) {
+                    Status = EFI_OUT_OF_RESOURCES;
+                    goto Error;
+                }
+                *Ranges = NewRanges;
+                Capacity += 8;
+            }
+
+            (*Ranges)[*RangeCount].RootBridge = Index;
+            (*Ranges)[*RangeCount].MinBus = MinBus;
+            (*Ranges)[*RangeCount].MaxBus = MaxBus;
+            (*Ranges)[*RangeCount].Done = FALSE;
+            (*RangeCount)++;
+
+            if ( Descriptors == NULL ) {
+                break;
+            }
+        }
+    }
+
+    return EFI_SUCCESS;
+
+Error:
+    if (*Ranges != NULL) {
+        FreePool( *Ranges );
+        *Ranges = NULL;
+    }
+    *RangeCount = 0;
+
+    return Status;
+}
+
+
+//
+// TRUE if every bus of the range can be reached through ECAM, i.e. without
+// calling the root bridge I/O protocol
+//
+STATIC
+BOOLEAN
+PciEcamCoversRange( PCI_ENUM_CONTEXT *Ctx,
+                    PCI_BUS_RANGE *Range )
+{
+    UINT32 Segment = Ctx->RootBridges[Range->RootBridge]->SegmentNumber;
+
+    for (UINT16 Bus = Range->MinBus; Bus <= Range->MaxBus; Bus++) {
+        if (PciEcamAddress( Ctx, Segment, Bus, 0, 0 ) == 0) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+
+//
+// AP procedure. Each AP scans every WorkerCount'th item starting at its own
+// worker index into its own preallocated buffer; nothing is shared for
+// writing, so no locking is needed.
+//
+STATIC
+VOID
+EFIAPI
+PciScanWorker( VOID *Buffer )
+{
+    PCI_PARALLEL_SCAN *Parallel = (PCI_PARALLEL_SCAN *) Buffer;
+    PCI_ENUM_WORKER *Worker;
+    PCI_BUS_RANGE *Item;
+    UINTN Processor;
+    UINTN Slot;
+
+    if (EFI_ERROR(Parallel->Mp->WhoAmI( Parallel->Mp, &Processor )) ||
+        Processor >= Parallel->ProcessorCount ||
+        Parallel->WorkerOfProcessor[Processor] >= Parallel->WorkerCount) {
+        return;
+    }
+
+    Slot = Parallel->WorkerOfProcessor[Processor];
+    Worker = &Parallel->Workers[Slot];
+    Worker->Status = EFI_SUCCESS;
+
+    for (UINTN Index = Slot; Index < Parallel->ItemCount; Index += Parallel->WorkerCount) {
+        Item = &Parallel->Items[Index];
+        Worker->Status = PciScanBusRange( &Worker->Ctx, Item->RootBridge, Item->MinBus, Item->MaxBus );
+        if (EFI_ERROR(Worker->Status)) {
+            break;
+        }
+    }
+}
+
+
+//
+// Scan the ECAM covered ranges on the APs and merge the results. Without
+// topology following, every bus is independent and ranges are split so
+// that a single segment still spreads across all APs. Returns
+// EFI_UNSUPPORTED, with no range marked done, when the caller should scan
+// everything on the BSP instead.
+//
+STATIC
+EFI_STATUS
+PciScanParallel( PCI_ENUM_CONTEXT *Ctx,
+                 PCI_BUS_RANGE *Ranges,
+                 UINTN RangeCount )
+{
+    EFI_PROCESSOR_INFORMATION ProcessorInfo;
+    PCI_PARALLEL_SCAN Parallel;
+    PCI_ENUM_CONTEXT *WorkerCtx;
+    PCI_BUS_RANGE *Item;
+    EFI_STATUS Status;
+    UINTN EnabledCount;
+    UINTN Buses, Chunk, Capacity;
+
+    ZeroMem( &Parallel, sizeof(Parallel) );
+
+    Status = gBS->LocateProtocol( &gEfiMpServiceProtocolGuid,
+                                  NULL,
+                                  (VOID **) &Parallel.Mp );
+    if (EFI_ERROR(Status)) {
+        return EFI_UNSUPPORTED;
+    }
+
+    Status = Parallel.Mp->GetNumberOfProcessors( Parallel.Mp,
+                                                 &Parallel.ProcessorCount,
+                                                 &EnabledCount );
+    if (EFI_ERROR(Status) || EnabledCount < 2) {
+        return EFI_UNSUPPORTED;
+    }
+
+    Parallel.WorkerOfProcessor = AllocatePool( Parallel.ProcessorCount * sizeof(UINTN) );
+    if (Parallel.WorkerOfProcessor == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    // enabled APs get worker slots, everything else is left idle
+    for (UINTN Proc = 0; Proc < Parallel.ProcessorCount; Proc++) {
+        Parallel.WorkerOfProcessor[Proc] = MAX_UINTN;
+        Status = Parallel.Mp->GetProcessorInfo( Parallel.Mp, Proc, &ProcessorInfo );
+        if (!EFI_ERROR(Status) &&
+            (ProcessorInfo.StatusFlag & PROCESSOR_ENABLED_BIT) &&
+            !(ProcessorInfo.StatusFlag & PROCESSOR_AS_BSP_BIT)) {
+            Parallel.WorkerOfProcessor[Proc] = Parallel.WorkerCount++;
+        }
+    }
+    if (Parallel.WorkerCount == 0) {
+        Status = EFI_UNSUPPORTED;
+        goto Done;
+    }
+
+    // at most WorkerCount pieces per range
+    Parallel.Items = AllocatePool( RangeCount * Parallel.WorkerCount * sizeof(PCI_BUS_RANGE) );
+    Parallel.Workers = AllocateZeroPool( Parallel.WorkerCount * sizeof(PCI_ENUM_WORKER) );
+    if (Parallel.Items == NULL || Parallel.Workers == NULL) {
+        Status = EFI_OUT_OF_RESOURCES;
+        goto Done;
+    }
+
+    for (UINTN Index = 0; Index < RangeCount; Index++) {
+        if (!PciEcamCoversRange( Ctx, &Ranges[Index] )) {
+            continue;
+        }
+
+        Buses = Ranges[Index].MaxBus - Ranges[Index].MinBus + 1;
+        Chunk = Buses;
+        if ((Ctx->Flags & PCI_ENUM_TOPOLOGY) == 0) {
+            Chunk = (Buses + Parallel.WorkerCount - 1) / Parallel.WorkerCount;
+        }
+
+        for (UINTN Bus = Ranges[Index].MinBus; Bus <= Ranges[Index].MaxBus; Bus += Chunk) {
+            Item = &Parallel.Items[Parallel.ItemCount++];
+            Item->RootBridge = Ranges[Index].RootBridge;
+            Item->MinBus = (UINT16) Bus;
+            Item->MaxBus = (UINT16) MIN( Bus + Chunk - 1, Ranges[Index].MaxBus );
+        }
+    }
+    if (Parallel.ItemCount == 0) {
+        Status = EFI_UNSUPPORTED;
+        goto Done;
+    }
+
+    // size each AP's buffer for every function of every bus it is given
+    for (UINTN Slot = 0; Slot < Parallel.WorkerCount; Slot++) {
+        Capacity = 0;
+        for (UINTN Index = Slot; Index < Parallel.ItemCount; Index += Parallel.WorkerCount) {
+            Item = &Parallel.Items[Index];
+            Capacity += (Item->MaxBus - Item->MinBus + 1) * (PCI_MAX_DEVICE + 1) * (PCI_MAX_FUNC + 1);
+        }
+
+        WorkerCtx = &Parallel.Workers[Slot].Ctx;
+        WorkerCtx->Flags = Ctx->Flags;
+        WorkerCtx->RootBridges = Ctx->RootBridges;
+        WorkerCtx->RootBridgeCount = Ctx->RootBridgeCount;
+        WorkerCtx->EcamWindows = Ctx->EcamWindows;
+        WorkerCtx->EcamWindowCount = Ctx->EcamWindowCount;
+        WorkerCtx->FixedCapacity = TRUE;
+        Parallel.Workers[Slot].Status = EFI_NOT_STARTED;
+        if (Capacity > 0) {
+            WorkerCtx->Devices = AllocatePool( Capacity * sizeof(PCI_DEVICE_RECORD) );
+            if (WorkerCtx->Devices == NULL) {
+                Status = EFI_OUT_OF_RESOURCES;
+                goto Done;
+            }
+            WorkerCtx->DeviceCapacity = Capacity;
+        } else {
+            Parallel.Workers[Slot].Status = EFI_SUCCESS;
+        }
+    }
+
+    Status = Parallel.Mp->StartupAllAPs( Parallel.Mp,
+                                         PciScanWorker,
+                                         FALSE,
+                                         NULL,
+                                         0,
+                                         &Parallel,
+                                         NULL );
+    if (EFI_ERROR(Status)) {
+        Status = EFI_UNSUPPORTED;
+        goto Done;
+    }
+
+    for (UINTN Slot = 0; Slot < Parallel.WorkerCount; Slot++) {
+        if (EFI_ERROR(Parallel.Workers[Slot].Status)) {
+            Status = EFI_UNSUPPORTED;
+            goto Done;
+        }
+    }
+
+    // merge the per-AP buffers
+    for (UINTN Slot = 0; Slot < Parallel.WorkerCount; Slot++) {
+        WorkerCtx = &Parallel.Workers[Slot].Ctx;
+        Status = PciReserveRecords( Ctx, WorkerCtx->DeviceCount );
+        if (EFI_ERROR(Status)) {
+            goto Done;
+        }
+        CopyMem( &Ctx->Devices[Ctx->DeviceCount], WorkerCtx->Devices,
+                 WorkerCtx->DeviceCount * sizeof(PCI_DEVICE_RECORD) );
+        Ctx->DeviceCount   += WorkerCtx->DeviceCount;
+        Ctx->BusesScanned  += WorkerCtx->BusesScanned;
+        Ctx->Probes        += WorkerCtx->Probes;
+        Ctx->ProbesSkipped += WorkerCtx->ProbesSkipped;
+        Ctx->ConfigCalls   += WorkerCtx->ConfigCalls;
+        Ctx->ConfigDwords  += WorkerCtx->ConfigDwords;
+    }
+
+    for (UINTN Index = 0; Index < RangeCount; Index++) {
+        Ranges[Index].Done = PciEcamCoversRange( Ctx, &Ranges[Index] );
+    }
+    Ctx->ApWorkers = Parallel.WorkerCount;
+
+Done:
+    if (Parallel.Workers != NULL) {
+        for (UINTN Slot = 0; Slot < Parallel.WorkerCount; Slot++) {
+            if (Parallel.Workers[Slot].Ctx.Devices != NULL) {
+                FreePool( Parallel.Workers[Slot].Ctx.Devices );
+            }
+        }
+        FreePool( Parallel.Workers );
+    }
+    if (Parallel.Items != NULL) {
+        FreePool( Parallel.Items );
+    }
+    FreePool( Parallel.WorkerOfProcessor );
+
+    return Status;
+}
+
+
+EFI_STATUS
+EFIAPI
+PciEnumInit( PCI_ENUM_CONTEXT *Ctx,
+             UINT32 Flags )
+{
+    EFI_GUID gEfiPciEnumerationCompleteProtocolGuid = EFI_PCI_EMUMERATION_COMPLETE_GUID;
+    EFI_ACPI_MEMORY_MAPPED_CONFIGURATION_BASE_ADDRESS_TABLE_HEADER *Mcfg;
+    EFI_HANDLE *HandleBuf = NULL;
+    EFI_STATUS Status;
+    UINTN HandleCount;
+    VOID *Interface;
+
+    ZeroMem( Ctx, sizeof(PCI_ENUM_CONTEXT) );
+    Ctx->Flags = Flags;
+
+    Status = gBS->LocateProtocol( &gEfiPciEnumerationCompleteProtocolGuid,
+                                  NULL,
+                                  &Interface );
+    if (EFI_ERROR(Status)) {
+        return EFI_NOT_READY;
+    }
+
+    Status = gBS->LocateHandleBuffer( ByProtocol,
+                                      &gEfiPciRootBridgeIoProtocolGuid,
+                                      NULL,
+                                      &HandleCount,
+                                      &HandleBuf );
+    if (EFI_ERROR(Status) || HandleCount == 0) {
+        return EFI_NOT_FOUND;
+    }
+
+    Ctx->RootBridges = AllocateZeroPool( HandleCount * sizeof(EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *) );
+    if (Ctx->RootBridges == NULL) {
+        FreePool( HandleBuf );
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    for (UINTN Index = 0; Index < HandleCount; Index++) {
+        Status = gBS->HandleProtocol( HandleBuf[Index],
+                                      &gEfiPciRootBridgeIoProtocolGuid,
+                                      (VOID **) &Ctx->RootBridges[Ctx->RootBridgeCount] );
+        if (!EFI_ERROR(Status)) {
+            Ctx->RootBridgeCount++;
+        }
+    }
+    FreePool( HandleBuf );
+
+    if (Ctx->RootBridgeCount == 0) {
+        PciEnumFree( Ctx );
+        return EFI_NOT_FOUND;
+    }
+
+    // memory-mapped configuration access unless told otherwise
+    if ((Flags & PCI_ENUM_NO_ECAM) == 0) {
+        Mcfg = PciFindMcfgTable();
+        if (Mcfg != NULL && Mcfg->Header.Length >= sizeof(*Mcfg)) {
+            Ctx->EcamWindows = (PCI_ECAM_WINDOW *)(Mcfg + 1);
+            Ctx->EcamWindowCount = (Mcfg->Header.Length - sizeof(*Mcfg)) / sizeof(PCI_ECAM_WINDOW);
+        }
+    }
+
+    return EFI_SUCCESS;
+}
+
+
+EFI_STATUS
+EFIAPI
+PciEnumScan( PCI_ENUM_CONTEXT *Ctx,
+             BOOLEAN Refresh )
+{
+    PCI_BUS_RANGE *Ranges;
+    EFI_STATUS Status;
+    UINTN RangeCount;
+
+    if (Ctx->Scanned && !Refresh) {
+        return EFI_SUCCESS;
+    }
+
+    Ctx->Scanned = FALSE;
+    Ctx->DeviceCount = 0;
+    Ctx->ApWorkers = 0;
+
+    Status = PciCollectBusRanges( Ctx, &Ranges, &RangeCount );
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+
+    if (Ctx->Flags & PCI_ENUM_PARALLEL) {
+        Status = PciScanParallel( Ctx, Ranges, RangeCount );
+        if (EFI_ERROR(Status) && Status != EFI_UNSUPPORTED) {
+            goto Done;
+        }
+    }
+
+    // whatever the APs did not scan
+    for (UINTN Index = 0; Index < RangeCount; Index++) {
+        if (Ranges[Index].Done) {
+            continue;
+        }
+        Status = PciScanBusRange( Ctx, Ranges[Index].RootBridge,
+                                  Ranges[Index].MinBus, Ranges[Index].MaxBus );
+        if (EFI_ERROR(Status)) {
+            goto Done;
+        }
+    }
+
+    // root bridges are not necessarily reported in bus order
+    for (UINTN Index = 1; Index < Ctx->DeviceCount; Index++) {
+        if (PciCompareRecord( &Ctx->Devices[Index - 1], &Ctx->Devices[Index] ) > 0) {
+            PerformQuickSort( Ctx->Devices, Ctx->DeviceCount, sizeof(PCI_DEVICE_RECORD), PciCompareRecord );
+            break;
+        }
+    }
+
+    Ctx->Scanned = TRUE;
+    Status = EFI_SUCCESS;
+
+Done:
+    if (Ranges != NULL) {
+        FreePool( Ranges );
+    }
+
+    return Status;
+}
+
+
+PCI_DEVICE_RECORD *
+EFIAPI
+PciEnumFindDevice( PCI_ENUM_CONTEXT *Ctx,
+                   UINT32 Segment,
+                   UINT8 Bus,
+                   UINT8 Device,
+                   UINT8 Function )
+{
+    PCI_DEVICE_RECORD Key;
+    UINTN Low = 0;
+    UINTN High = Ctx->DeviceCount;
+    UINTN Mid;
+    INTN  Result;
+
+    Key.Segment  = Segment;
+    Key.Bus      = Bus;
+    Key.Device   = Device;
+    Key.Function = Function;
+
+    while (Low < High) {
+        Mid = Low + (High - Low) / 2;
+        Result = PciCompareRecord( &Ctx->Devices[Mid], &Key );
+        if (Result == 0) {
+            return &Ctx->Devices[Mid];
+        } else if (Result < 0) {
+            Low = Mid + 1;
+        } else {
+            High = Mid;
+        }
+    }
+
+    return NULL;
+}
+
+
+PCI_DEVICE_RECORD *
+EFIAPI
+PciEnumFindNext( PCI_ENUM_CONTEXT *Ctx,
+                 PCI_DEVICE_RECORD *Previous,
+                 UINT16 VendorId,
+                 UINT16 DeviceId )
+{
+    UINTN Index = (Previous == NULL) ? 0 : (UINTN)(Previous - Ctx->Devices) + 1;
+
+    for (; Index < Ctx->DeviceCount; Index++) {
+        if ((VendorId == PCI_ENUM_ANY || Ctx->Devices[Index].VendorId == VendorId) &&
+            (DeviceId == PCI_ENUM_ANY || Ctx->Devices[Index].DeviceId == DeviceId)) {
+            return &Ctx->Devices[Index];
+        }
+    }
+
+    return NULL;
+}
+
+
+PCI_DEVICE_RECORD *
+EFIAPI
+PciEnumFindNextClass( PCI_ENUM_CONTEXT *Ctx,
+                      PCI_DEVICE_RECORD *Previous,
+                      UINT16 BaseClass,
+                      UINT16 SubClass )
+{
+    UINTN Index = (Previous == NULL) ? 0 : (UINTN)(Previous - Ctx->Devices) + 1;
+
+    for (; Index < Ctx->DeviceCount; Index++) {
+        if ((BaseClass == PCI_ENUM_ANY || Ctx->Devices[Index].ClassCode[2] == BaseClass) &&
+            (SubClass == PCI_ENUM_ANY || Ctx->Devices[Index].ClassCode[1] == SubClass)) {
+            return &Ctx->Devices[Index];
+        }
+    }
+
+    return NULL;
+}
+
+
+UINTN
+EFIAPI
+PciEnumConfigSize( PCI_ENUM_CONTEXT *Ctx,
+                   CONST PCI_DEVICE_RECORD *Record )
+{
+    if (PciEcamAddress( Ctx, Record->Segment, Record->Bus, Record->Device, Record->Function ) != 0) {
+        return PCI_ENUM_EXTENDED_SIZE;
+    }
+
+    return PCI_ENUM_CONFIG_SIZE;
+}
+
+
+EFI_STATUS
+EFIAPI
+PciEnumReadConfig( PCI_ENUM_CONTEXT *Ctx,
+                   CONST PCI_DEVICE_RECORD *Record,
+                   UINTN Offset,
+                   UINTN Count,
+                   UINT32 *Buffer )
+{
+    if (Record->RootBridge >= Ctx->RootBridgeCount ||
+        (Offset & 3) != 0 ||
+        Offset + Count * sizeof(UINT32) > PciEnumConfigSize( Ctx, Record )) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    return PciReadConfig( Ctx, Ctx->RootBridges[Record->RootBridge],
+                          Record->Bus, Record->Device, Record->Function,
+                          Offset, Count, Buffer );
+}
+
+
+VOID
+EFIAPI
+PciEnumFree( PCI_ENUM_CONTEXT *Ctx )
+{
+    if (Ctx->RootBridges != NULL) {
+        FreePool( Ctx->RootBridges );
+    }
+    if (Ctx->Devices != NULL) {
+        FreePool( Ctx->Devices );
+    }
+    ZeroMem( Ctx, sizeof(PCI_ENUM_CONTEXT) );
+}
@@ -0,0 +1,38 @@
+//
+//  Copyright (c) 2017 - 2019   Finnbarr P. Murphy.   All rights reserved.
+//
+//  TSC timing library
+//
+//  License: BSD 2 clause License
+//
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+#include <Library/TscTimerLib.h>
+
+
+UINT64
+EFIAPI
+TscFrequency( VOID )
+{
+    UINT64 Start = AsmReadTsc();
+
+    gBS->Stall( 10000 );
+
+    return (AsmReadTsc() - Start) * 100;
+}
+
+
+UINT64
+EFIAPI
+TscToMicroseconds( UINT64 Ticks,
+                   UINT64 Frequency )
+{
+    if (Frequency == 0) {
+        return 0;
+    }
+
+    return (Ticks * 1000) / (Frequency / 1000);
+}
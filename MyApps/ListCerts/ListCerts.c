@@ -17,6 +17,7 @@
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/UefiRuntimeServicesTableLib.h>
 #include <Library/PrintLib.h>
+#include <Library/SortLib.h>
 
 #include <Guid/GlobalVariable.h>
 #include <Guid/WinCertificate.h>
@@ -24,475 +25,1505 @@
 
 #include <Protocol/LoadedImage.h>
 
+#include <IndustryStandard/PeImage.h>
+
 #include "oid_registry.h"
 #include "x509.h"
+#include "x509_actions.h"
+#include "x509_cert.h"
 #include "asn1_ber_decoder.h"
+#include "sha1.h"
+#include "sha256.h"
 
-#define UTCDATE_LEN 23
 #define UTILITY_VERSION L"20190403"
 #undef DEBUG
 
-// temporary store for output text
-CHAR16 tmpbuf[1000];
-int    wrapno = 1;
+// the x509 grammar nests no deeper than this, so the decoder's cons
+// stack stays off the pool even for certificates over 64 KiB
+#define CERT_NESTING_DEPTH  10
+
+// --stats: report the text buffer allocations made decoding each certificate,
+// or the file writes made by --export
+BOOLEAN ShowStats = FALSE;
+
+// SHA256 signatures from one or more EFI_CERT_SHA256 lists, sorted and
+// deduplicated so that a lookup is a binary search
+typedef struct {
+    UINT8   *Hashes;                // Count digests of SHA256_DIGEST_SIZE
+    UINTN   Count;
+    UINTN   Total;                  // entries seen, including duplicates
+    UINTN   Lists;
+} HASH_STORE;
+
+// export output is gathered here and written in large chunks
+#define EXPORT_BUFFER_SIZE  65536
+#define PEM_LINE_BYTES      48        // 64 base64 characters
+
+typedef struct {
+    SHELL_FILE_HANDLE Handle;
+    UINT8       *Buffer;
+    UINTN       Used;
+    EFI_STATUS  Status;             // first write error, if any
+    UINTN       Writes;
+} FILE_WRITER;
+
+// shim keeps the Machine Owner Key list under its own GUID
+#define SHIM_LOCK_GUID \
+    { 0x605dab50, 0xe046, 0x4300, { 0xab, 0xb6, 0x3d, 0xd8, 0x10, 0xdd, 0x8b, 0x23 } }
+
+// --verify parses every certificate once into an arena and finds issuers
+// through a hash of the subject DN
+#define CERT_ARENA_CHUNK    65536
+#define CHAIN_MAX_DEPTH     8
+
+typedef struct _ARENA_CHUNK {
+    struct _ARENA_CHUNK *Next;
+    UINTN       Used;               // including this header
+    UINTN       Size;
+} ARENA_CHUNK;
+
+typedef struct _STORE_CERT {
+    X509_CERT   Cert;
+    BOOLEAN     Parsed;
+    CHAR16      *Var;
+    UINTN       Index;              // X509 entry number within Var
+    struct _STORE_CERT *Next;       // in load order
+    struct _STORE_CERT *NextInBucket;
+    BOOLEAN     Checked;            // Issuer and IssuerStatus are valid
+    struct _STORE_CERT *Issuer;     // itself when self-signed
+    EFI_STATUS  IssuerStatus;
+} STORE_CERT;
+
+typedef struct {
+    ARENA_CHUNK *Chunks;
+    STORE_CERT  *First;
+    STORE_CERT  *Last;
+    UINTN       Count;
+    STORE_CERT  **Buckets;
+    UINTN       BucketCount;        // a power of two
+} CERT_STORE;
 
 
-CHAR16 *
-AsciiToUnicode( const char *Str, 
-                int Len )
+VOID
+PrintDigest( CHAR16 *Label,
+             UINT8 *Digest,
+             UINTN Size )
 {
-    CHAR16 *Ret = NULL;
+    Print(L"%s", Label);
+    for (UINTN Index = 0; Index < Size; Index++) {
+        Print(L"%02x", Digest[Index]);
+    }
+    Print(L"\n");
+}
 
-    Ret = AllocateZeroPool(Len*2 + 2);
-    if (!Ret)
-        return NULL;
 
-    for (int i = 0; i < Len; i++)
-        Ret[i] = Str[i];
+//
+// Length of the outer DER SEQUENCE, so that any padding in the signature
+// entry is kept out of the fingerprint. Falls back to the entry size.
+//
+UINTN
+CertDerLength( UINT8 *Der,
+               UINTN Size )
+{
+    UINTN Length;
+    UINTN Octets;
+
+    if (Size < 2 || Der[0] != 0x30) {
+        return Size;
+    }
+    if (Der[1] < 0x80) {
+        Length = 2 + Der[1];
+    } else {
+        Octets = Der[1] & 0x7f;
+        if (Octets == 0 || Octets > 4 || Size < 2 + Octets) {
+            return Size;
+        }
+        Length = 0;
+        for (UINTN Index = 0; Index < Octets; Index++) {
+            Length = (Length << 8) | Der[2 + Index];
+        }
+        Length += 2 + Octets;
+    }
 
-    return Ret;
+    return (Length <= Size) ? Length : Size;
 }
 
 
-int 
-do_version( void *context, 
-            long state_index,
-            unsigned char tag,
-            const void *value, 
-            long vlen )
+VOID
+PrintFingerprints( UINT8 *Der,
+                   UINTN Size )
 {
-    int Version = *(const char *)value;
+    SHA1_CONTEXT   Sha1;
+    SHA256_CONTEXT Sha256;
+    UINT8          Digest[SHA256_DIGEST_SIZE];
 
-    Print(L"  Version: %d (0x%02x) ", Version + 1, Version);
+    Size = CertDerLength( Der, Size );
 
-    return 0;
+    Sha1Reset( &Sha1 );
+    Sha1Input( &Sha1, Der, Size );
+    Sha1Result( &Sha1, Digest );
+    PrintDigest( L"  SHA1 Fingerprint:   ", Digest, SHA1_DIGEST_SIZE );
+
+    Sha256Reset( &Sha256 );
+    Sha256Input( &Sha256, Der, Size );
+    Sha256Result( &Sha256, Digest );
+    PrintDigest( L"  SHA256 Fingerprint: ", Digest, SHA256_DIGEST_SIZE );
 }
 
 
 int
-do_signature( void *context, 
-              long state_index,
-              unsigned char tag,
-              const void *value,
-              long vlen )
+PrintCertificates( UINT8 *data, 
+                   UINTN len, 
+                   CHAR16 *name,
+                   TEXT_BUILDER *Text )
 {
-    Print(L"  Signature Algorithm: %s\n", tmpbuf);
-    tmpbuf[0] = '\0';
+    EFI_SIGNATURE_LIST *CertList = (EFI_SIGNATURE_LIST *)data;
+    EFI_SIGNATURE_DATA *Cert;
+    EFI_GUID gX509 = EFI_CERT_X509_GUID;
+    EFI_GUID gPKCS7 = EFI_CERT_TYPE_PKCS7_GUID;
+    EFI_GUID gRSA2048 = EFI_CERT_RSA2048_GUID;
+    EFI_GUID gSHA256 = EFI_CERT_SHA256_GUID;
+    BOOLEAN  CertFound = FALSE;
+    CHAR16   *ext;
+    UINTN    Allocations;
+    UINTN    DataSize = len;
+    UINTN    CertCount = 0;
+    UINTN    buflen;
+    int      status = 0;
+
+    while ((DataSize >= sizeof(EFI_SIGNATURE_LIST)) && (DataSize >= CertList->SignatureListSize)) {
+        if (CertList->SignatureSize == 0 ||
+            CertList->SignatureListSize < sizeof(EFI_SIGNATURE_LIST) + CertList->SignatureHeaderSize) {
+            Print(L"\nERROR: Malformed signature list in %s\n", name);
+            break;
+        }
+        CertCount = (CertList->SignatureListSize - sizeof(EFI_SIGNATURE_LIST) - CertList->SignatureHeaderSize) / CertList->SignatureSize;
+        Cert = (EFI_SIGNATURE_DATA *) ((UINT8 *) CertList + sizeof (EFI_SIGNATURE_LIST) + CertList->SignatureHeaderSize);
+
+        if (CompareGuid(&CertList->SignatureType, &gX509))
+            ext = L"X509";
+        else if (CompareGuid(&CertList->SignatureType, &gPKCS7))
+            ext = L"PKCS7";
+        else if (CompareGuid(&CertList->SignatureType, &gRSA2048))
+            ext = L"RSA2048";
+        else if (CompareGuid(&CertList->SignatureType, &gSHA256))
+            ext = L"SHA256";
+        else 
+            ext = L"Unknown";
+
+        for (UINTN Index = 0; Index < CertCount; Index++) {
+            // hashes are summarized by PrintHashTotals
+            if ( CertList->SignatureSize > 100 ) {
+                CertFound = TRUE;
+                Print(L"\nType: %s  (GUID: %g)\n", ext, &Cert->SignatureOwner);
+                buflen  = CertList->SignatureSize-sizeof(EFI_GUID);
+                TextReset(Text);
+                Text->Truncated = FALSE;
+                Allocations = mTextAllocations;
+                status = asn1_ber_decoder_ex(&x509_decoder, Text, Cert->SignatureData, buflen, CERT_NESTING_DEPTH);
+                PrintFingerprints( Cert->SignatureData, buflen );
+                if (ShowStats) {
+                    Print(L"  Text buffer allocations: %d\n", mTextAllocations - Allocations);
+                }
+            }
+            Cert = (EFI_SIGNATURE_DATA *) ((UINT8 *) Cert + CertList->SignatureSize);
+        }
+        DataSize -= CertList->SignatureListSize;
+        CertList = (EFI_SIGNATURE_LIST *) ((UINT8 *) CertList + CertList->SignatureListSize);
+    }
+
+    if ( CertFound == FALSE ) {
+       Print(L"\nNo certificates found for this database\n");
+    }
+
+    return status;
+}
 
-    return 0;
+
+INTN
+EFIAPI
+CompareHash( CONST VOID *Left,
+             CONST VOID *Right )
+{
+    return CompareMem( Left, Right, SHA256_DIGEST_SIZE );
 }
 
 
-int
-do_algorithm( void *context,
-              long state_index,
-              unsigned char tag,
-              const void *value, 
-              long vlen )
-{
-    enum OID oid; 
-    CHAR16 buffer[100];
-
-    oid = Lookup_OID(value, vlen);
-    Sprint_OID(value, vlen, buffer, sizeof(buffer));
-    if (oid == OID_id_dsa_with_sha1)
-        StrCpy(tmpbuf, L"id_dsa_with_sha1");
-    else if (oid == OID_id_dsa)
-        StrCpy(tmpbuf, L"id_dsa");
-    else if (oid == OID_id_ecdsa_with_sha1)
-        StrCpy(tmpbuf, L"id_ecdsa_with_sha1");
-    else if (oid == OID_id_ecPublicKey)
-        StrCpy(tmpbuf, L"id_ecPublicKey");
-    else if (oid == OID_rsaEncryption)
-        StrCpy(tmpbuf, L"rsaEncryption");
-    else if (oid == OID_md2WithRSAEncryption)
-        StrCpy(tmpbuf, L"md2WithRSAEncryption");
-    else if (oid == OID_md3WithRSAEncryption)
-        StrCpy(tmpbuf, L"md3WithRSAEncryption");
-    else if (oid == OID_md4WithRSAEncryption)
-        StrCpy(tmpbuf, L"md4WithRSAEncryption");
-    else if (oid == OID_sha1WithRSAEncryption)
-        StrCpy(tmpbuf, L"sha1WithRSAEncryption");
-    else if (oid == OID_sha256WithRSAEncryption)
-        StrCpy(tmpbuf, L"sha256WithRSAEncryption");
-    else if (oid == OID_sha384WithRSAEncryption)
-        StrCpy(tmpbuf, L"sha384WithRSAEncryption");
-    else if (oid == OID_sha512WithRSAEncryption)
-        StrCpy(tmpbuf, L"sha512WithRSAEncryption");
-    else if (oid == OID_sha224WithRSAEncryption)
-        StrCpy(tmpbuf, L"sha224WithRSAEncryption");
-    else {
-        StrCat(tmpbuf, L" (");
-        StrCat(tmpbuf, buffer);
-        StrCat(tmpbuf, L")");
-    }
-
-    return 0;
-}
-
-
-int 
-do_serialnumber( void *context, 
-                 long state_index,
-                 unsigned char tag,
-                 const void *value, 
-                 long vlen )
-{
-    char *p = (char *)value;
-
-    Print(L"  Serial Number: ");
-    if (vlen > 4) {
-        for (int i = 0; i < vlen; i++, p++) {
-            Print(L"%02x%c", (UINT8)*p, ((i+1 == vlen)?' ':':'));
+VOID
+FreeHashStore( HASH_STORE *Store )
+{
+    if (Store->Hashes != NULL) {
+        FreePool( Store->Hashes );
+    }
+    ZeroMem( Store, sizeof(HASH_STORE) );
+}
+
+
+//
+// Collect every EFI_CERT_SHA256 signature in a signature database. The
+// first pass sizes the array, the second copies the digests out of the
+// interleaved owner GUIDs. Duplicates are dropped after sorting.
+//
+EFI_STATUS
+LoadHashStore( UINT8 *Data,
+               UINTN Len,
+               HASH_STORE *Store )
+{
+    EFI_SIGNATURE_LIST *CertList;
+    EFI_SIGNATURE_DATA *Cert;
+    EFI_GUID gSHA256 = EFI_CERT_SHA256_GUID;
+    UINTN    DataSize;
+    UINTN    CertCount;
+    UINTN    Unique;
+
+    ZeroMem( Store, sizeof(HASH_STORE) );
+
+    for (int Pass = 0; Pass < 2; Pass++) {
+        CertList = (EFI_SIGNATURE_LIST *)Data;
+        DataSize = Len;
+
+        while (DataSize >= sizeof(EFI_SIGNATURE_LIST) &&
+               DataSize >= CertList->SignatureListSize &&
+               CertList->SignatureSize != 0 &&
+               CertList->SignatureListSize >= sizeof(EFI_SIGNATURE_LIST) + CertList->SignatureHeaderSize) {
+            if (CompareGuid(&CertList->SignatureType, &gSHA256) &&
+                CertList->SignatureSize == sizeof(EFI_GUID) + SHA256_DIGEST_SIZE) {
+                CertCount = (CertList->SignatureListSize - sizeof(EFI_SIGNATURE_LIST) - CertList->SignatureHeaderSize) / CertList->SignatureSize;
+                Cert = (EFI_SIGNATURE_DATA *) ((UINT8 *) CertList + sizeof (EFI_SIGNATURE_LIST) + CertList->SignatureHeaderSize);
+                if (Pass == 0) {
+                    Store->Lists++;
+                    Store->Total += CertCount;
+                } else {
+                    for (UINTN Index = 0; Index < CertCount; Index++) {
+                        CopyMem( Store->Hashes + Store->Count * SHA256_DIGEST_SIZE, Cert->SignatureData, SHA256_DIGEST_SIZE );
+                        Store->Count++;
+                        Cert = (EFI_SIGNATURE_DATA *) ((UINT8 *) Cert + CertList->SignatureSize);
+                    }
+                }
+            }
+            DataSize -= CertList->SignatureListSize;
+            CertList = (EFI_SIGNATURE_LIST *) ((UINT8 *) CertList + CertList->SignatureListSize);
+        }
+
+        if (Pass == 0) {
+            if (Store->Total == 0) {
+                return EFI_SUCCESS;
+            }
+            Store->Hashes = AllocatePool( Store->Total * SHA256_DIGEST_SIZE );
+            if (Store->Hashes == NULL) {
+                ZeroMem( Store, sizeof(HASH_STORE) );
+                return EFI_OUT_OF_RESOURCES;
+            }
         }
     }
-    Print(L"\n");
 
-    return 0;
+    PerformQuickSort( Store->Hashes, Store->Count, SHA256_DIGEST_SIZE, CompareHash );
+
+    Unique = 1;
+    for (UINTN Index = 1; Index < Store->Count; Index++) {
+        if (CompareHash( Store->Hashes + (Unique - 1) * SHA256_DIGEST_SIZE,
+                         Store->Hashes + Index * SHA256_DIGEST_SIZE ) != 0) {
+            if (Unique != Index) {
+                CopyMem( Store->Hashes + Unique * SHA256_DIGEST_SIZE,
+                         Store->Hashes + Index * SHA256_DIGEST_SIZE,
+                         SHA256_DIGEST_SIZE );
+            }
+            Unique++;
+        }
+    }
+    Store->Count = Unique;
+
+    return EFI_SUCCESS;
 }
 
 
-int
-do_issuer( void *context,
-           long  state_index,
-           unsigned char tag,
-           const void *value,
-           long vlen )
+BOOLEAN
+FindHash( HASH_STORE *Store,
+          UINT8 *Digest )
 {
-    Print(L"  Issuer:%s\n", tmpbuf);
-    tmpbuf[0] = '\0';
+    UINTN Low = 0;
+    UINTN High = Store->Count;
+    UINTN Middle;
+    INTN  Result;
+
+    while (Low < High) {
+        Middle = Low + (High - Low) / 2;
+        Result = CompareHash( Digest, Store->Hashes + Middle * SHA256_DIGEST_SIZE );
+        if (Result == 0) {
+            return TRUE;
+        }
+        if (Result < 0) {
+            High = Middle;
+        } else {
+            Low = Middle + 1;
+        }
+    }
 
-    return 0;
+    return FALSE;
 }
 
 
-int
-do_subject( void *context,
-            long state_index,
-            unsigned char tag,
-            const void *value,
-            long vlen )
+VOID
+PrintHashTotals( HASH_STORE *Store )
 {
-    Print(L"  Subject:%s\n", tmpbuf);
-    tmpbuf[0] = '\0';
+    Print(L"\nType: SHA256  Lists: %d  Hashes: %d  Unique: %d  Duplicates: %d\n",
+          Store->Lists, Store->Total, Store->Count, Store->Total - Store->Count);
+}
+
+
+//
+// Authenticode SHA256 of a PE/COFF image: the headers less the checksum
+// and the certificate table entry, the sections in file order, then any
+// trailing data other than the certificate table itself.
+//
+EFI_STATUS
+HashPeImage( UINT8 *Image,
+             UINTN ImageSize,
+             UINT8 *Digest )
+{
+    EFI_IMAGE_DOS_HEADER     *DosHdr = (EFI_IMAGE_DOS_HEADER *)Image;
+    EFI_IMAGE_NT_HEADERS32   *Hdr32;
+    EFI_IMAGE_NT_HEADERS64   *Hdr64;
+    EFI_IMAGE_FILE_HEADER    *FileHdr;
+    EFI_IMAGE_DATA_DIRECTORY *SecDir = NULL;
+    EFI_IMAGE_SECTION_HEADER *Section;
+    EFI_IMAGE_SECTION_HEADER **Sorted = NULL;
+    EFI_IMAGE_SECTION_HEADER *Tmp;
+    EFI_STATUS     Status = EFI_SUCCESS;
+    SHA256_CONTEXT Ctx;
+    UINT8  *CheckSum;
+    UINT8  *HeaderEnd;
+    UINTN  PeOffset;
+    UINTN  SectionOffset;
+    UINTN  SizeOfHeaders;
+    UINTN  NumberOfRvaAndSizes;
+    UINTN  Hashed;
+    UINTN  CertSize = 0;
+
+    if (ImageSize < sizeof(EFI_IMAGE_DOS_HEADER) || DosHdr->e_magic != EFI_IMAGE_DOS_SIGNATURE) {
+        return EFI_UNSUPPORTED;
+    }
+
+    PeOffset = DosHdr->e_lfanew;
+    if (ImageSize < sizeof(EFI_IMAGE_NT_HEADERS64) ||
+        PeOffset > ImageSize - sizeof(EFI_IMAGE_NT_HEADERS64)) {
+        return EFI_UNSUPPORTED;
+    }
+
+    Hdr32 = (EFI_IMAGE_NT_HEADERS32 *)(Image + PeOffset);
+    Hdr64 = (EFI_IMAGE_NT_HEADERS64 *)(Image + PeOffset);
+    if (Hdr32->Signature != EFI_IMAGE_NT_SIGNATURE) {
+        return EFI_UNSUPPORTED;
+    }
+    FileHdr = &Hdr32->FileHeader;
+
+    if (Hdr32->OptionalHeader.Magic == EFI_IMAGE_NT_OPTIONAL_HDR32_MAGIC) {
+        CheckSum = (UINT8 *)&Hdr32->OptionalHeader.CheckSum;
+        SizeOfHeaders = Hdr32->OptionalHeader.SizeOfHeaders;
+        NumberOfRvaAndSizes = Hdr32->OptionalHeader.NumberOfRvaAndSizes;
+        if (NumberOfRvaAndSizes > EFI_IMAGE_DIRECTORY_ENTRY_SECURITY) {
+            SecDir = &Hdr32->OptionalHeader.DataDirectory[EFI_IMAGE_DIRECTORY_ENTRY_SECURITY];
+        }
+    } else if (Hdr64->OptionalHeader.Magic == EFI_IMAGE_NT_OPTIONAL_HDR64_MAGIC) {
+        CheckSum = (UINT8 *)&Hdr64->OptionalHeader.CheckSum;
+        SizeOfHeaders = Hdr64->OptionalHeader.SizeOfHeaders;
+        NumberOfRvaAndSizes = Hdr64->OptionalHeader.NumberOfRvaAndSizes;
+        if (NumberOfRvaAndSizes > EFI_IMAGE_DIRECTORY_ENTRY_SECURITY) {
+            SecDir = &Hdr64->OptionalHeader.DataDirectory[EFI_IMAGE_DIRECTORY_ENTRY_SECURITY];
+        }
+    } else {
+        return EFI_UNSUPPORTED;
+    }
+
+    HeaderEnd = (SecDir != NULL) ? (UINT8 *)(SecDir + 1) : CheckSum + sizeof(UINT32);
+    if (SizeOfHeaders > ImageSize || Image + SizeOfHeaders < HeaderEnd) {
+        return EFI_LOAD_ERROR;
+    }
+
+    SectionOffset = PeOffset + sizeof(UINT32) + sizeof(EFI_IMAGE_FILE_HEADER) + FileHdr->SizeOfOptionalHeader;
+    if (SectionOffset > ImageSize ||
+        FileHdr->NumberOfSections > (ImageSize - SectionOffset) / sizeof(EFI_IMAGE_SECTION_HEADER)) {
+        return EFI_LOAD_ERROR;
+    }
+
+    Sha256Reset( &Ctx );
+    Sha256Input( &Ctx, Image, CheckSum - Image );
+    if (SecDir == NULL) {
+        Sha256Input( &Ctx, CheckSum + sizeof(UINT32), Image + SizeOfHeaders - (CheckSum + sizeof(UINT32)) );
+    } else {
+        Sha256Input( &Ctx, CheckSum + sizeof(UINT32), (UINT8 *)SecDir - (CheckSum + sizeof(UINT32)) );
+        Sha256Input( &Ctx, (UINT8 *)(SecDir + 1), Image + SizeOfHeaders - (UINT8 *)(SecDir + 1) );
+        CertSize = SecDir->Size;
+    }
+    Hashed = SizeOfHeaders;
+
+    if (FileHdr->NumberOfSections > 0) {
+        Sorted = AllocatePool( FileHdr->NumberOfSections * sizeof(EFI_IMAGE_SECTION_HEADER *) );
+        if (Sorted == NULL) {
+            return EFI_OUT_OF_RESOURCES;
+        }
+    }
+
+    // a handful of sections, so an insertion sort on the file offset
+    Section = (EFI_IMAGE_SECTION_HEADER *)(Image + SectionOffset);
+    for (UINTN Index = 0; Index < FileHdr->NumberOfSections; Index++) {
+        UINTN Pos = Index;
+        while (Pos > 0 && Sorted[Pos - 1]->PointerToRawData > Section[Index].PointerToRawData) {
+            Sorted[Pos] = Sorted[Pos - 1];
+            Pos--;
+        }
+        Sorted[Pos] = &Section[Index];
+    }
+
+    for (UINTN Index = 0; Index < FileHdr->NumberOfSections; Index++) {
+        Tmp = Sorted[Index];
+        if (Tmp->SizeOfRawData == 0) {
+            continue;
+        }
+        if (Tmp->PointerToRawData > ImageSize ||
+            Tmp->SizeOfRawData > ImageSize - Tmp->PointerToRawData) {
+            Status = EFI_LOAD_ERROR;
+            goto Done;
+        }
+        Sha256Input( &Ctx, Image + Tmp->PointerToRawData, Tmp->SizeOfRawData );
+        Hashed += Tmp->SizeOfRawData;
+    }
+
+    if (ImageSize > Hashed && CertSize < ImageSize - Hashed) {
+        Sha256Input( &Ctx, Image + Hashed, ImageSize - Hashed - CertSize );
+    }
 
-    return 0;
+    Sha256Result( &Ctx, Digest );
+
+Done:
+    if (Sorted != NULL) {
+        FreePool( Sorted );
+    }
+
+    return Status;
 }
 
 
-int
-do_attribute_type( void *context,
-                   long state_index,
-                   unsigned char tag,
-                   const void *value,
-                   long vlen )
-{
-    enum OID oid; 
-    CHAR16 buffer[60];
-
-    oid = Lookup_OID(value, vlen);
-    Sprint_OID(value, vlen, buffer, sizeof(buffer));
-   
-    if (oid == OID_countryName) {
-        StrCat(tmpbuf, L" C=");
-    } else if (oid == OID_stateOrProvinceName) {
-        StrCat(tmpbuf, L" ST=");
-    } else if (oid == OID_locality) {
-        StrCat(tmpbuf, L" L=");
-    } else if (oid == OID_organizationName) {
-        StrCat(tmpbuf, L" O=");
-    } else if (oid == OID_commonName) {
-        StrCat(tmpbuf, L" CN=");
+EFI_STATUS
+get_variable( CHAR16 *Var, 
+              UINT8 **Data, 
+              UINTN *Len,
+              EFI_GUID Owner )
+{
+    EFI_STATUS Status;
+
+    *Len = 0;
+
+    Status = gRT->GetVariable( Var, &Owner, NULL, Len, NULL );
+    if (Status != EFI_BUFFER_TOO_SMALL)
+        return Status;
+
+    *Data = AllocateZeroPool( *Len );
+    if (!Data)
+        return EFI_OUT_OF_RESOURCES;
+    
+    Status = gRT->GetVariable( Var, &Owner, NULL, Len, *Data );
+    if (Status != EFI_SUCCESS) {
+        FreePool( *Data );
+        *Data = NULL;
+    }
+
+    return Status;
+}
+
+
+VOID
+OutputSignatureData( CHAR16 *Var,
+                     EFI_GUID *Owner,
+                     UINT8 *Data,
+                     UINTN Len,
+                     TEXT_BUILDER *Text )
+{
+    HASH_STORE Store;
+
+    if (Owner != NULL) {
+        Print(L"\nVARIABLE: %s  (GUID: %g  size: %d)\n", Var, Owner, Len);
     } else {
-        StrCat(tmpbuf, L" (");
-        StrCat(tmpbuf, buffer);
-        StrCat(tmpbuf, L")");
+        Print(L"\nVARIABLE: %s  (size: %d)\n", Var, Len);
+    }
+    PrintCertificates( Data, Len, Var, Text );
+    if (LoadHashStore( Data, Len, &Store ) == EFI_SUCCESS && Store.Total > 0) {
+        PrintHashTotals( &Store );
     }
+    FreeHashStore( &Store );
+}
+
 
-    return 0;
+EFI_STATUS
+OutputVariable( CHAR16 *Var, 
+                EFI_GUID Owner,
+                TEXT_BUILDER *Text ) 
+{
+    EFI_STATUS Status = EFI_SUCCESS;
+    UINT8 *Data;
+    UINTN Len;
+
+    Status = get_variable( Var, &Data, &Len, Owner );
+    if (Status == EFI_SUCCESS) {
+        OutputSignatureData( Var, NULL, Data, Len, Text );
+        FreePool( Data );
+    } else if (Status == EFI_NOT_FOUND) {
+#ifdef DEBUG
+        Print(L"Variable %s not found\n", Var);
+#else
+        return Status;
+#endif
+    } else 
+        Print(L"ERROR: Failed to get variable %s. Status Code: %d\n", Var, Status);
+
+    return Status;
 }
 
 
-int
-do_attribute_value( void *context,
-                    long state_index,
-                    unsigned char tag,
-                    const void *value,
-                    long vlen )
+//
+// TRUE if Data is nothing but well formed signature lists of known types.
+// This is how --all tells signature databases from other variables.
+//
+BOOLEAN
+IsSignatureDatabase( UINT8 *Data,
+                     UINTN Len )
 {
-    CHAR16 *ptr;
+    STATIC CONST EFI_GUID SignatureTypes[] = {
+        EFI_CERT_X509_GUID,
+        EFI_CERT_SHA256_GUID,
+        EFI_CERT_SHA1_GUID,
+        EFI_CERT_SHA224_GUID,
+        EFI_CERT_SHA384_GUID,
+        EFI_CERT_SHA512_GUID,
+        EFI_CERT_RSA2048_GUID,
+        EFI_CERT_RSA2048_SHA256_GUID,
+        EFI_CERT_RSA2048_SHA1_GUID,
+        EFI_CERT_X509_SHA256_GUID,
+        EFI_CERT_X509_SHA384_GUID,
+        EFI_CERT_X509_SHA512_GUID,
+        EFI_CERT_TYPE_PKCS7_GUID
+    };
+    EFI_SIGNATURE_LIST *CertList;
+    BOOLEAN Known;
+
+    if (Len < sizeof(EFI_SIGNATURE_LIST)) {
+        return FALSE;
+    }
+
+    while (Len > 0) {
+        CertList = (EFI_SIGNATURE_LIST *)Data;
+        if (Len < sizeof(EFI_SIGNATURE_LIST) ||
+            CertList->SignatureListSize > Len ||
+            CertList->SignatureSize < sizeof(EFI_GUID) ||
+            CertList->SignatureListSize < sizeof(EFI_SIGNATURE_LIST) + CertList->SignatureHeaderSize ||
+            (CertList->SignatureListSize - sizeof(EFI_SIGNATURE_LIST) - CertList->SignatureHeaderSize) % CertList->SignatureSize != 0) {
+            return FALSE;
+        }
+
+        Known = FALSE;
+        for (UINTN Index = 0; Index < ARRAY_SIZE(SignatureTypes); Index++) {
+            if (CompareGuid( &CertList->SignatureType, &SignatureTypes[Index] )) {
+                Known = TRUE;
+                break;
+            }
+        }
+        if (!Known) {
+            return FALSE;
+        }
 
-    ptr = AsciiToUnicode(value, (int)vlen);
-    StrCat(tmpbuf, ptr);
-    FreePool(ptr);
+        Len -= CertList->SignatureListSize;
+        Data += CertList->SignatureListSize;
+    }
 
-    return 0;
+    return TRUE;
 }
 
 
-int
-do_extensions( void *context,
-               long state_index,
-               unsigned char tag,
-               const void *value,
-               long vlen )
+//
+// Walk the variable store once and show every variable holding signature
+// lists. The name and data buffers grow as needed and are reused for
+// every variable.
+//
+EFI_STATUS
+OutputAllVariables( TEXT_BUILDER *Text )
 {
-    Print(L"  Extensions:%s\n", tmpbuf);
-    tmpbuf[0] = '\0';
-    wrapno = 1;
+    EFI_STATUS Status = EFI_SUCCESS;
+    EFI_GUID   Guid;
+    CHAR16     *Name = NULL;
+    CHAR16     *NewName;
+    UINT8      *Data = NULL;
+    UINTN      NameCapacity = 128 * sizeof(CHAR16);
+    UINTN      DataCapacity = 0;
+    UINTN      NameSize;
+    UINTN      DataSize;
+    UINTN      Found = 0;
+
+    Name = AllocateZeroPool( NameCapacity );
+    if (Name == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    for (;;) {
+        NameSize = NameCapacity;
+        Status = gRT->GetNextVariableName( &NameSize, Name, &Guid );
+        if (Status == EFI_BUFFER_TOO_SMALL) {
+            NewName = ReallocatePool( NameCapacity, NameSize, Name );
+            if (NewName == NULL) {
+                Status = EFI_OUT_OF_RESOURCES;
+                goto Done;
+            }
+            Name = NewName;
+            NameCapacity = NameSize;
+            Status = gRT->GetNextVariableName( &NameSize, Name, &Guid );
+        }
+        if (Status == EFI_NOT_FOUND) {
+            Status = EFI_SUCCESS;
+            break;
+        }
+        if (EFI_ERROR(Status)) {
+            Print(L"ERROR: Failed to enumerate variables. Status Code: %d\n", Status);
+            goto Done;
+        }
+
+        DataSize = DataCapacity;
+        Status = gRT->GetVariable( Name, &Guid, NULL, &DataSize, Data );
+        if (Status == EFI_BUFFER_TOO_SMALL) {
+            if (Data != NULL) {
+                FreePool( Data );
+            }
+            Data = AllocatePool( DataSize );
+            if (Data == NULL) {
+                DataCapacity = 0;
+                Status = EFI_OUT_OF_RESOURCES;
+                goto Done;
+            }
+            DataCapacity = DataSize;
+            Status = gRT->GetVariable( Name, &Guid, NULL, &DataSize, Data );
+        }
+        if (EFI_ERROR(Status)) {
+            continue;
+        }
+
+        if (IsSignatureDatabase( Data, DataSize )) {
+            OutputSignatureData( Name, &Guid, Data, DataSize, Text );
+            Found++;
+        }
+    }
+
+    Print(L"\nSignature databases found: %d\n", Found);
+
+Done:
+    if (Data != NULL) {
+        FreePool( Data );
+    }
+    FreePool( Name );
 
-    return 0;
+    return Status;
 }
 
 
-int
-do_extension_id( void *context, 
-                 long state_index,
-                 unsigned char tag,
-                 const void *value,
-                 long vlen )
-{
-    enum OID oid; 
-    CHAR16 buffer[60];
-    int len = StrLen(tmpbuf);
-
-    if (len > (90*wrapno)) {
-        // Not sure why a CR is now required in UDK2017.  Need to investigate
-        StrCat(tmpbuf, L"\r\n             ");
-        wrapno++;
-    }
-
-    oid = Lookup_OID(value, vlen);
-    Sprint_OID(value, vlen, buffer, sizeof(buffer));
-
-    if (oid == OID_subjectKeyIdentifier)
-        StrCat(tmpbuf, L" SubjectKeyIdentifier");
-    else if (oid == OID_keyUsage)
-        StrCat(tmpbuf, L" KeyUsage");
-    else if (oid == OID_subjectAltName)
-        StrCat(tmpbuf, L" SubjectAltName");
-    else if (oid == OID_issuerAltName)
-        StrCat(tmpbuf, L" IssuerAltName");
-    else if (oid == OID_basicConstraints)
-        StrCat(tmpbuf, L" BasicConstraints");
-    else if (oid == OID_crlDistributionPoints)
-        StrCat(tmpbuf, L" CrlDistributionPoints");
-    else if (oid == OID_certAuthInfoAccess) 
-        StrCat(tmpbuf, L" CertAuthInfoAccess");
-    else if (oid == OID_certPolicies)
-        StrCat(tmpbuf, L" CertPolicies");
-    else if (oid == OID_authorityKeyIdentifier)
-        StrCat(tmpbuf, L" AuthorityKeyIdentifier");
-    else if (oid == OID_extKeyUsage)
-        StrCat(tmpbuf, L" ExtKeyUsage");
-    else if (oid == OID_msEnrollCerttypeExtension)
-        StrCat(tmpbuf, L" msEnrollCertTypeExtension");
-    else if (oid == OID_msCertsrvCAVersion)
-        StrCat(tmpbuf, L" msCertsrvCAVersion");
-    else if (oid == OID_msCertsrvPreviousCertHash)
-        StrCat(tmpbuf, L" msCertsrvPreviousCertHash");
-    else {
-        StrCat(tmpbuf, L" (");
-        StrCat(tmpbuf, buffer);
-        StrCat(tmpbuf, L")");
-    }
-
-    return 0;
+EFI_STATUS
+WriterFlush( FILE_WRITER *Writer )
+{
+    EFI_STATUS Status;
+    UINTN Size = Writer->Used;
+
+    if (Size > 0 && !EFI_ERROR(Writer->Status)) {
+        Status = ShellWriteFile( Writer->Handle, &Size, Writer->Buffer );
+        Writer->Writes++;
+        if (EFI_ERROR(Status)) {
+            Writer->Status = Status;
+        } else if (Size != Writer->Used) {
+            Writer->Status = EFI_VOLUME_FULL;
+        }
+    }
+    Writer->Used = 0;
+
+    return Writer->Status;
+}
+
+
+VOID
+WriterAppend( FILE_WRITER *Writer,
+              CONST VOID *Data,
+              UINTN Len )
+{
+    CONST UINT8 *p = Data;
+    UINTN Count;
+
+    while (Len > 0) {
+        if (Writer->Used == EXPORT_BUFFER_SIZE) {
+            WriterFlush( Writer );
+        }
+        Count = MIN( Len, EXPORT_BUFFER_SIZE - Writer->Used );
+        CopyMem( Writer->Buffer + Writer->Used, p, Count );
+        Writer->Used += Count;
+        p += Count;
+        Len -= Count;
+    }
 }
 
 
 //
-//  Yes, a hack but it works!
+// Open Dir\Name for writing, replacing any existing file
 //
-char *
-make_utc_date_string( char *s )
-{
-    static char buffer[50];
-    char  *d;
-
-    d = buffer;
-    *d++ = '2';      /* year */
-    *d++ = '0';
-    *d++ = *s++;
-    *d++ = *s++;
-    *d++ = '-';
-    *d++ = *s++;     /* month */
-    *d++ = *s++;
-    *d++ = '-';
-    *d++ = *s++;     /* day */
-    *d++ = *s++;
-    *d++ = ' ';
-    *d++ = *s++;     /* hour */
-    *d++ = *s++;
-    *d++ = ':';
-    *d++ = *s++;     /* minute */
-    *d++ = *s++;
-    *d++ = ':';
-    *d++ = *s++;     /* second */
-    *d++ = *s;
-    *d++ = ' ';
-    *d++ = 'U';
-    *d++ = 'T';
-    *d++ = 'C';
-    *d = '\0';
-
-    return buffer;
+EFI_STATUS
+WriterOpen( FILE_WRITER *Writer,
+            CHAR16 *Dir,
+            CHAR16 *Name )
+{
+    CHAR16 Path[512];
+    EFI_STATUS Status;
+
+    UnicodeSPrint( Path, sizeof(Path), L"%s\\%s", Dir, Name );
+
+    Status = ShellOpenFileByName( Path,
+                                  &Writer->Handle,
+                                  EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE,
+                                  0 );
+    if (!EFI_ERROR(Status)) {
+        Status = ShellDeleteFile( &Writer->Handle );
+        if (EFI_ERROR(Status)) {
+            return Status;
+        }
+    }
+
+    Status = ShellOpenFileByName( Path,
+                                  &Writer->Handle,
+                                  EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE,
+                                  0 );
+    Writer->Used = 0;
+    Writer->Status = Status;
+
+    return Status;
 }
 
 
-int
-do_validity_not_before( void *context,
-                        long state_index,
-                        unsigned char tag,
-                        const void *value, 
-                        long vlen )
+EFI_STATUS
+WriterClose( FILE_WRITER *Writer )
 {
-    CHAR16 *ptr;
-    char *p;
+    WriterFlush( Writer );
+    ShellCloseFile( &Writer->Handle );
+
+    return Writer->Status;
+}
 
-    p = make_utc_date_string((char *)value);
-    ptr = AsciiToUnicode(p, UTCDATE_LEN);
-    Print(L"  Validity:  Not Before: %s", ptr);
-    FreePool(ptr);
 
-    return 0;
+//
+// Base64 with 64 character lines, encoded straight into the write buffer
+//
+VOID
+WriterAppendPem( FILE_WRITER *Writer,
+                 UINT8 *Der,
+                 UINTN Len )
+{
+    STATIC CONST CHAR8 Alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    CHAR8  Line[PEM_LINE_BYTES / 3 * 4 + 1];
+    UINTN  Count;
+    UINTN  Out;
+    UINT32 Bits;
+
+    WriterAppend( Writer, "-----BEGIN CERTIFICATE-----\n", 28 );
+
+    while (Len > 0) {
+        Count = MIN( Len, PEM_LINE_BYTES );
+        Out = 0;
+        for (UINTN Index = 0; Index + 3 <= Count; Index += 3) {
+            Bits = ((UINT32)Der[Index] << 16) | ((UINT32)Der[Index + 1] << 8) | Der[Index + 2];
+            Line[Out++] = Alphabet[(Bits >> 18) & 0x3f];
+            Line[Out++] = Alphabet[(Bits >> 12) & 0x3f];
+            Line[Out++] = Alphabet[(Bits >> 6) & 0x3f];
+            Line[Out++] = Alphabet[Bits & 0x3f];
+        }
+        if (Count % 3 != 0) {
+            Bits = (UINT32)Der[Count - Count % 3] << 16;
+            if (Count % 3 == 2) {
+                Bits |= (UINT32)Der[Count - 1] << 8;
+            }
+            Line[Out++] = Alphabet[(Bits >> 18) & 0x3f];
+            Line[Out++] = Alphabet[(Bits >> 12) & 0x3f];
+            Line[Out++] = (Count % 3 == 2) ? Alphabet[(Bits >> 6) & 0x3f] : '=';
+            Line[Out++] = '=';
+        }
+        Line[Out++] = '\n';
+        WriterAppend( Writer, Line, Out );
+        Der += Count;
+        Len -= Count;
+    }
+
+    WriterAppend( Writer, "-----END CERTIFICATE-----\n", 26 );
 }
 
 
-int
-do_validity_not_after( void *context,
-                       long state_index,
-                       unsigned char tag,
-                       const void *value,
-                       long vlen )
+VOID
+WriterAppendHex( FILE_WRITER *Writer,
+                 UINT8 *Data,
+                 UINTN Len )
+{
+    STATIC CONST CHAR8 Digits[] = "0123456789abcdef";
+    CHAR8 Hex[64];
+    UINTN Out = 0;
+
+    for (UINTN Index = 0; Index < Len; Index++) {
+        Hex[Out++] = Digits[Data[Index] >> 4];
+        Hex[Out++] = Digits[Data[Index] & 0x0f];
+        if (Out == sizeof(Hex)) {
+            WriterAppend( Writer, Hex, Out );
+            Out = 0;
+        }
+    }
+    WriterAppend( Writer, Hex, Out );
+}
+
+
+CHAR16 *
+SignatureTypeName( EFI_GUID *Type )
 {
-    CHAR16 *ptr;
-    char *p;
+    EFI_GUID gSHA1 = EFI_CERT_SHA1_GUID;
+    EFI_GUID gSHA256 = EFI_CERT_SHA256_GUID;
+    EFI_GUID gX509SHA256 = EFI_CERT_X509_SHA256_GUID;
+    EFI_GUID gRSA2048 = EFI_CERT_RSA2048_GUID;
 
-    p = make_utc_date_string((char *)value);
-    ptr = AsciiToUnicode(p, UTCDATE_LEN);
-    Print(L"   Not After: %s\n", ptr);
-    FreePool(ptr);
+    if (CompareGuid( Type, &gSHA256 ))
+        return L"SHA256";
+    if (CompareGuid( Type, &gSHA1 ))
+        return L"SHA1";
+    if (CompareGuid( Type, &gX509SHA256 ))
+        return L"X509_SHA256";
+    if (CompareGuid( Type, &gRSA2048 ))
+        return L"RSA2048";
 
-    return 0;
+    return L"Unknown";
 }
 
 
-int
-do_subject_public_key_info( void *context, 
-                            long state_index,
-                            unsigned char tag,
-                            const void *value, 
-                            long vlen )
+// SHA1, SHA256 and X509_SHA256 lists hold digests; RSA2048 and unknown
+// types do not
+BOOLEAN
+IsHashSignatureType( EFI_GUID *Type )
 {
-    Print(L"  Subject Public Key Algorithm: %s\n", tmpbuf);
-    tmpbuf[0] = '\0';
+    EFI_GUID gSHA1 = EFI_CERT_SHA1_GUID;
+    EFI_GUID gSHA256 = EFI_CERT_SHA256_GUID;
+    EFI_GUID gX509SHA256 = EFI_CERT_X509_SHA256_GUID;
 
-    return 0;
+    return CompareGuid( Type, &gSHA256 ) || CompareGuid( Type, &gSHA1 ) ||
+           CompareGuid( Type, &gX509SHA256 );
 }
 
 
-int
-PrintCertificates( UINT8 *data, 
-                   UINTN len, 
-                   CHAR16 *name )
+//
+// Each X509 entry becomes Var_List_Entry_Owner.der (and .pem), each other
+// list one Var_List_Type.csv of owner and hex data.
+//
+EFI_STATUS
+ExportVariable( CHAR16 *Var,
+                EFI_GUID Owner,
+                CHAR16 *Dir,
+                BOOLEAN Pem,
+                FILE_WRITER *Writer,
+                UINTN *Certs,
+                UINTN *HashLists,
+                UINTN *OtherLists )
 {
-    EFI_SIGNATURE_LIST *CertList = (EFI_SIGNATURE_LIST *)data;
+    EFI_SIGNATURE_LIST *CertList;
     EFI_SIGNATURE_DATA *Cert;
-    EFI_GUID gX509 = EFI_CERT_X509_GUID;
-    EFI_GUID gPKCS7 = EFI_CERT_TYPE_PKCS7_GUID;
-    EFI_GUID gRSA2048 = EFI_CERT_RSA2048_GUID;
-    BOOLEAN  CertFound = FALSE;
-    CHAR16   *ext;
-    UINTN    DataSize = len;
-    UINTN    CertCount = 0;
-    UINTN    buflen;
-    int      status = 0;
+    EFI_GUID   gX509 = EFI_CERT_X509_GUID;
+    EFI_STATUS Status;
+    CHAR16     Name[128];
+    CHAR8      Row[64];
+    UINT8      *Data;
+    UINTN      Len;
+    UINTN      DataSize;
+    UINTN      CertCount;
+    UINTN      DerSize;
+    UINTN      ListIndex = 0;
+
+    Status = get_variable( Var, &Data, &Len, Owner );
+    if (Status == EFI_NOT_FOUND) {
+        return EFI_SUCCESS;
+    }
+    if (EFI_ERROR(Status)) {
+        Print(L"ERROR: Failed to get variable %s. Status Code: %d\n", Var, Status);
+        return Status;
+    }
 
-    while ((DataSize > 0) && (DataSize >= CertList->SignatureListSize)) {
-        CertCount = (CertList->SignatureListSize - CertList->SignatureHeaderSize) / CertList->SignatureSize;
+    CertList = (EFI_SIGNATURE_LIST *)Data;
+    DataSize = Len;
+    while (DataSize >= sizeof(EFI_SIGNATURE_LIST) &&
+           DataSize >= CertList->SignatureListSize &&
+           CertList->SignatureSize > sizeof(EFI_GUID) &&
+           CertList->SignatureListSize >= sizeof(EFI_SIGNATURE_LIST) + CertList->SignatureHeaderSize) {
+        CertCount = (CertList->SignatureListSize - sizeof(EFI_SIGNATURE_LIST) - CertList->SignatureHeaderSize) / CertList->SignatureSize;
         Cert = (EFI_SIGNATURE_DATA *) ((UINT8 *) CertList + sizeof (EFI_SIGNATURE_LIST) + CertList->SignatureHeaderSize);
+        DerSize = CertList->SignatureSize - sizeof(EFI_GUID);
+
+        if (CompareGuid( &CertList->SignatureType, &gX509 )) {
+            for (UINTN Index = 0; Index < CertCount; Index++) {
+                DerSize = CertDerLength( Cert->SignatureData, CertList->SignatureSize - sizeof(EFI_GUID) );
+                UnicodeSPrint( Name, sizeof(Name), L"%s_%d_%d_%g.der", Var, ListIndex, Index, &Cert->SignatureOwner );
+                Status = WriterOpen( Writer, Dir, Name );
+                if (!EFI_ERROR(Status)) {
+                    WriterAppend( Writer, Cert->SignatureData, DerSize );
+                    Status = WriterClose( Writer );
+                }
+                if (!EFI_ERROR(Status) && Pem) {
+                    UnicodeSPrint( Name, sizeof(Name), L"%s_%d_%d_%g.pem", Var, ListIndex, Index, &Cert->SignatureOwner );
+                    Status = WriterOpen( Writer, Dir, Name );
+                    if (!EFI_ERROR(Status)) {
+                        WriterAppendPem( Writer, Cert->SignatureData, DerSize );
+                        Status = WriterClose( Writer );
+                    }
+                }
+                if (EFI_ERROR(Status)) {
+                    Print(L"ERROR: Could not write %s [%r]\n", Name, Status);
+                    goto Done;
+                }
+                (*Certs)++;
+                Cert = (EFI_SIGNATURE_DATA *) ((UINT8 *) Cert + CertList->SignatureSize);
+            }
+        } else {
+            UnicodeSPrint( Name, sizeof(Name), L"%s_%d_%s.csv", Var, ListIndex, SignatureTypeName( &CertList->SignatureType ) );
+            Status = WriterOpen( Writer, Dir, Name );
+            if (!EFI_ERROR(Status)) {
+                WriterAppend( Writer, "Owner,Data\n", 11 );
+                for (UINTN Index = 0; Index < CertCount; Index++) {
+                    AsciiSPrint( Row, sizeof(Row), "%g,", &Cert->SignatureOwner );
+                    WriterAppend( Writer, Row, AsciiStrLen( Row ) );
+                    WriterAppendHex( Writer, Cert->SignatureData, DerSize );
+                    WriterAppend( Writer, "\n", 1 );
+                    Cert = (EFI_SIGNATURE_DATA *) ((UINT8 *) Cert + CertList->SignatureSize);
+                }
+                Status = WriterClose( Writer );
+            }
+            if (EFI_ERROR(Status)) {
+                Print(L"ERROR: Could not write %s [%r]\n", Name, Status);
+                goto Done;
+            }
+            if (IsHashSignatureType( &CertList->SignatureType )) {
+                (*HashLists)++;
+            } else {
+                (*OtherLists)++;
+            }
+        }
 
-        // should all be X509 but just in case...
-        if (CompareGuid(&CertList->SignatureType, &gX509) == 0)
-            ext = L"X509";
-        else if (CompareGuid(&CertList->SignatureType, &gPKCS7) == 0)
-            ext = L"PKCS7";
-        else if (CompareGuid(&CertList->SignatureType, &gRSA2048) == 0)
-            ext = L"RSA2048";
-        else 
-            ext = L"Unknown";
+        ListIndex++;
+        DataSize -= CertList->SignatureListSize;
+        CertList = (EFI_SIGNATURE_LIST *) ((UINT8 *) CertList + CertList->SignatureListSize);
+    }
 
-        for (UINTN Index = 0; Index < CertCount; Index++) {
-            if ( CertList->SignatureSize > 100 ) {
-                CertFound = TRUE;
-                Print(L"\nType: %s  (GUID: %g)\n", ext, &Cert->SignatureOwner);
-                buflen  = CertList->SignatureSize-sizeof(EFI_GUID);
-                status = asn1_ber_decoder(&x509_decoder, NULL, Cert->SignatureData, buflen);
+Done:
+    FreePool( Data );
+
+    return Status;
+}
+
+
+EFI_STATUS
+ExportVariables( CHAR16 *Dir,
+                 BOOLEAN Pem,
+                 CHAR16 **Variables,
+                 EFI_GUID *Owners,
+                 UINTN Count )
+{
+    SHELL_FILE_HANDLE DirHandle;
+    FILE_WRITER Writer;
+    EFI_STATUS  Status = EFI_SUCCESS;
+    UINTN       Certs = 0;
+    UINTN       HashLists = 0;
+    UINTN       OtherLists = 0;
+
+    if (ShellIsDirectory( Dir ) != EFI_SUCCESS) {
+        Status = ShellCreateDirectory( Dir, &DirHandle );
+        if (EFI_ERROR(Status)) {
+            Print(L"ERROR: Could not create directory %s [%r]\n", Dir, Status);
+            return Status;
+        }
+        ShellCloseFile( &DirHandle );
+    }
+
+    ZeroMem( &Writer, sizeof(Writer) );
+    Writer.Buffer = AllocatePool( EXPORT_BUFFER_SIZE );
+    if (Writer.Buffer == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    for (UINTN Index = 0; Index < Count; Index++) {
+        Status = ExportVariable( Variables[Index], Owners[Index], Dir, Pem, &Writer, &Certs, &HashLists, &OtherLists );
+        if (EFI_ERROR(Status)) {
+            break;
+        }
+    }
+
+    if (!EFI_ERROR(Status)) {
+        Print(L"Exported %d certificates, %d hash lists and %d other lists to %s\n",
+              Certs, HashLists, OtherLists, Dir);
+        if (ShowStats) {
+            Print(L"  File writes: %d\n", Writer.Writes);
+        }
+    }
+
+    FreePool( Writer.Buffer );
+
+    return Status;
+}
+
+
+VOID *
+ArenaAlloc( CERT_STORE *Store,
+            UINTN Size )
+{
+    ARENA_CHUNK *Chunk = Store->Chunks;
+    UINTN ChunkSize;
+    VOID  *Ptr;
+
+    Size = ALIGN_VALUE( Size, sizeof(UINT64) );
+    if (Chunk == NULL || Chunk->Size - Chunk->Used < Size) {
+        ChunkSize = MAX( CERT_ARENA_CHUNK, Size + sizeof(ARENA_CHUNK) );
+        Chunk = AllocatePool( ChunkSize );
+        if (Chunk == NULL) {
+            return NULL;
+        }
+        Chunk->Next = Store->Chunks;
+        Chunk->Used = ALIGN_VALUE( sizeof(ARENA_CHUNK), sizeof(UINT64) );
+        Chunk->Size = ChunkSize;
+        Store->Chunks = Chunk;
+    }
+
+    Ptr = (UINT8 *)Chunk + Chunk->Used;
+    Chunk->Used += Size;
+
+    return Ptr;
+}
+
+
+VOID
+FreeCertStore( CERT_STORE *Store )
+{
+    ARENA_CHUNK *Chunk;
+
+    while (Store->Chunks != NULL) {
+        Chunk = Store->Chunks;
+        Store->Chunks = Chunk->Next;
+        FreePool( Chunk );
+    }
+    ZeroMem( Store, sizeof(CERT_STORE) );
+}
+
+
+//
+// Copy the X509 entries of a variable into the store and parse them.
+// Returns EFI_NOT_FOUND if the variable does not exist.
+//
+EFI_STATUS
+LoadCertStore( CERT_STORE *Store,
+               CHAR16 *Var,
+               EFI_GUID Owner )
+{
+    EFI_SIGNATURE_LIST *CertList;
+    EFI_SIGNATURE_DATA *Cert;
+    EFI_GUID   gX509 = EFI_CERT_X509_GUID;
+    EFI_STATUS Status;
+    STORE_CERT *Entry;
+    UINT8      *Data;
+    UINT8      *Der;
+    UINTN      Len;
+    UINTN      DataSize;
+    UINTN      CertCount;
+    UINTN      DerSize;
+    UINTN      Index = 0;
+
+    Status = get_variable( Var, &Data, &Len, Owner );
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+
+    CertList = (EFI_SIGNATURE_LIST *)Data;
+    DataSize = Len;
+    while (DataSize >= sizeof(EFI_SIGNATURE_LIST) &&
+           DataSize >= CertList->SignatureListSize &&
+           CertList->SignatureSize > sizeof(EFI_GUID) &&
+           CertList->SignatureListSize >= sizeof(EFI_SIGNATURE_LIST) + CertList->SignatureHeaderSize) {
+        CertCount = (CertList->SignatureListSize - sizeof(EFI_SIGNATURE_LIST) - CertList->SignatureHeaderSize) / CertList->SignatureSize;
+        Cert = (EFI_SIGNATURE_DATA *) ((UINT8 *) CertList + sizeof (EFI_SIGNATURE_LIST) + CertList->SignatureHeaderSize);
+
+        for (UINTN i = 0; i < CertCount && CompareGuid( &CertList->SignatureType, &gX509 ); i++) {
+            DerSize = CertDerLength( Cert->SignatureData, CertList->SignatureSize - sizeof(EFI_GUID) );
+            Entry = ArenaAlloc( Store, sizeof(STORE_CERT) );
+            Der = ArenaAlloc( Store, DerSize );
+            if (Entry == NULL || Der == NULL) {
+                Status = EFI_OUT_OF_RESOURCES;
+                goto Done;
             }
+            ZeroMem( Entry, sizeof(STORE_CERT) );
+            CopyMem( Der, Cert->SignatureData, DerSize );
+            Entry->Parsed = !EFI_ERROR(X509ParseCertificate( Der, DerSize, &Entry->Cert ));
+            Entry->Var = Var;
+            Entry->Index = Index++;
+
+            if (Store->Last != NULL) {
+                Store->Last->Next = Entry;
+            } else {
+                Store->First = Entry;
+            }
+            Store->Last = Entry;
+            Store->Count++;
             Cert = (EFI_SIGNATURE_DATA *) ((UINT8 *) Cert + CertList->SignatureSize);
         }
+
         DataSize -= CertList->SignatureListSize;
         CertList = (EFI_SIGNATURE_LIST *) ((UINT8 *) CertList + CertList->SignatureListSize);
     }
 
-    if ( CertFound == FALSE ) {
-       Print(L"\nNo certificates found for this database\n");
-    }
+Done:
+    FreePool( Data );
 
-    return status;
+    return Status;
+}
+
+
+// FNV-1a
+UINT32
+HashName( CONST UINT8 *Name,
+          UINTN Len )
+{
+    UINT32 Hash = 0x811c9dc5;
+
+    while (Len-- > 0) {
+        Hash = (Hash ^ *Name++) * 0x01000193;
+    }
+    return Hash;
 }
 
 
 EFI_STATUS
-get_variable( CHAR16 *Var, 
-              UINT8 **Data, 
-              UINTN *Len,
-              EFI_GUID Owner )
+IndexCertStore( CERT_STORE *Store )
+{
+    STORE_CERT *Entry;
+    UINTN      Bucket;
+
+    Store->BucketCount = 16;
+    while (Store->BucketCount < Store->Count * 2) {
+        Store->BucketCount *= 2;
+    }
+    Store->Buckets = ArenaAlloc( Store, Store->BucketCount * sizeof(STORE_CERT *) );
+    if (Store->Buckets == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+    }
+    ZeroMem( Store->Buckets, Store->BucketCount * sizeof(STORE_CERT *) );
+
+    for (Entry = Store->First; Entry != NULL; Entry = Entry->Next) {
+        if (Entry->Parsed) {
+            Bucket = HashName( Entry->Cert.Subject, Entry->Cert.SubjectLen ) & (Store->BucketCount - 1);
+            Entry->NextInBucket = Store->Buckets[Bucket];
+            Store->Buckets[Bucket] = Entry;
+        }
+    }
+
+    return EFI_SUCCESS;
+}
+
+
+//
+// Find the certificate that signed Entry: the first with a subject equal
+// to Entry's issuer whose key verifies the signature. The result is kept
+// so that each link is only checked once however many chains share it.
+//
+VOID
+FindIssuer( CERT_STORE *Store,
+            STORE_CERT *Entry )
 {
+    STORE_CERT *Candidate;
     EFI_STATUS Status;
+    UINTN      Bucket;
 
-    *Len = 0;
+    if (Entry->Checked) {
+        return;
+    }
+    Entry->Checked = TRUE;
+    Entry->Issuer = NULL;
+    Entry->IssuerStatus = EFI_NOT_FOUND;
+
+    Bucket = HashName( Entry->Cert.Issuer, Entry->Cert.IssuerLen ) & (Store->BucketCount - 1);
+    for (Candidate = Store->Buckets[Bucket]; Candidate != NULL; Candidate = Candidate->NextInBucket) {
+        if (Candidate->Cert.SubjectLen != Entry->Cert.IssuerLen ||
+            CompareMem( Candidate->Cert.Subject, Entry->Cert.Issuer, Entry->Cert.IssuerLen ) != 0) {
+            continue;
+        }
+        Status = X509CheckSignature( &Entry->Cert, &Candidate->Cert );
+        if (Status == EFI_SUCCESS) {
+            Entry->Issuer = Candidate;
+            Entry->IssuerStatus = EFI_SUCCESS;
+            return;
+        }
+        // a bad signature from any candidate outranks an unsupported key
+        if (Status == EFI_SECURITY_VIOLATION || Entry->IssuerStatus == EFI_NOT_FOUND) {
+            Entry->IssuerStatus = Status;
+        }
+    }
+}
 
-    Status = gRT->GetVariable( Var, &Owner, NULL, Len, NULL );
-    if (Status != EFI_BUFFER_TOO_SMALL)
+
+VOID
+PrintCertTime( CHAR16 *Label,
+               CONST CHAR8 *Time )
+{
+    Print(L"%s%c%c%c%c-%c%c-%c%c %c%c:%c%c:%c%c UTC\n", Label,
+          Time[0], Time[1], Time[2], Time[3], Time[4], Time[5], Time[6], Time[7],
+          Time[8], Time[9], Time[10], Time[11], Time[12], Time[13]);
+}
+
+
+//
+// Show the chain of each certificate in PK, KEK, db and MokList up to a
+// self-signed root or the first issuer that is not in those stores.
+// Returns EFI_SECURITY_VIOLATION if any chain is broken or expired.
+//
+EFI_STATUS
+VerifyCertificates( TEXT_BUILDER *Text )
+{
+    EFI_GUID   gGlobal = EFI_GLOBAL_VARIABLE;
+    EFI_GUID   gSIGDB = EFI_IMAGE_SECURITY_DATABASE_GUID;
+    EFI_GUID   gShim = SHIM_LOCK_GUID;
+    CHAR16     *Names[] = { L"PK", L"KEK", L"db", L"MokList", L"MokListRT" };
+    EFI_GUID   *Owners[] = { &gGlobal, &gGlobal, &gSIGDB, &gShim, &gShim };
+    CERT_STORE Store;
+    STORE_CERT *Entry;
+    STORE_CERT *Cur;
+    EFI_TIME   Time;
+    EFI_STATUS Status = EFI_SUCCESS;
+    CHAR8      Now[X509_TIME_SIZE];
+    BOOLEAN    HaveTime;
+    BOOLEAN    Expired;
+    BOOLEAN    MokFound = FALSE;
+    UINTN      Depth;
+    UINTN      Ok = 0, Incomplete = 0, Broken = 0, Unsupported = 0, ExpiredCount = 0;
+
+    ZeroMem( &Store, sizeof(Store) );
+
+    for (UINTN i = 0; i < ARRAY_SIZE(Names); i++) {
+        // MokListRT is the runtime copy of MokList
+        if (i == ARRAY_SIZE(Names) - 1 && MokFound) {
+            break;
+        }
+        Status = LoadCertStore( &Store, Names[i], *Owners[i] );
+        if (Status == EFI_NOT_FOUND) {
+            continue;
+        }
+        if (EFI_ERROR(Status)) {
+            Print(L"ERROR: Failed to get variable %s. Status Code: %d\n", Names[i], Status);
+            goto Done;
+        }
+        MokFound |= (i == 3);
+    }
+    Status = IndexCertStore( &Store );
+    if (EFI_ERROR(Status)) {
+        goto Done;
+    }
+
+    HaveTime = !EFI_ERROR(gRT->GetTime( &Time, NULL ));
+    if (HaveTime) {
+        AsciiSPrint( Now, sizeof(Now), "%04d%02d%02d%02d%02d%02d",
+                     Time.Year, Time.Month, Time.Day, Time.Hour, Time.Minute, Time.Second );
+    } else {
+        Print(L"WARNING: Could not read the time; validity periods are not checked\n");
+    }
+
+    for (Entry = Store.First; Entry != NULL; Entry = Entry->Next) {
+        Print(L"\n%s[%d]\n", Entry->Var, Entry->Index);
+        if (!Entry->Parsed) {
+            Print(L"  Status: BROKEN, certificate could not be parsed\n");
+            Broken++;
+            continue;
+        }
+
+        TextReset( Text );
+        X509AppendName( Text, Entry->Cert.Subject, Entry->Cert.SubjectLen );
+        TextFlush( Text, L"  Subject:" );
+
+        Print(L"  Chain:   %s[%d]", Entry->Var, Entry->Index);
+        Expired = FALSE;
+        Depth = 0;
+        for (Cur = Entry; ; Cur = Cur->Issuer) {
+            if (HaveTime && (AsciiStrCmp( Cur->Cert.NotAfter, Now ) < 0 ||
+                             AsciiStrCmp( Cur->Cert.NotBefore, Now ) > 0)) {
+                Expired = TRUE;
+            }
+            FindIssuer( &Store, Cur );
+            if (Cur->IssuerStatus != EFI_SUCCESS || Cur->Issuer == Cur || ++Depth > CHAIN_MAX_DEPTH) {
+                break;
+            }
+            Print(L" <- %s[%d]", Cur->Issuer->Var, Cur->Issuer->Index);
+        }
+
+        if (Depth > CHAIN_MAX_DEPTH) {
+            Print(L" ...\n  Status:  BROKEN, chain longer than %d certificates\n", CHAIN_MAX_DEPTH);
+            Broken++;
+        } else if (Cur->IssuerStatus == EFI_SUCCESS) {
+            Print(L" (self-signed)\n  Status:  OK\n");
+            Ok++;
+        } else if (Cur->IssuerStatus == EFI_NOT_FOUND) {
+            Print(L"\n  Status:  INCOMPLETE, issuer not in PK, KEK, db or MokList\n");
+            TextReset( Text );
+            X509AppendName( Text, Cur->Cert.Issuer, Cur->Cert.IssuerLen );
+            TextFlush( Text, L"  Issuer: " );
+            Incomplete++;
+        } else if (Cur->IssuerStatus == EFI_UNSUPPORTED) {
+            Print(L"\n  Status:  NOT CHECKED, unsupported signature algorithm or key for %s[%d]\n",
+                  Cur->Var, Cur->Index);
+            Unsupported++;
+        } else {
+            Print(L"\n  Status:  BROKEN, signature on %s[%d] does not verify\n", Cur->Var, Cur->Index);
+            Broken++;
+        }
+
+        // every certificate up to where the walk stopped
+        if (Expired) {
+            for (Cur = Entry, Depth = 0; Cur != NULL && Depth <= CHAIN_MAX_DEPTH; Depth++) {
+                if (AsciiStrCmp( Cur->Cert.NotAfter, Now ) < 0) {
+                    Print(L"  EXPIRED: %s[%d] ", Cur->Var, Cur->Index);
+                    PrintCertTime( L"not after ", Cur->Cert.NotAfter );
+                } else if (AsciiStrCmp( Cur->Cert.NotBefore, Now ) > 0) {
+                    Print(L"  NOT YET VALID: %s[%d] ", Cur->Var, Cur->Index);
+                    PrintCertTime( L"not before ", Cur->Cert.NotBefore );
+                }
+                if (Cur->IssuerStatus != EFI_SUCCESS || Cur->Issuer == Cur) {
+                    break;
+                }
+                Cur = Cur->Issuer;
+            }
+            ExpiredCount++;
+        }
+    }
+
+    Print(L"\nCertificates: %d  OK: %d  Issuer not present: %d  Broken: %d  Not checked: %d  Expired: %d\n",
+          Store.Count, Ok, Incomplete, Broken, Unsupported, ExpiredCount);
+
+    Status = (Broken > 0 || ExpiredCount > 0) ? EFI_SECURITY_VIOLATION : EFI_SUCCESS;
+
+Done:
+    FreeCertStore( &Store );
+
+    return Status;
+}
+
+
+EFI_STATUS
+ReadImageFile( CHAR16 *FileName,
+               UINT8 **Buffer,
+               UINTN *BufferSize )
+{
+    SHELL_FILE_HANDLE FileHandle = (SHELL_FILE_HANDLE)NULL;
+    EFI_FILE_INFO *FileInfo = NULL;
+    EFI_STATUS Status = EFI_SUCCESS;
+    UINTN Size;
+
+    *Buffer = NULL;
+    *BufferSize = 0;
+
+    Status = ShellOpenFileByName( FileName,
+                                  &FileHandle,
+                                  EFI_FILE_MODE_READ,
+                                  0 );
+    if (EFI_ERROR(Status)) {
         return Status;
+    }
 
-    *Data = AllocateZeroPool( *Len );
-    if (!Data)
+    FileInfo = ShellGetFileInfo( FileHandle );
+    if (FileInfo == NULL) {
+        ShellCloseFile( &FileHandle );
+        return EFI_NOT_FOUND;
+    }
+    Size = (UINTN) FileInfo->FileSize;
+    FreePool( FileInfo );
+
+    *Buffer = AllocatePool( Size );
+    if (*Buffer == NULL) {
+        ShellCloseFile( &FileHandle );
         return EFI_OUT_OF_RESOURCES;
-    
-    Status = gRT->GetVariable( Var, &Owner, NULL, Len, *Data );
-    if (Status != EFI_SUCCESS) {
-        FreePool( *Data );
-        *Data = NULL;
     }
 
-    return Status;
+    *BufferSize = Size;
+    Status = ShellReadFile( FileHandle, BufferSize, *Buffer );
+    ShellCloseFile( &FileHandle );
+    if (EFI_ERROR(Status) || *BufferSize != Size) {
+        FreePool( *Buffer );
+        *Buffer = NULL;
+        *BufferSize = 0;
+        return EFI_VOLUME_CORRUPTED;
+    }
+
+    return EFI_SUCCESS;
 }
 
 
+//
+// Hash a PE/COFF image and look it up in dbx. Returns
+// EFI_SECURITY_VIOLATION for a revoked image so that scripts can test
+// %lasterror%.
+//
 EFI_STATUS
-OutputVariable( CHAR16 *Var, 
-                EFI_GUID Owner ) 
+CheckImage( CHAR16 *FileName,
+            EFI_GUID Owner )
 {
     EFI_STATUS Status = EFI_SUCCESS;
-    UINT8 *Data;
+    HASH_STORE Store;
+    UINT8 Digest[SHA256_DIGEST_SIZE];
+    UINT8 *Image = NULL;
+    UINT8 *Data = NULL;
+    UINTN ImageSize;
     UINTN Len;
 
-    Status = get_variable( Var, &Data, &Len, Owner );
-    if (Status == EFI_SUCCESS) {
-        Print(L"\nVARIABLE: %s  (size: %d)\n", Var, Len);
-        PrintCertificates( Data, Len, Var );
-        FreePool( Data );
-    } else if (Status == EFI_NOT_FOUND) {
-#ifdef DEBUG
-        Print(L"Variable %s not found\n", Var);
-#else
+    ZeroMem( &Store, sizeof(HASH_STORE) );
+
+    Status = ReadImageFile( FileName, &Image, &ImageSize );
+    if (EFI_ERROR(Status)) {
+        Print(L"ERROR: Could not read %s [%r]\n", FileName, Status);
         return Status;
-#endif
-    } else 
-        Print(L"ERROR: Failed to get variable %s. Status Code: %d\n", Var, Status);
+    }
+
+    Status = HashPeImage( Image, ImageSize, Digest );
+    if (EFI_ERROR(Status)) {
+        Print(L"ERROR: %s is not a valid PE/COFF image [%r]\n", FileName, Status);
+        goto Done;
+    }
+
+    Print(L"\nImage: %s  (size: %d)\n", FileName, ImageSize);
+    PrintDigest( L"  SHA256: ", Digest, SHA256_DIGEST_SIZE );
+
+    Status = get_variable( L"dbx", &Data, &Len, Owner );
+    if (Status == EFI_NOT_FOUND) {
+        Print(L"\nNo dbx variable found\n");
+        Print(L"\nResult: NOT REVOKED\n");
+        Status = EFI_SUCCESS;
+        goto Done;
+    } else if (EFI_ERROR(Status)) {
+        Print(L"ERROR: Failed to get variable dbx. Status Code: %d\n", Status);
+        goto Done;
+    }
+
+    Status = LoadHashStore( Data, Len, &Store );
+    if (EFI_ERROR(Status)) {
+        Print(L"ERROR: Could not load dbx hashes [%r]\n", Status);
+        goto Done;
+    }
+    PrintHashTotals( &Store );
+
+    if (FindHash( &Store, Digest )) {
+        Print(L"\nResult: REVOKED (image hash is in dbx)\n");
+        Status = EFI_SECURITY_VIOLATION;
+    } else {
+        Print(L"\nResult: NOT REVOKED\n");
+    }
+
+Done:
+    FreeHashStore( &Store );
+    if (Data != NULL) {
+        FreePool( Data );
+    }
+    if (Image != NULL) {
+        FreePool( Image );
+    }
 
     return Status;
 }
@@ -505,7 +1536,11 @@ Usage( BOOLEAN ErrorMsg )
         Print(L"ERROR: Unknown option(s).\n");
     }
 
-    Print(L"Usage: ListCerts [ -pk | -kek | -db | -dbx ]\n");
+    Print(L"Usage: ListCerts [ -pk | -kek | -db | -dbx ] [--stats]\n");
+    Print(L"       ListCerts --all [--stats]\n");
+    Print(L"       ListCerts -check <file>\n");
+    Print(L"       ListCerts --export <dir> [--pem] [--stats]\n");
+    Print(L"       ListCerts --verify\n");
     Print(L"       ListCerts [-V | --version]\n");
 }
 
@@ -519,10 +1554,21 @@ ShellAppMain( UINTN Argc,
     EFI_GUID   gSIGDB = EFI_IMAGE_SECURITY_DATABASE_GUID;
     EFI_GUID   owners[] = { EFI_GLOBAL_VARIABLE, EFI_GLOBAL_VARIABLE, gSIGDB, gSIGDB };
     CHAR16     *variables[] = { L"PK", L"KEK", L"db", L"dbx" };
+    TEXT_BUILDER Text;
+
+    // one builder for the whole run; after the first certificate has grown
+    // it, decoding makes no further pool allocations
+    TextInit( &Text );
+
+    // --stats may follow any of the listing or export options
+    if (Argc > 1 && !StrCmp(Argv[Argc - 1], L"--stats")) {
+        ShowStats = TRUE;
+        Argc--;
+    }
 
     if (Argc == 1) {
         for (UINT8 i = 0; i < ARRAY_SIZE(owners); i++) {
-            Status = OutputVariable(variables[i], owners[i]);
+            Status = OutputVariable(variables[i], owners[i], &Text);
         }
     } else if (Argc == 2) {
         if (!StrCmp(Argv[1], L"--help") ||
@@ -534,19 +1580,33 @@ ShellAppMain( UINTN Argc,
             Print(L"Version: %s\n", UTILITY_VERSION);
             return Status;
         } else if (!StrCmp(Argv[1], L"-pk"))  {
-            Status = OutputVariable(variables[0], owners[0]);
+            Status = OutputVariable(variables[0], owners[0], &Text);
         } else if (!StrCmp(Argv[1], L"-kek"))  {
-            Status = OutputVariable(variables[1], owners[1]);
+            Status = OutputVariable(variables[1], owners[1], &Text);
         } else if (!StrCmp(Argv[1], L"-db"))  {
-            Status = OutputVariable(variables[2], owners[2]);
+            Status = OutputVariable(variables[2], owners[2], &Text);
         } else if (!StrCmp(Argv[1], L"-dbx"))  {
-            Status = OutputVariable(variables[3], owners[3]);
+            Status = OutputVariable(variables[3], owners[3], &Text);
+        } else if (!StrCmp(Argv[1], L"--all"))  {
+            Status = OutputAllVariables(&Text);
+        } else if (!StrCmp(Argv[1], L"--verify"))  {
+            Status = VerifyCertificates(&Text);
         } else {
             Usage(TRUE);
         }
+    } else if (Argc == 3 && !StrCmp(Argv[1], L"-check")) {
+        Status = CheckImage(Argv[2], owners[3]);
+    } else if ((Argc == 3 || Argc == 4) && !StrCmp(Argv[1], L"--export")) {
+        if (Argc == 4 && StrCmp(Argv[3], L"--pem")) {
+            Usage(TRUE);
+        } else {
+            Status = ExportVariables(Argv[2], Argc == 4, variables, owners, ARRAY_SIZE(owners));
+        }
     } else if (Argc > 2) {
         Usage(TRUE);
     }
 
+    TextFree( &Text );
+
     return Status;
 }
@@ -23,6 +23,7 @@
 #include <Library/UefiLib.h>
 #include <Library/BaseLib.h>
 #include <Library/UefiBootServicesTableLib.h>
+#include <Library/MemoryAllocationLib.h>
 #include <Library/PrintLib.h>
 
 #include "asn1_ber_decoder.h"
@@ -105,7 +106,7 @@ next_tag:
 
 	/* Extract the length */
 	len = data[dp++];
-	if (len < 0x7f) {
+	if (len <= 0x7f) {
 		dp += len;
 		goto next_tag;
 	}
@@ -154,44 +155,37 @@ error:
 	return -1;
 }
 
-/**
- * asn1_ber_decoder - Decoder BER/DER/CER ASN.1 according to pattern
- * @decoder: The decoder definition (produced by asn1_compiler)
- * @context: The caller's context (to be passed to the action functions)
- * @data: The encoded data
- * @datasize: The size of the encoded data
- *
- * Decode BER/DER/CER encoded ASN.1 data according to a bytecode pattern
- * produced by asn1_compiler.  Action functions are called on marked tags to
- * allow the caller to retrieve significant data.
- *
- * LIMITATIONS:
- *
- * To keep down the amount of stack used by this function, the following limits
- * have been imposed:
- *
- *  (1) This won't handle datalen > 65535 without increasing the size of the
- *	cons stack elements and length_too_long checking.
- *
- *  (2) The stack of constructed types is 10 deep.  If the depth of non-leaf
- *	constructed types exceeds this, the decode will fail.
- *
- *  (3) The SET type (not the SET OF type) isn't really supported as tracking
- *	what members of the set have been seen is a pain.
+/*
+ * Stack of constructed types currently open.  The slots are sized by the
+ * caller once per decode; offsets are 32 bits wide.
  */
-int asn1_ber_decoder(const struct asn1_decoder *decoder,
-		     void *context,
-		     const unsigned char *data,
-		     size_t datalen)
+struct asn1_cons_stack {
+	unsigned int *dp;
+	unsigned int *datalen;
+	unsigned char *hdrlen;
+	unsigned int depth;
+};
+
+#define NR_CONS_STACK 10
+#define NR_JUMP_STACK 10
+#define MAX_TAG_OCTETS 4	/* tag numbers up to 28 bits */
+#define MAX_LEN_OCTETS 4	/* lengths up to 32 bits */
+
+static int asn1_ber_decode(const struct asn1_decoder *decoder,
+			   void *context,
+			   const unsigned char *data,
+			   size_t datalen,
+			   struct asn1_cons_stack *cons)
 {
 	const unsigned char *machine = decoder->machine;
 	const asn1_action_t *actions = decoder->actions;
 	size_t machlen = decoder->machlen;
 	enum asn1_opcode op;
-	unsigned char tag = 0, csp = 0, jsp = 0, optag = 0, hdr = 0;
+	unsigned char tag = 0, jsp = 0, optag = 0, hdr = 0;
+	unsigned int csp = 0;
 	const char *errmsg;
 	const CHAR16 *Errmsg = NULL;
-	size_t pc = 0, dp = 0, tdp = 0, len = 0;
+	size_t pc = 0, dp = 0, tdp = 0, len = 0, tagp;
 	int ret;
 
 	unsigned char flags = 0;
@@ -202,16 +196,8 @@ int asn1_ber_decoder(const struct asn1_decoder *decoder,
 				      *   a compound type.
 				      */
 
-#define NR_CONS_STACK 10
-	unsigned short cons_dp_stack[NR_CONS_STACK];
-	unsigned short cons_datalen_stack[NR_CONS_STACK];
-	unsigned char cons_hdrlen_stack[NR_CONS_STACK];
-#define NR_JUMP_STACK 10
 	unsigned char jump_stack[NR_JUMP_STACK];
 
-	if (datalen > 65535)
-		return -EMSGSIZE;
-
 next_op:
 	if (unlikely(pc >= machlen))
 		goto machine_overrun_error;
@@ -236,12 +222,25 @@ next_op:
 		flags = 0;
 		hdr = 2;
 
-		/* Extract a tag from the data */
+		/* Extract a tag from the data.  The identifier octets of a
+		 * long-form tag are consumed here; the first octet alone is
+		 * matched, so such elements are only taken by ANY ops.
+		 */
 		if (unlikely(dp >= datalen - 1))
 			goto data_overrun_error;
+		tagp = dp;
 		tag = data[dp++];
-		if (unlikely((tag & 0x1f) == 0x1f))
-			goto long_tag_not_supported;
+		if (unlikely((tag & 0x1f) == 0x1f)) {
+			int n = 0;
+			do {
+				if (unlikely(dp >= datalen - 1))
+					goto data_overrun_error;
+				if (unlikely(++n > MAX_TAG_OCTETS))
+					goto long_tag_not_supported;
+				tmp = data[dp++];
+				hdr++;
+			} while (tmp & 0x80);
+		}
 
 		if (op & ASN1_OP_MATCH__ANY) {
 			;
@@ -261,7 +260,7 @@ next_op:
 				/* All odd-numbered tags are MATCH_OR_SKIP. */
 				if (op & ASN1_OP_MATCH__SKIP) {
 					pc += asn1_op_lengths[op];
-					dp--;
+					dp = tagp;
 					goto next_op;
 				}
 				goto tag_mismatch;
@@ -280,7 +279,7 @@ next_op:
 					goto data_overrun_error;
 			} else {
 				int n = len - 0x80;
-				if (unlikely(n > 2))
+				if (unlikely(n > MAX_LEN_OCTETS))
 					goto length_too_long;
 				if (unlikely(dp >= datalen - n))
 					goto data_overrun_error;
@@ -292,21 +291,24 @@ next_op:
 				if (unlikely(len > datalen - dp))
 					goto data_overrun_error;
 			}
+		} else {
+			if (unlikely(len > datalen - dp))
+				goto data_overrun_error;
 		}
 
 		if (flags & FLAG_CONS) {
 			/* For expected compound forms, we stack the positions
 			 * of the start and end of the data.
 			 */
-			if (unlikely(csp >= NR_CONS_STACK))
+			if (unlikely(csp >= cons->depth))
 				goto cons_stack_overflow;
-			cons_dp_stack[csp] = dp;
-			cons_hdrlen_stack[csp] = hdr;
+			cons->dp[csp] = dp;
+			cons->hdrlen[csp] = hdr;
 			if (!(flags & FLAG_INDEFINITE_LENGTH)) {
-				cons_datalen_stack[csp] = datalen;
+				cons->datalen[csp] = datalen;
 				datalen = dp + len;
 			} else {
-				cons_datalen_stack[csp] = 0;
+				cons->datalen[csp] = 0;
 			}
 			csp++;
 		}
@@ -384,10 +386,10 @@ next_op:
 		if (unlikely(csp <= 0))
 			goto cons_stack_underflow;
 		csp--;
-		tdp = cons_dp_stack[csp];
-		hdr = cons_hdrlen_stack[csp];
+		tdp = cons->dp[csp];
+		hdr = cons->hdrlen[csp];
 		len = datalen;
-		datalen = cons_datalen_stack[csp];
+		datalen = cons->datalen[csp];
 		if (datalen == 0) {
 			/* Indefinite length - check for the EOC. */
 			datalen = len;
@@ -483,9 +485,92 @@ tag_mismatch:
 	Errmsg = L"Unexpected tag";
 	goto error;
 long_tag_not_supported:
-	Errmsg = L"Long tag not supported";
+	Errmsg = L"Tag number too large";
 error:
         Print(L"ERROR: %s\n", Errmsg);
 	return -EBADMSG;
 }
 
+/**
+ * asn1_ber_decoder - Decoder BER/DER/CER ASN.1 according to pattern
+ * @decoder: The decoder definition (produced by asn1_compiler)
+ * @context: The caller's context (to be passed to the action functions)
+ * @data: The encoded data
+ * @datasize: The size of the encoded data
+ *
+ * Decode BER/DER/CER encoded ASN.1 data according to a bytecode pattern
+ * produced by asn1_compiler.  Action functions are called on marked tags to
+ * allow the caller to retrieve significant data.
+ *
+ * LIMITATIONS:
+ *
+ * This is the fast path for small DER inputs: everything lives on the
+ * stack and no pool memory is used.
+ *
+ *  (1) This won't handle datalen > 65535.  Use asn1_ber_decoder_ex().
+ *
+ *  (2) The stack of constructed types is 10 deep.  If the depth of non-leaf
+ *	constructed types exceeds this, the decode will fail.
+ *
+ *  (3) The SET type (not the SET OF type) isn't really supported as tracking
+ *	what members of the set have been seen is a pain.
+ */
+int asn1_ber_decoder(const struct asn1_decoder *decoder,
+		     void *context,
+		     const unsigned char *data,
+		     size_t datalen)
+{
+	if (datalen > 65535)
+		return -EMSGSIZE;
+
+	return asn1_ber_decoder_ex(decoder, context, data, datalen, NR_CONS_STACK);
+}
+
+/**
+ * asn1_ber_decoder_ex - Decode a large or deeply nested BER/DER/CER object
+ * @decoder: The decoder definition (produced by asn1_compiler)
+ * @context: The caller's context (to be passed to the action functions)
+ * @data: The encoded data
+ * @datasize: The size of the encoded data, up to 4GiB - 1
+ * @max_depth: The deepest nesting of constructed types to accept
+ *
+ * As asn1_ber_decoder() but with 32-bit offsets and a cons stack of
+ * @max_depth entries.  A depth of up to 10 is kept on the stack; a deeper
+ * one is allocated once for the whole decode.
+ */
+int asn1_ber_decoder_ex(const struct asn1_decoder *decoder,
+			void *context,
+			const unsigned char *data,
+			size_t datalen,
+			unsigned int max_depth)
+{
+	unsigned int cons_dp_stack[NR_CONS_STACK];
+	unsigned int cons_datalen_stack[NR_CONS_STACK];
+	unsigned char cons_hdrlen_stack[NR_CONS_STACK];
+	struct asn1_cons_stack cons;
+	void *pool = NULL;
+	int ret;
+
+	if ((UINT64)datalen > 0xffffffff)
+		return -EMSGSIZE;
+
+	if (max_depth <= NR_CONS_STACK) {
+		cons.dp = cons_dp_stack;
+		cons.datalen = cons_datalen_stack;
+		cons.hdrlen = cons_hdrlen_stack;
+	} else {
+		pool = AllocatePool(max_depth * (2 * sizeof(unsigned int) + 1));
+		if (!pool)
+			return -ENOMEM;
+		cons.dp = pool;
+		cons.datalen = cons.dp + max_depth;
+		cons.hdrlen = (unsigned char *)(cons.datalen + max_depth);
+	}
+	cons.depth = max_depth;
+
+	ret = asn1_ber_decode(decoder, context, data, datalen, &cons);
+
+	if (pool)
+		FreePool(pool);
+	return ret;
+}
@@ -35,4 +35,11 @@ asn1_ber_decoder( const struct asn1_decoder *decoder,
 		  const unsigned char *data,
 		  size_t datalen );
 
+extern int 
+asn1_ber_decoder_ex( const struct asn1_decoder *decoder,
+		     void *context,
+		     const unsigned char *data,
+		     size_t datalen,
+		     unsigned int max_depth );
+
 #endif /* _ASN1_DECODER_H */
@@ -0,0 +1,296 @@
+//
+//  Copyright (c) 2012-2019  Finnbarr P. Murphy.  All rights reserved.
+//
+//  Multi-precision modular arithmetic for signature verification
+//
+//  Montgomery multiplication (CIOS) over 32-bit limbs, enough for RSA
+//  keys up to BN_MAX_BITS and the P-256/P-384 field and group orders.
+//
+//  License: BSD 2 clause License
+//
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+
+#include "bignum.h"
+
+
+BOOLEAN
+BnFromBytes( UINT32 *A,
+             UINTN Limbs,
+             CONST UINT8 *Bytes,
+             UINTN Len )
+{
+    // skip leading zeros, e.g. the sign octet of an ASN.1 INTEGER
+    while (Len > 0 && *Bytes == 0) {
+        Bytes++;
+        Len--;
+    }
+    if (Len > Limbs * 4) {
+        return FALSE;
+    }
+
+    ZeroMem( A, Limbs * sizeof(UINT32) );
+    for (UINTN i = 0; i < Len; i++) {
+        A[i / 4] |= (UINT32)Bytes[Len - 1 - i] << ((i % 4) * 8);
+    }
+    return TRUE;
+}
+
+
+VOID
+BnToBytes( CONST UINT32 *A,
+           UINTN Limbs,
+           UINT8 *Bytes,
+           UINTN Len )
+{
+    for (UINTN i = 0; i < Len; i++) {
+        Bytes[Len - 1 - i] = (i / 4 < Limbs) ? (UINT8)(A[i / 4] >> ((i % 4) * 8)) : 0;
+    }
+}
+
+
+INTN
+BnCmp( CONST UINT32 *A,
+       CONST UINT32 *B,
+       UINTN Limbs )
+{
+    while (Limbs-- > 0) {
+        if (A[Limbs] != B[Limbs]) {
+            return (A[Limbs] > B[Limbs]) ? 1 : -1;
+        }
+    }
+    return 0;
+}
+
+
+BOOLEAN
+BnIsZero( CONST UINT32 *A,
+          UINTN Limbs )
+{
+    for (UINTN i = 0; i < Limbs; i++) {
+        if (A[i] != 0) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+
+STATIC
+UINT32
+BnAdd( UINT32 *R,
+       CONST UINT32 *A,
+       CONST UINT32 *B,
+       UINTN Limbs )
+{
+    UINT64 Carry = 0;
+
+    for (UINTN i = 0; i < Limbs; i++) {
+        Carry += (UINT64)A[i] + B[i];
+        R[i] = (UINT32)Carry;
+        Carry >>= 32;
+    }
+    return (UINT32)Carry;
+}
+
+
+STATIC
+UINT32
+BnSub( UINT32 *R,
+       CONST UINT32 *A,
+       CONST UINT32 *B,
+       UINTN Limbs )
+{
+    UINT64 Borrow = 0;
+
+    for (UINTN i = 0; i < Limbs; i++) {
+        UINT64 Diff = (UINT64)A[i] - B[i] - Borrow;
+        R[i] = (UINT32)Diff;
+        Borrow = (Diff >> 63);
+    }
+    return (UINT32)Borrow;
+}
+
+
+BOOLEAN
+BnMontInit( BN_MONT *Mont,
+            CONST UINT8 *Modulus,
+            UINTN Len )
+{
+    UINT32 Inv;
+    UINT32 Unit[BN_MAX_LIMBS];
+    UINTN  Limbs;
+
+    while (Len > 0 && *Modulus == 0) {
+        Modulus++;
+        Len--;
+    }
+    Limbs = (Len + 3) / 4;
+    if (Limbs == 0 || Limbs > BN_MAX_LIMBS || !(Modulus[Len - 1] & 1) ||
+        (Len == 1 && Modulus[0] == 1)) {
+        return FALSE;
+    }
+
+    Mont->Limbs = Limbs;
+    BnFromBytes( Mont->N, Limbs, Modulus, Len );
+
+    // Newton iteration doubles the correct low bits each step: 1, 2, 4 ... 32
+    Inv = Mont->N[0];
+    for (int i = 0; i < 5; i++) {
+        Inv *= 2 - Mont->N[0] * Inv;
+    }
+    Mont->N0 = (UINT32)(0 - Inv);
+
+    // R^2 mod N by doubling 1 a total of 2 * 32 * Limbs times
+    ZeroMem( Mont->RR, sizeof(Mont->RR) );
+    Mont->RR[0] = 1;
+    for (UINTN i = 0; i < 64 * Limbs; i++) {
+        UINT32 Carry = BnAdd( Mont->RR, Mont->RR, Mont->RR, Limbs );
+        if (Carry || BnCmp( Mont->RR, Mont->N, Limbs ) >= 0) {
+            BnSub( Mont->RR, Mont->RR, Mont->N, Limbs );
+        }
+    }
+
+    ZeroMem( Unit, sizeof(Unit) );
+    Unit[0] = 1;
+    BnMontMul( Mont, Mont->One, Mont->RR, Unit );
+
+    return TRUE;
+}
+
+
+VOID
+BnMontMul( CONST BN_MONT *Mont,
+           UINT32 *R,
+           CONST UINT32 *A,
+           CONST UINT32 *B )
+{
+    UINT32 T[BN_MAX_LIMBS + 2];
+    UINTN  n = Mont->Limbs;
+    UINT64 Carry;
+    UINT32 m;
+
+    ZeroMem( T, (n + 2) * sizeof(UINT32) );
+
+    for (UINTN i = 0; i < n; i++) {
+        Carry = 0;
+        for (UINTN j = 0; j < n; j++) {
+            Carry += (UINT64)A[j] * B[i] + T[j];
+            T[j] = (UINT32)Carry;
+            Carry >>= 32;
+        }
+        Carry += T[n];
+        T[n] = (UINT32)Carry;
+        T[n + 1] = (UINT32)(Carry >> 32);
+
+        m = T[0] * Mont->N0;
+        Carry = ((UINT64)m * Mont->N[0] + T[0]) >> 32;
+        for (UINTN j = 1; j < n; j++) {
+            Carry += (UINT64)m * Mont->N[j] + T[j];
+            T[j - 1] = (UINT32)Carry;
+            Carry >>= 32;
+        }
+        Carry += T[n];
+        T[n - 1] = (UINT32)Carry;
+        T[n] = T[n + 1] + (UINT32)(Carry >> 32);
+    }
+
+    if (T[n] != 0 || BnCmp( T, Mont->N, n ) >= 0) {
+        BnSub( T, T, Mont->N, n );
+    }
+    CopyMem( R, T, n * sizeof(UINT32) );
+}
+
+
+VOID
+BnToMont( CONST BN_MONT *Mont,
+          UINT32 *R,
+          CONST UINT32 *A )
+{
+    BnMontMul( Mont, R, A, Mont->RR );
+}
+
+
+VOID
+BnFromMont( CONST BN_MONT *Mont,
+            UINT32 *R,
+            CONST UINT32 *A )
+{
+    UINT32 Unit[BN_MAX_LIMBS];
+
+    ZeroMem( Unit, Mont->Limbs * sizeof(UINT32) );
+    Unit[0] = 1;
+    BnMontMul( Mont, R, A, Unit );
+}
+
+
+VOID
+BnModAdd( CONST BN_MONT *Mont,
+          UINT32 *R,
+          CONST UINT32 *A,
+          CONST UINT32 *B )
+{
+    UINT32 Carry = BnAdd( R, A, B, Mont->Limbs );
+
+    if (Carry || BnCmp( R, Mont->N, Mont->Limbs ) >= 0) {
+        BnSub( R, R, Mont->N, Mont->Limbs );
+    }
+}
+
+
+VOID
+BnModSub( CONST BN_MONT *Mont,
+          UINT32 *R,
+          CONST UINT32 *A,
+          CONST UINT32 *B )
+{
+    if (BnSub( R, A, B, Mont->Limbs )) {
+        BnAdd( R, R, Mont->N, Mont->Limbs );
+    }
+}
+
+
+VOID
+BnModExp( CONST BN_MONT *Mont,
+          UINT32 *R,
+          CONST UINT32 *A,
+          CONST UINT8 *Exp,
+          UINTN ExpLen )
+{
+    UINT32 Acc[BN_MAX_LIMBS];
+    UINT32 Base[BN_MAX_LIMBS];
+
+    CopyMem( Base, A, Mont->Limbs * sizeof(UINT32) );
+    CopyMem( Acc, Mont->One, Mont->Limbs * sizeof(UINT32) );
+
+    // left to right square and multiply; exponents here are public
+    for (UINTN i = 0; i < ExpLen; i++) {
+        for (int Bit = 7; Bit >= 0; Bit--) {
+            BnMontMul( Mont, Acc, Acc, Acc );
+            if (Exp[i] & (1 << Bit)) {
+                BnMontMul( Mont, Acc, Acc, Base );
+            }
+        }
+    }
+    CopyMem( R, Acc, Mont->Limbs * sizeof(UINT32) );
+}
+
+
+VOID
+BnModInverse( CONST BN_MONT *Mont,
+              UINT32 *R,
+              CONST UINT32 *A )
+{
+    UINT32 Two[BN_MAX_LIMBS];
+    UINT32 Exp[BN_MAX_LIMBS];
+    UINT8  Bytes[BN_MAX_LIMBS * 4];
+
+    // Fermat: A^(N-2)
+    ZeroMem( Two, Mont->Limbs * sizeof(UINT32) );
+    Two[0] = 2;
+    BnSub( Exp, Mont->N, Two, Mont->Limbs );
+    BnToBytes( Exp, Mont->Limbs, Bytes, Mont->Limbs * 4 );
+    BnModExp( Mont, R, A, Bytes, Mont->Limbs * 4 );
+}
@@ -0,0 +1,101 @@
+//
+//  Copyright (c) 2012-2019  Finnbarr P. Murphy.  All rights reserved.
+//
+//  Multi-precision modular arithmetic for signature verification
+//
+//  Numbers are arrays of 32-bit limbs, least significant first, sized by
+//  the modulus they belong to. Nothing here is constant time; it only
+//  ever handles public values.
+//
+//  License: BSD 2 clause License
+//
+
+#ifndef _BIGNUM_H
+#define _BIGNUM_H
+
+#define BN_MAX_BITS     4096
+#define BN_MAX_LIMBS    (BN_MAX_BITS / 32)
+
+// Montgomery context for an odd modulus N, R = 2^(32 * Limbs)
+typedef struct {
+    UINTN   Limbs;
+    UINT32  N[BN_MAX_LIMBS];
+    UINT32  N0;                     // -N^-1 mod 2^32
+    UINT32  RR[BN_MAX_LIMBS];       // R^2 mod N
+    UINT32  One[BN_MAX_LIMBS];      // R mod N, i.e. 1 in Montgomery form
+} BN_MONT;
+
+// big-endian bytes to limbs; FALSE if the value needs more than Limbs
+BOOLEAN
+BnFromBytes( UINT32 *A,
+             UINTN Limbs,
+             CONST UINT8 *Bytes,
+             UINTN Len );
+
+// limbs to Len big-endian bytes, dropping any higher bytes
+VOID
+BnToBytes( CONST UINT32 *A,
+           UINTN Limbs,
+           UINT8 *Bytes,
+           UINTN Len );
+
+INTN
+BnCmp( CONST UINT32 *A,
+       CONST UINT32 *B,
+       UINTN Limbs );
+
+BOOLEAN
+BnIsZero( CONST UINT32 *A,
+          UINTN Limbs );
+
+// FALSE unless Modulus is odd, greater than one and at most BN_MAX_BITS
+BOOLEAN
+BnMontInit( BN_MONT *Mont,
+            CONST UINT8 *Modulus,
+            UINTN Len );
+
+// R = A * B / R mod N. R may alias A or B.
+VOID
+BnMontMul( CONST BN_MONT *Mont,
+           UINT32 *R,
+           CONST UINT32 *A,
+           CONST UINT32 *B );
+
+VOID
+BnToMont( CONST BN_MONT *Mont,
+          UINT32 *R,
+          CONST UINT32 *A );
+
+VOID
+BnFromMont( CONST BN_MONT *Mont,
+            UINT32 *R,
+            CONST UINT32 *A );
+
+// R = A + B mod N and R = A - B mod N, for A and B less than N
+VOID
+BnModAdd( CONST BN_MONT *Mont,
+          UINT32 *R,
+          CONST UINT32 *A,
+          CONST UINT32 *B );
+
+VOID
+BnModSub( CONST BN_MONT *Mont,
+          UINT32 *R,
+          CONST UINT32 *A,
+          CONST UINT32 *B );
+
+// R = A^E mod N, A and R in Montgomery form, E big-endian bytes
+VOID
+BnModExp( CONST BN_MONT *Mont,
+          UINT32 *R,
+          CONST UINT32 *A,
+          CONST UINT8 *Exp,
+          UINTN ExpLen );
+
+// R = A^-1 mod N for a prime N, Montgomery form in and out
+VOID
+BnModInverse( CONST BN_MONT *Mont,
+              UINT32 *R,
+              CONST UINT32 *A );
+
+#endif
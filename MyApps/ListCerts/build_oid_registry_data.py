@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+#
+#  Copyright (c) 2019   Finnbarr P. Murphy.   All rights reserved.
+#
+#  Generate oid_registry_data.h from the enum OID in oid_registry.h.
+#
+#  License: BSD 2 clause License
+#
+#  Usage: build_oid_registry_data.py [oid_registry.h] [oid_registry_data.h]
+#
+#  Each enum line has the form
+#
+#      OID_name,       /* dotted.oid [Label] */
+#
+#  Label is the name ListCerts prints for the OID and defaults to the enum
+#  name less its OID_ prefix.  Derived from build_OID_registry in the
+#  Linux kernel.
+#
+
+import re
+import sys
+
+ENTRY = re.compile(r'^\s*(OID_[A-Za-z][A-Za-z0-9_]*),\s*/\*\s*([012][0-9.]*)(?:\s+(\S+))?\s*\*/')
+
+
+def encode(dotted):
+    arcs = [int(c) for c in dotted.split('.')]
+    octets = [arcs[0] * 40 + arcs[1]]
+    for arc in arcs[2:]:
+        chunk = [arc & 0x7f]
+        arc >>= 7
+        while arc:
+            chunk.insert(0, 0x80 | (arc & 0x7f))
+            arc >>= 7
+        octets += chunk
+    return octets
+
+
+def oid_hash(octets):
+    # must match Lookup_OID()
+    h = len(octets) - 1
+    for o in octets:
+        h += o * 33
+    h = (h >> 24) ^ (h >> 16) ^ (h >> 8) ^ h
+    return h & 0xff
+
+
+def main():
+    src = sys.argv[1] if len(sys.argv) > 1 else 'oid_registry.h'
+    dst = sys.argv[2] if len(sys.argv) > 2 else 'oid_registry_data.h'
+
+    entries = []
+    with open(src) as f:
+        for line in f:
+            m = ENTRY.match(line)
+            if m:
+                name = m.group(1)
+                entries.append((name, encode(m.group(2)), m.group(3) or name[4:]))
+
+    out = []
+    out.append('/*')
+    out.append(' * Automatically generated by build_oid_registry_data.py.  Do not edit')
+    out.append(' */')
+    out.append('')
+    out.append('static const unsigned short oid_index[OID__NR + 1] = {')
+    offset = 0
+    for name, octets, label in entries:
+        out.append('\t[%s] = %d,' % (name, offset))
+        offset += len(octets)
+    out.append('\t[OID__NR] = %d' % offset)
+    out.append('};')
+    out.append('')
+    out.append('static const unsigned char oid_data[%d] = {' % offset)
+    for name, octets, label in entries:
+        out.append('\t' + ''.join('%d, ' % o for o in octets) + '\t// ' + name[4:])
+    out.append('};')
+    out.append('')
+    out.append('static const struct {')
+    out.append('\tunsigned char hash;')
+    out.append('\tenum OID oid : 8;')
+    out.append('} oid_search_table[OID__NR] = {')
+    order = sorted(entries, key=lambda e: (oid_hash(e[1]), len(e[1]), e[1][::-1]))
+    for index, (name, octets, label) in enumerate(order):
+        out.append('\t[%3d] = { %3d, %-40s}, // %s' %
+                   (index, oid_hash(octets), name, ''.join('%02x' % o for o in octets)))
+    out.append('};')
+    out.append('')
+    out.append('static const CHAR16 * const oid_name_table[OID__NR] = {')
+    for name, octets, label in entries:
+        out.append('\t[%s] = L"%s",' % (name, label))
+    out.append('};')
+
+    with open(dst, 'w') as f:
+        f.write('\n'.join(out) + '\n')
+
+
+if __name__ == '__main__':
+    main()
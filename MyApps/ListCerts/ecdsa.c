@@ -0,0 +1,353 @@
+//
+//  Copyright (c) 2012-2019  Finnbarr P. Murphy.  All rights reserved.
+//
+//  ECDSA signature verification over NIST P-256 and P-384 (FIPS 186-4)
+//
+//  Points are kept in Jacobian coordinates with the field elements in
+//  Montgomery form. u1*G + u2*Q is computed in a single pass (Shamir).
+//
+//  License: BSD 2 clause License
+//
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include "bignum.h"
+#include "ecdsa.h"
+
+#define EC_LIMBS        12            // enough for P-384
+#define EC_MAX_SIZE     (EC_LIMBS * 4)
+
+typedef struct {
+    UINTN       Size;                 // bytes in p and n
+    UINT8       P[EC_MAX_SIZE];
+    UINT8       B[EC_MAX_SIZE];
+    UINT8       Gx[EC_MAX_SIZE];
+    UINT8       Gy[EC_MAX_SIZE];
+    UINT8       N[EC_MAX_SIZE];
+} EC_CURVE;
+
+// Jacobian (X / Z^2, Y / Z^3); Z is zero for the point at infinity
+typedef struct {
+    UINT32      X[EC_LIMBS];
+    UINT32      Y[EC_LIMBS];
+    UINT32      Z[EC_LIMBS];
+} EC_POINT;
+
+typedef struct {
+    BN_MONT     P;                    // the field
+    BN_MONT     N;                    // the group order
+    UINT32      B[EC_LIMBS];          // Montgomery form
+} EC_GROUP;
+
+// both curves have a = -3, which the doubling formula relies on
+STATIC CONST EC_CURVE CurveP256 = {
+    32,
+    { 0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+      0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff },
+    { 0x5a, 0xc6, 0x35, 0xd8, 0xaa, 0x3a, 0x93, 0xe7, 0xb3, 0xeb, 0xbd, 0x55, 0x76, 0x98, 0x86, 0xbc,
+      0x65, 0x1d, 0x06, 0xb0, 0xcc, 0x53, 0xb0, 0xf6, 0x3b, 0xce, 0x3c, 0x3e, 0x27, 0xd2, 0x60, 0x4b },
+    { 0x6b, 0x17, 0xd1, 0xf2, 0xe1, 0x2c, 0x42, 0x47, 0xf8, 0xbc, 0xe6, 0xe5, 0x63, 0xa4, 0x40, 0xf2,
+      0x77, 0x03, 0x7d, 0x81, 0x2d, 0xeb, 0x33, 0xa0, 0xf4, 0xa1, 0x39, 0x45, 0xd8, 0x98, 0xc2, 0x96 },
+    { 0x4f, 0xe3, 0x42, 0xe2, 0xfe, 0x1a, 0x7f, 0x9b, 0x8e, 0xe7, 0xeb, 0x4a, 0x7c, 0x0f, 0x9e, 0x16,
+      0x2b, 0xce, 0x33, 0x57, 0x6b, 0x31, 0x5e, 0xce, 0xcb, 0xb6, 0x40, 0x68, 0x37, 0xbf, 0x51, 0xf5 },
+    { 0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+      0xbc, 0xe6, 0xfa, 0xad, 0xa7, 0x17, 0x9e, 0x84, 0xf3, 0xb9, 0xca, 0xc2, 0xfc, 0x63, 0x25, 0x51 }
+};
+
+STATIC CONST EC_CURVE CurveP384 = {
+    48,
+    { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+      0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe,
+      0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff },
+    { 0xb3, 0x31, 0x2f, 0xa7, 0xe2, 0x3e, 0xe7, 0xe4, 0x98, 0x8e, 0x05, 0x6b, 0xe3, 0xf8, 0x2d, 0x19,
+      0x18, 0x1d, 0x9c, 0x6e, 0xfe, 0x81, 0x41, 0x12, 0x03, 0x14, 0x08, 0x8f, 0x50, 0x13, 0x87, 0x5a,
+      0xc6, 0x56, 0x39, 0x8d, 0x8a, 0x2e, 0xd1, 0x9d, 0x2a, 0x85, 0xc8, 0xed, 0xd3, 0xec, 0x2a, 0xef },
+    { 0xaa, 0x87, 0xca, 0x22, 0xbe, 0x8b, 0x05, 0x37, 0x8e, 0xb1, 0xc7, 0x1e, 0xf3, 0x20, 0xad, 0x74,
+      0x6e, 0x1d, 0x3b, 0x62, 0x8b, 0xa7, 0x9b, 0x98, 0x59, 0xf7, 0x41, 0xe0, 0x82, 0x54, 0x2a, 0x38,
+      0x55, 0x02, 0xf2, 0x5d, 0xbf, 0x55, 0x29, 0x6c, 0x3a, 0x54, 0x5e, 0x38, 0x72, 0x76, 0x0a, 0xb7 },
+    { 0x36, 0x17, 0xde, 0x4a, 0x96, 0x26, 0x2c, 0x6f, 0x5d, 0x9e, 0x98, 0xbf, 0x92, 0x92, 0xdc, 0x29,
+      0xf8, 0xf4, 0x1d, 0xbd, 0x28, 0x9a, 0x14, 0x7c, 0xe9, 0xda, 0x31, 0x13, 0xb5, 0xf0, 0xb8, 0xc0,
+      0x0a, 0x60, 0xb1, 0xce, 0x1d, 0x7e, 0x81, 0x9d, 0x7a, 0x43, 0x1d, 0x7c, 0x90, 0xea, 0x0e, 0x5f },
+    { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+      0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xc7, 0x63, 0x4d, 0x81, 0xf4, 0x37, 0x2d, 0xdf,
+      0x58, 0x1a, 0x0d, 0xb2, 0x48, 0xb0, 0xa7, 0x7a, 0xec, 0xec, 0x19, 0x6a, 0xcc, 0xc5, 0x29, 0x73 }
+};
+
+
+//
+// R = 2P, dbl-2001-b from the Explicit-Formulas Database
+//
+STATIC
+VOID
+EcDouble( CONST EC_GROUP *G,
+          EC_POINT *R,
+          CONST EC_POINT *P )
+{
+    CONST BN_MONT *F = &G->P;
+    UINT32 Delta[EC_LIMBS], Gamma[EC_LIMBS], Beta[EC_LIMBS], Alpha[EC_LIMBS];
+    UINT32 T1[EC_LIMBS], T2[EC_LIMBS];
+
+    if (BnIsZero( P->Z, F->Limbs )) {
+        *R = *P;
+        return;
+    }
+
+    BnMontMul( F, Delta, P->Z, P->Z );
+    BnMontMul( F, Gamma, P->Y, P->Y );
+    BnMontMul( F, Beta, P->X, Gamma );
+
+    // alpha = 3 (X - delta)(X + delta)
+    BnModSub( F, T1, P->X, Delta );
+    BnModAdd( F, T2, P->X, Delta );
+    BnMontMul( F, T1, T1, T2 );
+    BnModAdd( F, Alpha, T1, T1 );
+    BnModAdd( F, Alpha, Alpha, T1 );
+
+    // Z3 = (Y + Z)^2 - gamma - delta
+    BnModAdd( F, T1, P->Y, P->Z );
+    BnMontMul( F, T1, T1, T1 );
+    BnModSub( F, T1, T1, Gamma );
+    BnModSub( F, R->Z, T1, Delta );
+
+    // X3 = alpha^2 - 8 beta
+    BnModAdd( F, Beta, Beta, Beta );
+    BnModAdd( F, Beta, Beta, Beta );            // 4 beta
+    BnModAdd( F, T2, Beta, Beta );
+    BnMontMul( F, T1, Alpha, Alpha );
+    BnModSub( F, R->X, T1, T2 );
+
+    // Y3 = alpha (4 beta - X3) - 8 gamma^2
+    BnModSub( F, T1, Beta, R->X );
+    BnMontMul( F, T1, Alpha, T1 );
+    BnMontMul( F, T2, Gamma, Gamma );
+    BnModAdd( F, T2, T2, T2 );
+    BnModAdd( F, T2, T2, T2 );
+    BnModAdd( F, T2, T2, T2 );
+    BnModSub( F, R->Y, T1, T2 );
+}
+
+
+//
+// R = P + Q, add-1998-cmo-2
+//
+STATIC
+VOID
+EcAdd( CONST EC_GROUP *G,
+       EC_POINT *R,
+       CONST EC_POINT *P,
+       CONST EC_POINT *Q )
+{
+    CONST BN_MONT *F = &G->P;
+    UINT32 Z1Z1[EC_LIMBS], Z2Z2[EC_LIMBS], U1[EC_LIMBS], U2[EC_LIMBS];
+    UINT32 S1[EC_LIMBS], S2[EC_LIMBS], H[EC_LIMBS], Rr[EC_LIMBS];
+    UINT32 HHH[EC_LIMBS], V[EC_LIMBS], T[EC_LIMBS];
+
+    if (BnIsZero( P->Z, F->Limbs )) {
+        *R = *Q;
+        return;
+    }
+    if (BnIsZero( Q->Z, F->Limbs )) {
+        *R = *P;
+        return;
+    }
+
+    BnMontMul( F, Z1Z1, P->Z, P->Z );
+    BnMontMul( F, Z2Z2, Q->Z, Q->Z );
+    BnMontMul( F, U1, P->X, Z2Z2 );
+    BnMontMul( F, U2, Q->X, Z1Z1 );
+    BnMontMul( F, S1, P->Y, Q->Z );
+    BnMontMul( F, S1, S1, Z2Z2 );
+    BnMontMul( F, S2, Q->Y, P->Z );
+    BnMontMul( F, S2, S2, Z1Z1 );
+    BnModSub( F, H, U2, U1 );
+    BnModSub( F, Rr, S2, S1 );
+
+    if (BnIsZero( H, F->Limbs )) {
+        if (BnIsZero( Rr, F->Limbs )) {
+            EcDouble( G, R, P );
+        } else {
+            ZeroMem( R, sizeof(EC_POINT) );
+        }
+        return;
+    }
+
+    // Z3 = Z1 Z2 H, computed first in case R aliases P or Q
+    BnMontMul( F, T, P->Z, Q->Z );
+    BnMontMul( F, R->Z, T, H );
+
+    BnMontMul( F, T, H, H );
+    BnMontMul( F, HHH, H, T );
+    BnMontMul( F, V, U1, T );
+
+    // X3 = r^2 - H^3 - 2 V
+    BnMontMul( F, T, Rr, Rr );
+    BnModSub( F, T, T, HHH );
+    BnModSub( F, T, T, V );
+    BnModSub( F, R->X, T, V );
+
+    // Y3 = r (V - X3) - S1 H^3
+    BnModSub( F, T, V, R->X );
+    BnMontMul( F, T, Rr, T );
+    BnMontMul( F, S1, S1, HHH );
+    BnModSub( F, R->Y, T, S1 );
+}
+
+
+//
+// y^2 = x^3 - 3x + b, affine coordinates in Montgomery form
+//
+STATIC
+BOOLEAN
+EcOnCurve( CONST EC_GROUP *G,
+           CONST UINT32 *X,
+           CONST UINT32 *Y )
+{
+    CONST BN_MONT *F = &G->P;
+    UINT32 Lhs[EC_LIMBS], Rhs[EC_LIMBS], T[EC_LIMBS];
+
+    BnMontMul( F, Lhs, Y, Y );
+    BnMontMul( F, Rhs, X, X );
+    BnMontMul( F, Rhs, Rhs, X );
+    BnModAdd( F, T, X, X );
+    BnModAdd( F, T, T, X );
+    BnModSub( F, Rhs, Rhs, T );
+    BnModAdd( F, Rhs, Rhs, G->B );
+
+    return BnCmp( Lhs, Rhs, F->Limbs ) == 0;
+}
+
+
+//
+// Affine point from big-endian coordinates; FALSE if either is not
+// below p or the point is not on the curve
+//
+STATIC
+BOOLEAN
+EcLoadPoint( CONST EC_GROUP *G,
+             EC_POINT *P,
+             CONST UINT8 *X,
+             CONST UINT8 *Y,
+             UINTN Size )
+{
+    CONST BN_MONT *F = &G->P;
+
+    if (!BnFromBytes( P->X, F->Limbs, X, Size ) || BnCmp( P->X, F->N, F->Limbs ) >= 0 ||
+        !BnFromBytes( P->Y, F->Limbs, Y, Size ) || BnCmp( P->Y, F->N, F->Limbs ) >= 0) {
+        return FALSE;
+    }
+    BnToMont( F, P->X, P->X );
+    BnToMont( F, P->Y, P->Y );
+    CopyMem( P->Z, F->One, F->Limbs * sizeof(UINT32) );
+
+    return EcOnCurve( G, P->X, P->Y );
+}
+
+
+// 0 < A < n
+STATIC
+BOOLEAN
+EcScalarInRange( CONST BN_MONT *N,
+                 UINT32 *A,
+                 CONST UINT8 *Bytes,
+                 UINTN Len )
+{
+    return BnFromBytes( A, N->Limbs, Bytes, Len ) &&
+           !BnIsZero( A, N->Limbs ) &&
+           BnCmp( A, N->N, N->Limbs ) < 0;
+}
+
+
+EFI_STATUS
+EcdsaVerify( EC_CURVE_ID Curve,
+             CONST UINT8 *PublicKey,
+             UINTN PublicKeyLen,
+             CONST UINT8 *Digest,
+             UINTN DigestSize,
+             CONST UINT8 *R,
+             UINTN RLen,
+             CONST UINT8 *S,
+             UINTN SLen )
+{
+    CONST EC_CURVE *C = (Curve == EcCurveP384) ? &CurveP384 : &CurveP256;
+    EC_GROUP   *G;
+    EC_POINT   Base, Key, Sum, Acc;
+    UINT32     r[EC_LIMBS], s[EC_LIMBS], e[EC_LIMBS], w[EC_LIMBS];
+    UINT32     u1[EC_LIMBS], u2[EC_LIMBS], T[EC_LIMBS];
+    UINTN      Limbs;
+    EFI_STATUS Status = EFI_SECURITY_VIOLATION;
+
+    G = AllocatePool( sizeof(EC_GROUP) );
+    if (G == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+    }
+    BnMontInit( &G->P, C->P, C->Size );
+    BnMontInit( &G->N, C->N, C->Size );
+    Limbs = G->P.Limbs;
+    BnFromBytes( G->B, Limbs, C->B, C->Size );
+    BnToMont( &G->P, G->B, G->B );
+    EcLoadPoint( G, &Base, C->Gx, C->Gy, C->Size );
+
+    if (PublicKeyLen != 1 + 2 * C->Size || PublicKey[0] != 0x04 ||
+        !EcLoadPoint( G, &Key, PublicKey + 1, PublicKey + 1 + C->Size, C->Size )) {
+        Status = EFI_UNSUPPORTED;
+        goto Done;
+    }
+
+    if (!EcScalarInRange( &G->N, r, R, RLen ) || !EcScalarInRange( &G->N, s, S, SLen )) {
+        goto Done;
+    }
+
+    // e is the leftmost bits of the digest, reduced mod n
+    BnFromBytes( e, Limbs, Digest, MIN( DigestSize, C->Size ) );
+    if (BnCmp( e, G->N.N, Limbs ) >= 0) {
+        BnModSub( &G->N, e, e, G->N.N );
+    }
+
+    // w = s^-1, u1 = e w, u2 = r w (mod n)
+    BnToMont( &G->N, w, s );
+    BnModInverse( &G->N, w, w );
+    BnToMont( &G->N, T, e );
+    BnMontMul( &G->N, u1, T, w );
+    BnFromMont( &G->N, u1, u1 );
+    BnToMont( &G->N, T, r );
+    BnMontMul( &G->N, u2, T, w );
+    BnFromMont( &G->N, u2, u2 );
+
+    EcAdd( G, &Sum, &Base, &Key );
+    ZeroMem( &Acc, sizeof(Acc) );
+    for (INTN Bit = C->Size * 8 - 1; Bit >= 0; Bit--) {
+        BOOLEAN b1 = (u1[Bit / 32] >> (Bit % 32)) & 1;
+        BOOLEAN b2 = (u2[Bit / 32] >> (Bit % 32)) & 1;
+
+        EcDouble( G, &Acc, &Acc );
+        if (b1 && b2) {
+            EcAdd( G, &Acc, &Acc, &Sum );
+        } else if (b1) {
+            EcAdd( G, &Acc, &Acc, &Base );
+        } else if (b2) {
+            EcAdd( G, &Acc, &Acc, &Key );
+        }
+    }
+    if (BnIsZero( Acc.Z, Limbs )) {
+        goto Done;
+    }
+
+    // x = X / Z^2, then compare x mod n with r
+    BnModInverse( &G->P, T, Acc.Z );
+    BnMontMul( &G->P, T, T, T );
+    BnMontMul( &G->P, T, Acc.X, T );
+    BnFromMont( &G->P, T, T );
+    if (BnCmp( T, G->N.N, Limbs ) >= 0) {
+        BnModSub( &G->N, T, T, G->N.N );
+    }
+    if (BnCmp( T, r, Limbs ) == 0) {
+        Status = EFI_SUCCESS;
+    }
+
+Done:
+    FreePool( G );
+    return Status;
+}
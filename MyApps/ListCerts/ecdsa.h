@@ -0,0 +1,33 @@
+//
+//  Copyright (c) 2012-2019  Finnbarr P. Murphy.  All rights reserved.
+//
+//  ECDSA signature verification over NIST P-256 and P-384 (FIPS 186-4)
+//
+//  License: BSD 2 clause License
+//
+
+#ifndef _ECDSA_H
+#define _ECDSA_H
+
+typedef enum {
+    EcCurveP256,
+    EcCurveP384
+} EC_CURVE_ID;
+
+//
+// Check the signature (R, S) over Digest with an uncompressed public key
+// (0x04 || X || Y). Returns EFI_SECURITY_VIOLATION if it does not verify
+// and EFI_UNSUPPORTED if the key is not a point on the curve.
+//
+EFI_STATUS
+EcdsaVerify( EC_CURVE_ID Curve,
+             CONST UINT8 *PublicKey,
+             UINTN PublicKeyLen,
+             CONST UINT8 *Digest,
+             UINTN DigestSize,
+             CONST UINT8 *R,
+             UINTN RLen,
+             CONST UINT8 *S,
+             UINTN SLen );
+
+#endif
@@ -0,0 +1,227 @@
+//
+//  Copyright (c) 2012-2019  Finnbarr P. Murphy.  All rights reserved.
+//
+//  Host build only: decode a corpus of db/dbx/KEK certificates in a loop
+//  and report certificates per second.
+//
+//  Each file may be a DER certificate, an EFI_SIGNATURE_LIST database as
+//  saved by ListCerts --export or efi-readvar, or an efivarfs variable
+//  (the same with a 4 byte attribute prefix). With no files the Secure
+//  Boot variables of the running system are read from efivarfs.
+//
+//  License: BSD 2 clause License
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <Uefi.h>
+
+#include "host.h"
+
+#define MAX_CERTS           4096
+#define MIN_SECONDS         1.0       // run at least this long by default
+#define CERT_HEADER_SIZE    28        // EFI_SIGNATURE_LIST
+#define EFIVARFS            "/sys/firmware/efi/efivars/"
+
+// EFI_CERT_X509_GUID as it is laid out in memory
+STATIC CONST UINT8 gX509[16] = { 0xa1, 0x59, 0xc0, 0xa5, 0xe4, 0x94, 0xa7, 0x4a,
+                                 0x87, 0xb5, 0xab, 0x15, 0x5c, 0x2b, 0xf0, 0x72 };
+
+STATIC CONST char *DefaultFiles[] = {
+    EFIVARFS "PK-8be4df61-93ca-11d2-aa0d-00e098032b8c",
+    EFIVARFS "KEK-8be4df61-93ca-11d2-aa0d-00e098032b8c",
+    EFIVARFS "db-d719b2cb-3d3a-4596-a3bc-dad00e67656f",
+    EFIVARFS "dbx-d719b2cb-3d3a-4596-a3bc-dad00e67656f",
+};
+
+typedef struct {
+    CONST UINT8 *Der;
+    UINTN       Size;
+} CERT;
+
+STATIC CERT  Certs[MAX_CERTS];
+STATIC UINTN CertCount = 0;
+
+
+STATIC VOID
+Usage( VOID )
+{
+    fprintf( stderr, "Usage: bench_x509 [-n iterations] [-p] [file ...]\n" );
+    fprintf( stderr, "  -n  decode the corpus this many times (default: at least %.0f second)\n", MIN_SECONDS );
+    fprintf( stderr, "  -p  print each certificate once before timing\n" );
+}
+
+
+STATIC UINT32
+Read32( CONST UINT8 *p )
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((UINT32)p[3] << 24);
+}
+
+
+//
+// Walk a signature database, keeping the X509 entries. Returns FALSE if
+// Data is not a well formed database.
+//
+STATIC BOOLEAN
+AddSignatureLists( CONST UINT8 *Data,
+                   UINTN Size,
+                   BOOLEAN Add )
+{
+    while (Size > 0) {
+        UINT32 ListSize, HeaderSize, SigSize;
+
+        if (Size < CERT_HEADER_SIZE) {
+            return FALSE;
+        }
+        ListSize = Read32( Data + 16 );
+        HeaderSize = Read32( Data + 20 );
+        SigSize = Read32( Data + 24 );
+        if (ListSize > Size || SigSize <= 16 ||
+            (UINT64)CERT_HEADER_SIZE + HeaderSize > ListSize ||
+            (ListSize - CERT_HEADER_SIZE - HeaderSize) % SigSize != 0) {
+            return FALSE;
+        }
+        if (Add && memcmp( Data, gX509, sizeof(gX509) ) == 0) {
+            CONST UINT8 *Sig = Data + CERT_HEADER_SIZE + HeaderSize;
+            for (; Sig < Data + ListSize && CertCount < MAX_CERTS; Sig += SigSize) {
+                Certs[CertCount].Der = Sig + 16;        // skip SignatureOwner
+                Certs[CertCount].Size = SigSize - 16;
+                CertCount++;
+            }
+        }
+        Data += ListSize;
+        Size -= ListSize;
+    }
+    return TRUE;
+}
+
+
+STATIC BOOLEAN
+AddFile( CONST char *Name,
+         BOOLEAN Quiet )
+{
+    FILE  *f;
+    UINT8 *Data;
+    long  Size;
+
+    f = fopen( Name, "rb" );
+    if (f == NULL) {
+        if (!Quiet) {
+            perror( Name );
+        }
+        return FALSE;
+    }
+    fseek( f, 0, SEEK_END );
+    Size = ftell( f );
+    fseek( f, 0, SEEK_SET );
+    Data = malloc( Size > 0 ? Size : 1 );       // kept for the whole run
+    if (Data == NULL || fread( Data, 1, Size, f ) != (size_t)Size) {
+        fprintf( stderr, "%s: read failed\n", Name );
+        fclose( f );
+        return FALSE;
+    }
+    fclose( f );
+
+    if (Size >= 2 && Data[0] == 0x30 && Data[1] >= 0x80) {
+        if (CertCount < MAX_CERTS) {
+            Certs[CertCount].Der = Data;
+            Certs[CertCount].Size = Size;
+            CertCount++;
+        }
+    } else if (AddSignatureLists( Data, Size, FALSE )) {
+        AddSignatureLists( Data, Size, TRUE );
+    } else if (Size > 4 && AddSignatureLists( Data + 4, Size - 4, FALSE )) {
+        AddSignatureLists( Data + 4, Size - 4, TRUE );
+    } else {
+        fprintf( stderr, "%s: not a certificate or signature database\n", Name );
+        return FALSE;
+    }
+    return TRUE;
+}
+
+
+STATIC double
+Now( VOID )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+int
+main( int argc,
+      char **argv )
+{
+    UINTN  Iterations = 0;
+    UINTN  Passes = 0;
+    UINTN  Bytes = 0;
+    UINTN  Failed = 0;
+    BOOLEAN PrintCerts = FALSE;
+    double Start, Elapsed;
+    int    i;
+
+    for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+        if (!strcmp( argv[i], "-n" ) && i + 1 < argc) {
+            Iterations = strtoul( argv[++i], NULL, 0 );
+        } else if (!strcmp( argv[i], "-p" )) {
+            PrintCerts = TRUE;
+        } else {
+            Usage();
+            return 2;
+        }
+    }
+
+    if (i == argc) {
+        for (UINTN j = 0; j < sizeof(DefaultFiles) / sizeof(DefaultFiles[0]); j++) {
+            AddFile( DefaultFiles[j], TRUE );
+        }
+    }
+    for (; i < argc; i++) {
+        if (!AddFile( argv[i], FALSE )) {
+            return 1;
+        }
+    }
+    if (CertCount == 0) {
+        fprintf( stderr, "No certificates found%s\n", (argc == 1) ? " in " EFIVARFS : "" );
+        Usage();
+        return 1;
+    }
+
+    for (UINTN j = 0; j < CertCount; j++) {
+        mHostPrintQuiet = !PrintCerts;
+        if (PrintCerts) {
+            printf( "\nCertificate %lu (%lu bytes)\n", (unsigned long)j, (unsigned long)Certs[j].Size );
+        }
+        if (HostDecodeCertificate( Certs[j].Der, Certs[j].Size ) < 0) {
+            Failed++;
+        }
+        Bytes += Certs[j].Size;
+    }
+    mHostPrintQuiet = TRUE;
+
+    // output is formatted but discarded, so the figure includes Print cost
+    Start = Now();
+    do {
+        for (UINTN j = 0; j < CertCount; j++) {
+            HostDecodeCertificate( Certs[j].Der, Certs[j].Size );
+        }
+        Passes++;
+        Elapsed = Now() - Start;
+    } while (Iterations ? Passes < Iterations : Elapsed < MIN_SECONDS);
+
+    HostDecodeDone();
+
+    printf( "%lu certificates (%lu bytes, %lu failed to decode), %lu passes in %.3f s\n",
+            (unsigned long)CertCount, (unsigned long)Bytes, (unsigned long)Failed,
+            (unsigned long)Passes, Elapsed );
+    printf( "%.0f certificates/sec  %.1f MB/sec\n",
+            CertCount * Passes / Elapsed, Bytes * Passes / Elapsed / 1e6 );
+
+    return 0;
+}
@@ -0,0 +1,46 @@
+//
+//  Copyright (c) 2012-2019  Finnbarr P. Murphy.  All rights reserved.
+//
+//  Host build only: decode one DER certificate the way PrintCertificates()
+//  does, reusing a single text builder across calls
+//
+//  License: BSD 2 clause License
+//
+
+#include <Uefi.h>
+
+#include "asn1_ber_decoder.h"
+#include "x509.h"
+#include "x509_actions.h"
+#include "host.h"
+
+// as in ListCerts.c
+#define CERT_NESTING_DEPTH  10
+
+STATIC TEXT_BUILDER mText;
+STATIC BOOLEAN      mTextReady = FALSE;
+
+
+int
+HostDecodeCertificate( CONST UINT8 *Der,
+                       UINTN Size )
+{
+    if (!mTextReady) {
+        TextInit( &mText );
+        mTextReady = TRUE;
+    }
+    TextReset( &mText );
+    mText.Truncated = FALSE;
+
+    return asn1_ber_decoder_ex( &x509_decoder, &mText, Der, (size_t)Size, CERT_NESTING_DEPTH );
+}
+
+
+VOID
+HostDecodeDone( VOID )
+{
+    if (mTextReady) {
+        TextFree( &mText );
+        mTextReady = FALSE;
+    }
+}
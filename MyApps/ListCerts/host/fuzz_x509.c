@@ -0,0 +1,105 @@
+//
+//  Copyright (c) 2012-2019  Finnbarr P. Murphy.  All rights reserved.
+//
+//  Host build only: libFuzzer target for the x509 decoder and its actions.
+//
+//  Built with -DFUZZ_STANDALONE (for compilers without libFuzzer) the
+//  main() below replays each file given and then a number of randomly
+//  mutated copies of it.
+//
+//  License: BSD 2 clause License
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <Uefi.h>
+
+#include "host.h"
+
+#define MAX_INPUT           (1 << 20)
+
+
+int
+LLVMFuzzerTestOneInput( const UINT8 *Data,
+                        size_t Size )
+{
+    UINT8 *Copy;
+
+    if (Size > MAX_INPUT) {
+        return 0;
+    }
+
+    // an exact sized copy so that ASan catches reads past the end
+    Copy = malloc( Size ? Size : 1 );
+    memcpy( Copy, Data, Size );
+    mHostPrintQuiet = TRUE;
+    HostDecodeCertificate( Copy, Size );
+    free( Copy );
+
+    return 0;
+}
+
+
+#ifdef FUZZ_STANDALONE
+
+#define MUTATIONS           10000
+
+int
+main( int argc,
+      char **argv )
+{
+    static UINT8 Data[MAX_INPUT];
+    static UINT8 Mutant[MAX_INPUT];
+    unsigned long Mutations = MUTATIONS;
+    int i = 1;
+
+    if (argc > 2 && !strcmp( argv[1], "-runs" )) {
+        Mutations = strtoul( argv[2], NULL, 0 );
+        i = 3;
+    }
+    srand( 1 );
+
+    for (; i < argc; i++) {
+        FILE  *f = fopen( argv[i], "rb" );
+        size_t Size;
+
+        if (f == NULL) {
+            perror( argv[i] );
+            return 1;
+        }
+        Size = fread( Data, 1, sizeof(Data), f );
+        fclose( f );
+
+        LLVMFuzzerTestOneInput( Data, Size );
+        for (unsigned long Run = 0; Run < Mutations && Size > 0; Run++) {
+            size_t Length = Size;
+
+            memcpy( Mutant, Data, Size );
+            for (int Edits = 1 + rand() % 8; Edits > 0; Edits--) {
+                switch (rand() % 4) {
+                case 0:                     // flip a bit
+                    Mutant[rand() % Length] ^= 1 << (rand() % 8);
+                    break;
+                case 1:                     // interesting byte, e.g. in a length
+                    Mutant[rand() % Length] = "\x00\x01\x7f\x80\x81\x82\x84\xff"[rand() % 8];
+                    break;
+                case 2:                     // truncate
+                    Length = 1 + rand() % Length;
+                    break;
+                default:                    // random byte
+                    Mutant[rand() % Length] = (UINT8)rand();
+                    break;
+                }
+            }
+            LLVMFuzzerTestOneInput( Mutant, Length );
+        }
+        printf( "%s: %lu bytes, %lu mutations\n", argv[i], (unsigned long)Size, Mutations );
+    }
+    HostDecodeDone();
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,16 @@
+//
+//  Copyright (c) 2012-2019  Finnbarr P. Murphy.  All rights reserved.
+//
+//  Host build only: entry points shared by the benchmark and fuzz target.
+//  Kept free of the decoder headers so that callers can use <stdio.h>.
+//
+//  License: BSD 2 clause License
+//
+
+#ifndef _HOST_H
+#define _HOST_H
+
+int  HostDecodeCertificate( CONST UINT8 *Der, UINTN Size );
+VOID HostDecodeDone( VOID );
+
+#endif
@@ -0,0 +1,4 @@
+//
+//  Host build only: see ../Uefi.h
+//
+#include <Uefi.h>
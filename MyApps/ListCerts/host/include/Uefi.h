@@ -0,0 +1,63 @@
+//
+//  Copyright (c) 2012-2019  Finnbarr P. Murphy.  All rights reserved.
+//
+//  Host build only: the few EDK2 base types the decoder sources use.
+//  Deliberately stays clear of <stddef.h> since asn1_ber_decoder.h
+//  typedefs its own size_t.
+//
+//  License: BSD 2 clause License
+//
+
+#ifndef _HOST_UEFI_H
+#define _HOST_UEFI_H
+
+typedef unsigned long long  UINT64;
+typedef long long           INT64;
+typedef unsigned int        UINT32;
+typedef int                 INT32;
+typedef unsigned short      UINT16;
+typedef short               INT16;
+typedef unsigned char       UINT8;
+typedef signed char         INT8;
+typedef unsigned char       BOOLEAN;
+typedef UINT64              UINTN;
+typedef INT64               INTN;
+typedef unsigned short      CHAR16;     // build with -fshort-wchar
+typedef char                CHAR8;
+typedef UINTN               EFI_STATUS;
+
+#define VOID                void
+#define CONST               const
+#define STATIC              static
+#define IN
+#define OUT
+#define OPTIONAL
+#define EFIAPI
+
+#define TRUE                ((BOOLEAN)1)
+#define FALSE               ((BOOLEAN)0)
+#ifndef NULL
+#define NULL                ((VOID *)0)
+#endif
+
+#define EFI_SUCCESS         0
+
+//
+// Stand-ins for UefiLib, BaseLib, BaseMemoryLib, MemoryAllocationLib and
+// PrintLib, implemented in shim.c
+//
+extern BOOLEAN mHostPrintQuiet;        // format but discard Print() output
+
+UINTN   EFIAPI Print( CONST CHAR16 *Format, ... );
+UINTN   EFIAPI UnicodeSPrint( CHAR16 *Buffer, UINTN BufferSize, CONST CHAR16 *Format, ... );
+UINTN   EFIAPI StrLen( CONST CHAR16 *String );
+CHAR16 *EFIAPI StrCat( CHAR16 *Destination, CONST CHAR16 *Source );
+VOID   *EFIAPI CopyMem( VOID *Destination, CONST VOID *Source, UINTN Length );
+VOID   *EFIAPI SetMem( VOID *Buffer, UINTN Length, UINT8 Value );
+VOID   *EFIAPI ZeroMem( VOID *Buffer, UINTN Length );
+VOID   *EFIAPI AllocatePool( UINTN AllocationSize );
+VOID   *EFIAPI AllocateZeroPool( UINTN AllocationSize );
+VOID   *EFIAPI ReallocatePool( UINTN OldSize, UINTN NewSize, VOID *OldBuffer );
+VOID    EFIAPI FreePool( VOID *Buffer );
+
+#endif
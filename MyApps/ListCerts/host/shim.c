@@ -0,0 +1,303 @@
+//
+//  Copyright (c) 2012-2019  Finnbarr P. Murphy.  All rights reserved.
+//
+//  Host build only: libc backed stand-ins for the EDK2 library routines
+//  used by the decoder, the OID registry and the x509 actions. Only the
+//  Print format specifiers those sources use are supported.
+//
+//  License: BSD 2 clause License
+//
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <Uefi.h>
+
+#define PRINT_BUFFER_SIZE   4096      // characters, as in UefiLib
+
+BOOLEAN mHostPrintQuiet = FALSE;
+
+
+STATIC UINTN
+PutChar( CHAR16 *Buffer,
+         UINTN Max,
+         UINTN Index,
+         CHAR16 Ch )
+{
+    if (Index + 1 < Max) {
+        Buffer[Index] = Ch;
+    }
+    return Index + 1;
+}
+
+
+//
+// Format into Buffer, which holds Max characters including the terminator.
+// Supports %d %u %x %X %c %s %a and %%, with '-', '0', width and 'l'.
+//
+STATIC UINTN
+HostVSPrint( CHAR16 *Buffer,
+             UINTN Max,
+             CONST CHAR16 *Format,
+             va_list Marker )
+{
+    CHAR8  Digits[32];
+    UINTN  Index = 0;
+
+    while (*Format != L'\0') {
+        BOOLEAN LeftJustify = FALSE;
+        BOOLEAN ZeroPad = FALSE;
+        BOOLEAN Long = FALSE;
+        UINTN   Width = 0;
+        UINTN   Count = 0;
+        UINT64  Value;
+        BOOLEAN Negative = FALSE;
+        CONST CHAR16 *Wide = NULL;
+        CONST CHAR8  *Narrow = NULL;
+
+        if (*Format != L'%') {
+            Index = PutChar( Buffer, Max, Index, *Format++ );
+            continue;
+        }
+        Format++;
+
+        for (;; Format++) {
+            if (*Format == L'-') {
+                LeftJustify = TRUE;
+            } else if (*Format == L'0' && Width == 0) {
+                ZeroPad = TRUE;
+            } else {
+                break;
+            }
+        }
+        while (*Format >= L'0' && *Format <= L'9') {
+            Width = Width * 10 + (*Format++ - L'0');
+        }
+        if (*Format == L'l' || *Format == L'L') {
+            Long = TRUE;
+            Format++;
+        }
+
+        switch (*Format) {
+        case L'd':
+        case L'u':
+        case L'x':
+        case L'X':
+            if (*Format == L'd') {
+                INT64 Signed = Long ? va_arg( Marker, INT64 ) : va_arg( Marker, INT32 );
+                Negative = (Signed < 0);
+                Value = Negative ? (UINT64)-Signed : (UINT64)Signed;
+            } else {
+                Value = Long ? va_arg( Marker, UINT64 ) : va_arg( Marker, UINT32 );
+            }
+            if (*Format == L'x' || *Format == L'X') {
+                CONST CHAR8 *Hex = (*Format == L'x') ? "0123456789abcdef" : "0123456789ABCDEF";
+                do {
+                    Digits[Count++] = Hex[Value & 0xf];
+                    Value >>= 4;
+                } while (Value != 0);
+            } else {
+                do {
+                    Digits[Count++] = (CHAR8)('0' + Value % 10);
+                    Value /= 10;
+                } while (Value != 0);
+            }
+            if (Negative) {
+                if (ZeroPad) {
+                    Index = PutChar( Buffer, Max, Index, L'-' );
+                    Width = (Width > 0) ? Width - 1 : 0;
+                } else {
+                    Digits[Count++] = '-';
+                }
+            }
+            if (!LeftJustify) {
+                for (; Width > Count; Width--) {
+                    Index = PutChar( Buffer, Max, Index, ZeroPad ? L'0' : L' ' );
+                }
+            }
+            for (UINTN i = Count; i > 0; i--) {
+                Index = PutChar( Buffer, Max, Index, (CHAR16)Digits[i - 1] );
+            }
+            for (; LeftJustify && Width > Count; Width--) {
+                Index = PutChar( Buffer, Max, Index, L' ' );
+            }
+            break;
+        case L'c':
+            Index = PutChar( Buffer, Max, Index, (CHAR16)va_arg( Marker, int ) );
+            break;
+        case L's':
+        case L'a':
+            if (*Format == L's') {
+                Wide = va_arg( Marker, CONST CHAR16 * );
+                Count = (Wide != NULL) ? StrLen( Wide ) : 0;
+            } else {
+                Narrow = va_arg( Marker, CONST CHAR8 * );
+                Count = (Narrow != NULL) ? strlen( Narrow ) : 0;
+            }
+            for (; !LeftJustify && Width > Count; Width--) {
+                Index = PutChar( Buffer, Max, Index, L' ' );
+            }
+            for (UINTN i = 0; i < Count; i++) {
+                Index = PutChar( Buffer, Max, Index,
+                                 (Wide != NULL) ? Wide[i] : (CHAR16)(UINT8)Narrow[i] );
+            }
+            for (; LeftJustify && Width > Count; Width--) {
+                Index = PutChar( Buffer, Max, Index, L' ' );
+            }
+            break;
+        case L'%':
+            Index = PutChar( Buffer, Max, Index, L'%' );
+            break;
+        default:
+            fprintf( stderr, "shim: unsupported format specifier %%%c\n", (char)*Format );
+            abort();
+        }
+        if (*Format != L'\0') {
+            Format++;
+        }
+    }
+
+    if (Max > 0) {
+        Buffer[(Index < Max) ? Index : Max - 1] = L'\0';
+    }
+    return (Index < Max) ? Index : Max - 1;
+}
+
+
+UINTN EFIAPI
+Print( CONST CHAR16 *Format, ... )
+{
+    CHAR16  Buffer[PRINT_BUFFER_SIZE];
+    CHAR8   Line[PRINT_BUFFER_SIZE * 3];
+    UINTN   Length;
+    UINTN   Out = 0;
+    va_list Marker;
+
+    va_start( Marker, Format );
+    Length = HostVSPrint( Buffer, PRINT_BUFFER_SIZE, Format, Marker );
+    va_end( Marker );
+
+    if (mHostPrintQuiet) {
+        return Length;
+    }
+
+    // UTF-8, dropping the CR that UEFI consoles need before a LF
+    for (UINTN i = 0; i < Length; i++) {
+        CHAR16 Ch = Buffer[i];
+        if (Ch == L'\r') {
+            continue;
+        } else if (Ch < 0x80) {
+            Line[Out++] = (CHAR8)Ch;
+        } else if (Ch < 0x800) {
+            Line[Out++] = (CHAR8)(0xc0 | (Ch >> 6));
+            Line[Out++] = (CHAR8)(0x80 | (Ch & 0x3f));
+        } else {
+            Line[Out++] = (CHAR8)(0xe0 | (Ch >> 12));
+            Line[Out++] = (CHAR8)(0x80 | ((Ch >> 6) & 0x3f));
+            Line[Out++] = (CHAR8)(0x80 | (Ch & 0x3f));
+        }
+    }
+    fwrite( Line, 1, Out, stdout );
+
+    return Length;
+}
+
+
+UINTN EFIAPI
+UnicodeSPrint( CHAR16 *Buffer,
+               UINTN BufferSize,
+               CONST CHAR16 *Format, ... )
+{
+    UINTN   Length;
+    va_list Marker;
+
+    va_start( Marker, Format );
+    Length = HostVSPrint( Buffer, BufferSize / sizeof(CHAR16), Format, Marker );
+    va_end( Marker );
+
+    return Length;
+}
+
+
+UINTN EFIAPI
+StrLen( CONST CHAR16 *String )
+{
+    UINTN Length = 0;
+
+    while (String[Length] != L'\0') {
+        Length++;
+    }
+    return Length;
+}
+
+
+CHAR16 * EFIAPI
+StrCat( CHAR16 *Destination,
+        CONST CHAR16 *Source )
+{
+    CHAR16 *Dest = Destination + StrLen( Destination );
+
+    while ((*Dest++ = *Source++) != L'\0') {
+        ;
+    }
+    return Destination;
+}
+
+
+VOID * EFIAPI
+CopyMem( VOID *Destination,
+         CONST VOID *Source,
+         UINTN Length )
+{
+    return memmove( Destination, Source, Length );
+}
+
+
+VOID * EFIAPI
+SetMem( VOID *Buffer,
+        UINTN Length,
+        UINT8 Value )
+{
+    return memset( Buffer, Value, Length );
+}
+
+
+VOID * EFIAPI
+ZeroMem( VOID *Buffer,
+         UINTN Length )
+{
+    return memset( Buffer, 0, Length );
+}
+
+
+VOID * EFIAPI
+AllocatePool( UINTN AllocationSize )
+{
+    return malloc( AllocationSize );
+}
+
+
+VOID * EFIAPI
+AllocateZeroPool( UINTN AllocationSize )
+{
+    return calloc( 1, AllocationSize );
+}
+
+
+VOID * EFIAPI
+ReallocatePool( UINTN OldSize,
+                UINTN NewSize,
+                VOID *OldBuffer )
+{
+    // EDK2 copies MIN(OldSize, NewSize) into a fresh pool; realloc does too
+    return realloc( OldBuffer, NewSize );
+}
+
+
+VOID EFIAPI
+FreePool( VOID *Buffer )
+{
+    free( Buffer );
+}
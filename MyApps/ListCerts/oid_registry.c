@@ -106,12 +106,29 @@ Lookup_OID(const void *data, long datasize)
 }
 
 
+/*
+ * Return the printable name of a registered OID
+ * @oid: The OID as returned by Lookup_OID
+ *
+ * NULL is returned for OID__NR so that the caller can fall back to
+ * Sprint_OID.
+ */
+const CHAR16 *
+Lookup_OID_Name(enum OID oid)
+{
+    if (oid >= OID__NR)
+        return NULL;
+
+    return oid_name_table[oid];
+}
+
+
 /*
  * Print an Object Identifier into a buffer
  * @data: The encoded OID to print
  * @datasize: The size of the encoded OID
  * @buffer: The buffer to render into
- * @bufsize: The size of the buffer
+ * @bufsize: The size of the buffer in bytes
  *
  * The OID is rendered into the buffer in "a.b.c.d" format and the number of
  * bytes is returned.  -EBADMSG is returned if the data could not be intepreted
@@ -133,8 +150,8 @@ Sprint_OID(const void *data, long datasize, CHAR16 *buffer, long bufsize)
     UnicodeSPrint(buffer, (UINTN)bufsize, (CHAR16 *)L"%d.%d", n / 40, n % 40);
     ret = count = StrLen(buffer);
     buffer += count;
-    bufsize -= count;
-    if (bufsize == 0)
+    bufsize -= count * sizeof(CHAR16);
+    if (bufsize <= (long)sizeof(CHAR16))
         return -ENOBUFS;
 
     while (v < end) {
@@ -155,8 +172,8 @@ Sprint_OID(const void *data, long datasize, CHAR16 *buffer, long bufsize)
         UnicodeSPrint(buffer, (UINTN)bufsize, (CHAR16 *)L".%ld", num);
         ret += count = StrLen(buffer);
         buffer += count;
-        bufsize -= count;
-        if (bufsize == 0)
+        bufsize -= count * sizeof(CHAR16);
+        if (bufsize <= (long)sizeof(CHAR16))
             return -ENOBUFS;
     }
 
@@ -6,63 +6,73 @@ static const unsigned short oid_index[OID__NR + 1] = {
 	[OID_id_dsa_with_sha1] = 0,
 	[OID_id_dsa] = 7,
 	[OID_id_ecdsa_with_sha1] = 14,
-	[OID_id_ecPublicKey] = 21,
-	[OID_rsaEncryption] = 28,
-	[OID_md2WithRSAEncryption] = 37,
-	[OID_md3WithRSAEncryption] = 46,
-	[OID_md4WithRSAEncryption] = 55,
-	[OID_sha1WithRSAEncryption] = 64,
-	[OID_sha256WithRSAEncryption] = 73,
-	[OID_sha384WithRSAEncryption] = 82,
-	[OID_sha512WithRSAEncryption] = 91,
-	[OID_sha224WithRSAEncryption] = 100,
-	[OID_data] = 109,
-	[OID_signed_data] = 118,
-	[OID_email_address] = 127,
-	[OID_content_type] = 136,
-	[OID_messageDigest] = 145,
-	[OID_signingTime] = 154,
-	[OID_smimeCapabilites] = 163,
-	[OID_smimeAuthenticatedAttrs] = 172,
-	[OID_md2] = 183,
-	[OID_md4] = 191,
-	[OID_md5] = 199,
-	[OID_msOutlookExpress] = 207,
-	[OID_msEnrollCerttypeExtension] = 216,
-	[OID_msCertsrvCAVersion] = 225,
-	[OID_msCertsrvPreviousCertHash] = 234,
-	[OID_certAuthInfoAccess] = 243,
-	[OID_sha1] = 251,
-	[OID_commonName] = 256,
-	[OID_surname] = 259,
-	[OID_countryName] = 262,
-	[OID_locality] = 265,
-	[OID_stateOrProvinceName] = 268,
-	[OID_organizationName] = 271,
-	[OID_organizationUnitName] = 274,
-	[OID_title] = 277,
-	[OID_description] = 280,
-	[OID_name] = 283,
-	[OID_givenName] = 286,
-	[OID_initials] = 289,
-	[OID_generationalQualifier] = 292,
-	[OID_subjectKeyIdentifier] = 295,
-	[OID_keyUsage] = 298,
-	[OID_subjectAltName] = 301,
-	[OID_issuerAltName] = 304,
-	[OID_basicConstraints] = 307,
-	[OID_crlDistributionPoints] = 310,
-	[OID_certPolicies] = 313,
-	[OID_authorityKeyIdentifier] = 316,
-	[OID_extKeyUsage] = 319,
-	[OID__NR] = 322
+	[OID_id_ecdsa_with_sha256] = 21,
+	[OID_id_ecdsa_with_sha384] = 29,
+	[OID_id_ecdsa_with_sha512] = 37,
+	[OID_id_ecPublicKey] = 45,
+	[OID_id_prime256v1] = 52,
+	[OID_id_secp384r1] = 60,
+	[OID_rsaEncryption] = 65,
+	[OID_md2WithRSAEncryption] = 74,
+	[OID_md3WithRSAEncryption] = 83,
+	[OID_md4WithRSAEncryption] = 92,
+	[OID_sha1WithRSAEncryption] = 101,
+	[OID_sha256WithRSAEncryption] = 110,
+	[OID_sha384WithRSAEncryption] = 119,
+	[OID_sha512WithRSAEncryption] = 128,
+	[OID_sha224WithRSAEncryption] = 137,
+	[OID_data] = 146,
+	[OID_signed_data] = 155,
+	[OID_email_address] = 164,
+	[OID_content_type] = 173,
+	[OID_messageDigest] = 182,
+	[OID_signingTime] = 191,
+	[OID_smimeCapabilites] = 200,
+	[OID_smimeAuthenticatedAttrs] = 209,
+	[OID_md2] = 220,
+	[OID_md4] = 228,
+	[OID_md5] = 236,
+	[OID_msOutlookExpress] = 244,
+	[OID_msEnrollCerttypeExtension] = 253,
+	[OID_msCertsrvCAVersion] = 262,
+	[OID_msCertsrvPreviousCertHash] = 271,
+	[OID_certAuthInfoAccess] = 280,
+	[OID_sha1] = 288,
+	[OID_commonName] = 293,
+	[OID_surname] = 296,
+	[OID_countryName] = 299,
+	[OID_locality] = 302,
+	[OID_stateOrProvinceName] = 305,
+	[OID_organizationName] = 308,
+	[OID_organizationUnitName] = 311,
+	[OID_title] = 314,
+	[OID_description] = 317,
+	[OID_name] = 320,
+	[OID_givenName] = 323,
+	[OID_initials] = 326,
+	[OID_generationalQualifier] = 329,
+	[OID_subjectKeyIdentifier] = 332,
+	[OID_keyUsage] = 335,
+	[OID_subjectAltName] = 338,
+	[OID_issuerAltName] = 341,
+	[OID_basicConstraints] = 344,
+	[OID_crlDistributionPoints] = 347,
+	[OID_certPolicies] = 350,
+	[OID_authorityKeyIdentifier] = 353,
+	[OID_extKeyUsage] = 356,
+	[OID__NR] = 359
 };
 
-static const unsigned char oid_data[322] = {
+static const unsigned char oid_data[359] = {
 	42, 134, 72, 206, 46, 4, 3, 	// id_dsa_with_sha1
 	42, 134, 72, 206, 56, 4, 1, 	// id_dsa
 	42, 134, 72, 206, 61, 4, 1, 	// id_ecdsa_with_sha1
+	42, 134, 72, 206, 61, 4, 3, 2, 	// id_ecdsa_with_sha256
+	42, 134, 72, 206, 61, 4, 3, 3, 	// id_ecdsa_with_sha384
+	42, 134, 72, 206, 61, 4, 3, 4, 	// id_ecdsa_with_sha512
 	42, 134, 72, 206, 61, 2, 1, 	// id_ecPublicKey
+	42, 134, 72, 206, 61, 3, 1, 7, 	// id_prime256v1
+	43, 129, 4, 0, 34, 	// id_secp384r1
 	42, 134, 72, 134, 247, 13, 1, 1, 1, 	// rsaEncryption
 	42, 134, 72, 134, 247, 13, 1, 1, 2, 	// md2WithRSAEncryption
 	42, 134, 72, 134, 247, 13, 1, 1, 3, 	// md3WithRSAEncryption
@@ -118,55 +128,120 @@ static const struct {
 	enum OID oid : 8;
 } oid_search_table[OID__NR] = {
 	[  0] = {  10, OID_title                               }, // 55040c
-	[  1] = {  23, OID_issuerAltName                       }, // 551d12
-	[  2] = {  23, OID_initials                            }, // 55042b
-	[  3] = {  29, OID_md2WithRSAEncryption                }, // 2a864886f70d010102
-	[  4] = {  30, OID_md2                                 }, // 2a864886f70d0202
-	[  5] = {  32, OID_id_dsa_with_sha1                    }, // 2a8648ce2e0403
-	[  6] = {  35, OID_content_type                        }, // 2a864886f70d010903
-	[  7] = {  35, OID_sha256WithRSAEncryption             }, // 2a864886f70d01010b
-	[  8] = {  36, OID_authorityKeyIdentifier              }, // 551d23
-	[  9] = {  37, OID_description                         }, // 55040d
-	[ 10] = {  43, OID_id_dsa                              }, // 2a8648ce380401
-	[ 11] = {  54, OID_basicConstraints                    }, // 551d13
-	[ 12] = {  54, OID_generationalQualifier               }, // 55042c
-	[ 13] = {  60, OID_md3WithRSAEncryption                }, // 2a864886f70d010103
-	[ 14] = {  64, OID_signed_data                         }, // 2a864886f70d010702
-	[ 15] = {  77, OID_countryName                         }, // 550406
-	[ 16] = {  77, OID_id_ecdsa_with_sha1                  }, // 2a8648ce3d0401
-	[ 17] = {  85, OID_smimeCapabilites                    }, // 2a864886f70d01090f
-	[ 18] = {  87, OID_sha1                                }, // 2b0e03021a
-	[ 19] = {  97, OID_email_address                       }, // 2a864886f70d010901
-	[ 20] = { 106, OID_extKeyUsage                         }, // 551d25
-	[ 21] = { 110, OID_locality                            }, // 550407
-	[ 22] = { 126, OID_rsaEncryption                       }, // 2a864886f70d010101
-	[ 23] = { 132, OID_smimeAuthenticatedAttrs             }, // 2a864886f70d010910020b
-	[ 24] = { 142, OID_id_ecPublicKey                      }, // 2a8648ce3d0201
-	[ 25] = { 142, OID_sha224WithRSAEncryption             }, // 2a864886f70d01010e
-	[ 26] = { 143, OID_stateOrProvinceName                 }, // 550408
-	[ 27] = { 146, OID_subjectKeyIdentifier                }, // 551d0e
-	[ 28] = { 160, OID_data                                }, // 2a864886f70d010701
-	[ 29] = { 161, OID_crlDistributionPoints               }, // 551d1f
-	[ 30] = { 173, OID_msOutlookExpress                    }, // 2b0601040182371004
-	[ 31] = { 179, OID_keyUsage                            }, // 551d0f
-	[ 32] = { 195, OID_md4WithRSAEncryption                }, // 2a864886f70d010104
-	[ 33] = { 198, OID_certPolicies                        }, // 551d20
-	[ 34] = { 201, OID_organizationName                    }, // 55040a
-	[ 35] = { 204, OID_messageDigest                       }, // 2a864886f70d010904
-	[ 36] = { 204, OID_sha384WithRSAEncryption             }, // 2a864886f70d01010c
-	[ 37] = { 206, OID_msCertsrvPreviousCertHash           }, // 2b0601040182371502
-	[ 38] = { 212, OID_name                                }, // 550429
-	[ 39] = { 213, OID_commonName                          }, // 550403
-	[ 40] = { 220, OID_md4                                 }, // 2a864886f70d0204
-	[ 41] = { 226, OID_sha1WithRSAEncryption               }, // 2a864886f70d010105
-	[ 42] = { 227, OID_md5                                 }, // 2a864886f70d0205
-	[ 43] = { 228, OID_certAuthInfoAccess                  }, // 2b06010505070101
-	[ 44] = { 234, OID_organizationUnitName                }, // 55040b
-	[ 45] = { 237, OID_signingTime                         }, // 2a864886f70d010905
-	[ 46] = { 237, OID_sha512WithRSAEncryption             }, // 2a864886f70d01010d
-	[ 47] = { 239, OID_msCertsrvCAVersion                  }, // 2b0601040182371501
-	[ 48] = { 239, OID_msEnrollCerttypeExtension           }, // 2b0601040182371402
-	[ 49] = { 244, OID_surname                             }, // 550404
-	[ 50] = { 245, OID_subjectAltName                      }, // 551d11
-	[ 51] = { 245, OID_givenName                           }, // 55042a
+	[  1] = {  13, OID_id_secp384r1                        }, // 2b81040022
+	[  2] = {  23, OID_issuerAltName                       }, // 551d12
+	[  3] = {  23, OID_initials                            }, // 55042b
+	[  4] = {  29, OID_md2WithRSAEncryption                }, // 2a864886f70d010102
+	[  5] = {  30, OID_md2                                 }, // 2a864886f70d0202
+	[  6] = {  32, OID_id_dsa_with_sha1                    }, // 2a8648ce2e0403
+	[  7] = {  35, OID_content_type                        }, // 2a864886f70d010903
+	[  8] = {  35, OID_sha256WithRSAEncryption             }, // 2a864886f70d01010b
+	[  9] = {  36, OID_authorityKeyIdentifier              }, // 551d23
+	[ 10] = {  37, OID_description                         }, // 55040d
+	[ 11] = {  43, OID_id_dsa                              }, // 2a8648ce380401
+	[ 12] = {  54, OID_basicConstraints                    }, // 551d13
+	[ 13] = {  54, OID_generationalQualifier               }, // 55042c
+	[ 14] = {  60, OID_md3WithRSAEncryption                }, // 2a864886f70d010103
+	[ 15] = {  64, OID_signed_data                         }, // 2a864886f70d010702
+	[ 16] = {  77, OID_countryName                         }, // 550406
+	[ 17] = {  77, OID_id_ecdsa_with_sha1                  }, // 2a8648ce3d0401
+	[ 18] = {  85, OID_smimeCapabilites                    }, // 2a864886f70d01090f
+	[ 19] = {  87, OID_sha1                                }, // 2b0e03021a
+	[ 20] = {  97, OID_email_address                       }, // 2a864886f70d010901
+	[ 21] = { 106, OID_extKeyUsage                         }, // 551d25
+	[ 22] = { 110, OID_locality                            }, // 550407
+	[ 23] = { 126, OID_rsaEncryption                       }, // 2a864886f70d010101
+	[ 24] = { 132, OID_smimeAuthenticatedAttrs             }, // 2a864886f70d010910020b
+	[ 25] = { 142, OID_id_ecPublicKey                      }, // 2a8648ce3d0201
+	[ 26] = { 142, OID_sha224WithRSAEncryption             }, // 2a864886f70d01010e
+	[ 27] = { 143, OID_stateOrProvinceName                 }, // 550408
+	[ 28] = { 146, OID_subjectKeyIdentifier                }, // 551d0e
+	[ 29] = { 150, OID_id_ecdsa_with_sha512                }, // 2a8648ce3d040304
+	[ 30] = { 150, OID_id_prime256v1                       }, // 2a8648ce3d030107
+	[ 31] = { 160, OID_data                                }, // 2a864886f70d010701
+	[ 32] = { 161, OID_crlDistributionPoints               }, // 551d1f
+	[ 33] = { 173, OID_msOutlookExpress                    }, // 2b0601040182371004
+	[ 34] = { 179, OID_keyUsage                            }, // 551d0f
+	[ 35] = { 195, OID_md4WithRSAEncryption                }, // 2a864886f70d010104
+	[ 36] = { 198, OID_certPolicies                        }, // 551d20
+	[ 37] = { 201, OID_organizationName                    }, // 55040a
+	[ 38] = { 204, OID_messageDigest                       }, // 2a864886f70d010904
+	[ 39] = { 204, OID_sha384WithRSAEncryption             }, // 2a864886f70d01010c
+	[ 40] = { 206, OID_msCertsrvPreviousCertHash           }, // 2b0601040182371502
+	[ 41] = { 208, OID_id_ecdsa_with_sha256                }, // 2a8648ce3d040302
+	[ 42] = { 212, OID_name                                }, // 550429
+	[ 43] = { 213, OID_commonName                          }, // 550403
+	[ 44] = { 220, OID_md4                                 }, // 2a864886f70d0204
+	[ 45] = { 226, OID_sha1WithRSAEncryption               }, // 2a864886f70d010105
+	[ 46] = { 227, OID_md5                                 }, // 2a864886f70d0205
+	[ 47] = { 228, OID_certAuthInfoAccess                  }, // 2b06010505070101
+	[ 48] = { 234, OID_organizationUnitName                }, // 55040b
+	[ 49] = { 237, OID_signingTime                         }, // 2a864886f70d010905
+	[ 50] = { 237, OID_sha512WithRSAEncryption             }, // 2a864886f70d01010d
+	[ 51] = { 239, OID_msCertsrvCAVersion                  }, // 2b0601040182371501
+	[ 52] = { 239, OID_msEnrollCerttypeExtension           }, // 2b0601040182371402
+	[ 53] = { 244, OID_surname                             }, // 550404
+	[ 54] = { 245, OID_subjectAltName                      }, // 551d11
+	[ 55] = { 245, OID_givenName                           }, // 55042a
+	[ 56] = { 247, OID_id_ecdsa_with_sha384                }, // 2a8648ce3d040303
+};
+
+static const CHAR16 * const oid_name_table[OID__NR] = {
+	[OID_id_dsa_with_sha1] = L"id_dsa_with_sha1",
+	[OID_id_dsa] = L"id_dsa",
+	[OID_id_ecdsa_with_sha1] = L"id_ecdsa_with_sha1",
+	[OID_id_ecdsa_with_sha256] = L"id_ecdsa_with_sha256",
+	[OID_id_ecdsa_with_sha384] = L"id_ecdsa_with_sha384",
+	[OID_id_ecdsa_with_sha512] = L"id_ecdsa_with_sha512",
+	[OID_id_ecPublicKey] = L"id_ecPublicKey",
+	[OID_id_prime256v1] = L"id_prime256v1",
+	[OID_id_secp384r1] = L"id_secp384r1",
+	[OID_rsaEncryption] = L"rsaEncryption",
+	[OID_md2WithRSAEncryption] = L"md2WithRSAEncryption",
+	[OID_md3WithRSAEncryption] = L"md3WithRSAEncryption",
+	[OID_md4WithRSAEncryption] = L"md4WithRSAEncryption",
+	[OID_sha1WithRSAEncryption] = L"sha1WithRSAEncryption",
+	[OID_sha256WithRSAEncryption] = L"sha256WithRSAEncryption",
+	[OID_sha384WithRSAEncryption] = L"sha384WithRSAEncryption",
+	[OID_sha512WithRSAEncryption] = L"sha512WithRSAEncryption",
+	[OID_sha224WithRSAEncryption] = L"sha224WithRSAEncryption",
+	[OID_data] = L"data",
+	[OID_signed_data] = L"signed_data",
+	[OID_email_address] = L"emailAddress",
+	[OID_content_type] = L"content_type",
+	[OID_messageDigest] = L"messageDigest",
+	[OID_signingTime] = L"signingTime",
+	[OID_smimeCapabilites] = L"smimeCapabilites",
+	[OID_smimeAuthenticatedAttrs] = L"smimeAuthenticatedAttrs",
+	[OID_md2] = L"md2",
+	[OID_md4] = L"md4",
+	[OID_md5] = L"md5",
+	[OID_msOutlookExpress] = L"msOutlookExpress",
+	[OID_msEnrollCerttypeExtension] = L"msEnrollCertTypeExtension",
+	[OID_msCertsrvCAVersion] = L"msCertsrvCAVersion",
+	[OID_msCertsrvPreviousCertHash] = L"msCertsrvPreviousCertHash",
+	[OID_certAuthInfoAccess] = L"CertAuthInfoAccess",
+	[OID_sha1] = L"sha1",
+	[OID_commonName] = L"CN",
+	[OID_surname] = L"SN",
+	[OID_countryName] = L"C",
+	[OID_locality] = L"L",
+	[OID_stateOrProvinceName] = L"ST",
+	[OID_organizationName] = L"O",
+	[OID_organizationUnitName] = L"OU",
+	[OID_title] = L"title",
+	[OID_description] = L"description",
+	[OID_name] = L"name",
+	[OID_givenName] = L"GN",
+	[OID_initials] = L"initials",
+	[OID_generationalQualifier] = L"generationalQualifier",
+	[OID_subjectKeyIdentifier] = L"SubjectKeyIdentifier",
+	[OID_keyUsage] = L"KeyUsage",
+	[OID_subjectAltName] = L"SubjectAltName",
+	[OID_issuerAltName] = L"IssuerAltName",
+	[OID_basicConstraints] = L"BasicConstraints",
+	[OID_crlDistributionPoints] = L"CrlDistributionPoints",
+	[OID_certPolicies] = L"CertPolicies",
+	[OID_authorityKeyIdentifier] = L"AuthorityKeyIdentifier",
+	[OID_extKeyUsage] = L"ExtKeyUsage",
 };
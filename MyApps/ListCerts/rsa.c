@@ -0,0 +1,110 @@
+//
+//  Copyright (c) 2012-2019  Finnbarr P. Murphy.  All rights reserved.
+//
+//  RSASSA-PKCS1-v1_5 signature verification (RFC 8017)
+//
+//  License: BSD 2 clause License
+//
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include "bignum.h"
+#include "rsa.h"
+
+// DER encoded DigestInfo up to the digest itself, RFC 8017 section 9.2
+STATIC CONST UINT8 DigestInfoSha1[] = {
+    0x30, 0x21, 0x30, 0x09, 0x06, 0x05, 0x2b, 0x0e, 0x03, 0x02, 0x1a, 0x05, 0x00, 0x04, 0x14
+};
+STATIC CONST UINT8 DigestInfoSha256[] = {
+    0x30, 0x31, 0x30, 0x0d, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01, 0x65, 0x03, 0x04, 0x02, 0x01,
+    0x05, 0x00, 0x04, 0x20
+};
+STATIC CONST UINT8 DigestInfoSha384[] = {
+    0x30, 0x41, 0x30, 0x0d, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01, 0x65, 0x03, 0x04, 0x02, 0x02,
+    0x05, 0x00, 0x04, 0x30
+};
+STATIC CONST UINT8 DigestInfoSha512[] = {
+    0x30, 0x51, 0x30, 0x0d, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01, 0x65, 0x03, 0x04, 0x02, 0x03,
+    0x05, 0x00, 0x04, 0x40
+};
+
+
+EFI_STATUS
+RsaPkcs1Verify( CONST UINT8 *Modulus,
+                UINTN ModulusLen,
+                CONST UINT8 *Exponent,
+                UINTN ExponentLen,
+                CONST UINT8 *Digest,
+                UINTN DigestSize,
+                CONST UINT8 *Signature,
+                UINTN SignatureLen )
+{
+    BN_MONT     *Mont;
+    UINT32      S[BN_MAX_LIMBS];
+    UINT8       Em[BN_MAX_LIMBS * 4];
+    CONST UINT8 *Prefix;
+    UINTN       PrefixLen;
+    UINTN       k;
+    UINTN       Pad;
+    EFI_STATUS  Status = EFI_SECURITY_VIOLATION;
+
+    switch (DigestSize) {
+        case 20: Prefix = DigestInfoSha1;   PrefixLen = sizeof(DigestInfoSha1);   break;
+        case 32: Prefix = DigestInfoSha256; PrefixLen = sizeof(DigestInfoSha256); break;
+        case 48: Prefix = DigestInfoSha384; PrefixLen = sizeof(DigestInfoSha384); break;
+        case 64: Prefix = DigestInfoSha512; PrefixLen = sizeof(DigestInfoSha512); break;
+        default: return EFI_UNSUPPORTED;
+    }
+
+    // the context is a few KiB, too much for the stack alongside S and Em
+    Mont = AllocatePool( sizeof(BN_MONT) );
+    if (Mont == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+    }
+    if (!BnMontInit( Mont, Modulus, ModulusLen )) {
+        Status = EFI_UNSUPPORTED;
+        goto Done;
+    }
+
+    while (ModulusLen > 0 && *Modulus == 0) {
+        Modulus++;
+        ModulusLen--;
+    }
+    k = ModulusLen;
+    if (k < PrefixLen + DigestSize + 11) {
+        goto Done;
+    }
+
+    // s must be an integer below n: s^e mod n
+    if (!BnFromBytes( S, Mont->Limbs, Signature, SignatureLen ) ||
+        BnCmp( S, Mont->N, Mont->Limbs ) >= 0) {
+        goto Done;
+    }
+    BnToMont( Mont, S, S );
+    BnModExp( Mont, S, S, Exponent, ExponentLen );
+    BnFromMont( Mont, S, S );
+    BnToBytes( S, Mont->Limbs, Em, k );
+
+    // EM = 0x00 || 0x01 || PS (0xff...) || 0x00 || DigestInfo || Digest
+    Pad = k - PrefixLen - DigestSize - 3;
+    if (Em[0] != 0x00 || Em[1] != 0x01 || Em[2 + Pad] != 0x00) {
+        goto Done;
+    }
+    for (UINTN i = 0; i < Pad; i++) {
+        if (Em[2 + i] != 0xff) {
+            goto Done;
+        }
+    }
+    if (CompareMem( Em + 3 + Pad, Prefix, PrefixLen ) != 0 ||
+        CompareMem( Em + 3 + Pad + PrefixLen, Digest, DigestSize ) != 0) {
+        goto Done;
+    }
+    Status = EFI_SUCCESS;
+
+Done:
+    FreePool( Mont );
+    return Status;
+}
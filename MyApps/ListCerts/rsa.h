@@ -0,0 +1,27 @@
+//
+//  Copyright (c) 2012-2019  Finnbarr P. Murphy.  All rights reserved.
+//
+//  RSASSA-PKCS1-v1_5 signature verification (RFC 8017)
+//
+//  License: BSD 2 clause License
+//
+
+#ifndef _RSA_H
+#define _RSA_H
+
+//
+// Check Signature over a SHA-1, SHA-256, SHA-384 or SHA-512 Digest, the
+// algorithm being implied by DigestSize. Returns EFI_SECURITY_VIOLATION
+// if it does not verify and EFI_UNSUPPORTED for keys over BN_MAX_BITS.
+//
+EFI_STATUS
+RsaPkcs1Verify( CONST UINT8 *Modulus,
+                UINTN ModulusLen,
+                CONST UINT8 *Exponent,
+                UINTN ExponentLen,
+                CONST UINT8 *Digest,
+                UINTN DigestSize,
+                CONST UINT8 *Signature,
+                UINTN SignatureLen );
+
+#endif
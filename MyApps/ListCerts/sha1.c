@@ -0,0 +1,233 @@
+//
+//  Copyright (c) 2012-2019  Finnbarr P. Murphy.  All rights reserved.
+//
+//  SHA-1 message digest (FIPS 180-4)
+//
+//  Only used for certificate fingerprints. Uses the SHA extensions
+//  (SHA-NI) when CPUID reports them, otherwise a portable C block function.
+//
+//  License: BSD 2 clause License
+//
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+
+#if defined(MDE_CPU_X64) && defined(__GNUC__)
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <smmintrin.h>
+#define SHA_NI_BUILD
+
+// <shaintrin.h> can only be reached through <immintrin.h>, which brings in
+// the whole of the hosted intrinsics headers, so use the builtins directly
+#define SHA1_RNDS4(a, b, f)  ((__m128i)__builtin_ia32_sha1rnds4( (__v4si)(a), (__v4si)(b), (f) ))
+#define SHA1_NEXTE(a, b)     ((__m128i)__builtin_ia32_sha1nexte( (__v4si)(a), (__v4si)(b) ))
+#define SHA1_MSG1(a, b)      ((__m128i)__builtin_ia32_sha1msg1( (__v4si)(a), (__v4si)(b) ))
+#define SHA1_MSG2(a, b)      ((__m128i)__builtin_ia32_sha1msg2( (__v4si)(a), (__v4si)(b) ))
+#endif
+
+#include "sha1.h"
+#include "sha256.h"
+
+#define ROTL32(x, n)  (((x) << (n)) | ((x) >> (32 - (n))))
+
+typedef VOID (*SHA1_BLOCKS)( UINT32 *State, CONST UINT8 *Data, UINTN Blocks );
+
+STATIC SHA1_BLOCKS mSha1Blocks = NULL;
+
+
+STATIC
+VOID
+Sha1Transform( UINT32 *State,
+               CONST UINT8 *Block )
+{
+    UINT32 W[80];
+    UINT32 a, b, c, d, e, f, k, T;
+
+    for (int i = 0; i < 16; i++) {
+        W[i] = ((UINT32)Block[i * 4] << 24) | ((UINT32)Block[i * 4 + 1] << 16) |
+               ((UINT32)Block[i * 4 + 2] << 8) | (UINT32)Block[i * 4 + 3];
+    }
+    for (int i = 16; i < 80; i++) {
+        W[i] = ROTL32( W[i - 3] ^ W[i - 8] ^ W[i - 14] ^ W[i - 16], 1 );
+    }
+
+    a = State[0]; b = State[1]; c = State[2]; d = State[3]; e = State[4];
+
+    for (int i = 0; i < 80; i++) {
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5a827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ed9eba1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8f1bbcdc;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xca62c1d6;
+        }
+        T = ROTL32( a, 5 ) + f + e + k + W[i];
+        e = d; d = c; c = ROTL32( b, 30 ); b = a; a = T;
+    }
+
+    State[0] += a; State[1] += b; State[2] += c; State[3] += d; State[4] += e;
+}
+
+
+STATIC
+VOID
+Sha1BlocksC( UINT32 *State,
+             CONST UINT8 *Data,
+             UINTN Blocks )
+{
+    while (Blocks-- > 0) {
+        Sha1Transform( State, Data );
+        Data += SHA1_BLOCK_SIZE;
+    }
+}
+
+
+#ifdef SHA_NI_BUILD
+//
+// Twenty groups of four rounds; sha1nexte derives each group's E from the
+// ABCD saved before the previous group.
+//
+__attribute__((target("sha,sse4.1")))
+STATIC
+VOID
+Sha1BlocksNi( UINT32 *State,
+              CONST UINT8 *Data,
+              UINTN Blocks )
+{
+    CONST __m128i Mask = _mm_set_epi64x( 0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL );
+    __m128i Abcd, AbcdSave, E0, E0Save, E, Prev;
+    __m128i W[4];
+
+    Abcd = _mm_shuffle_epi32( _mm_loadu_si128( (CONST __m128i *)State ), 0x1b );
+    E0 = _mm_set_epi32( (INT32)State[4], 0, 0, 0 );
+
+    while (Blocks-- > 0) {
+        AbcdSave = Abcd;
+        E0Save = E0;
+
+        for (int i = 0; i < 4; i++) {
+            W[i] = _mm_shuffle_epi8( _mm_loadu_si128( (CONST __m128i *)(Data + i * 16) ), Mask );
+        }
+
+        Prev = E0;
+        for (int i = 0; i < 20; i++) {
+            E = (i == 0) ? _mm_add_epi32( E0, W[0] ) : SHA1_NEXTE( Prev, W[i & 3] );
+            Prev = Abcd;
+            switch (i / 5) {
+            case 0:  Abcd = SHA1_RNDS4( Abcd, E, 0 ); break;
+            case 1:  Abcd = SHA1_RNDS4( Abcd, E, 1 ); break;
+            case 2:  Abcd = SHA1_RNDS4( Abcd, E, 2 ); break;
+            default: Abcd = SHA1_RNDS4( Abcd, E, 3 ); break;
+            }
+
+            if (i < 16) {
+                W[i & 3] = SHA1_MSG2(
+                               _mm_xor_si128( SHA1_MSG1( W[i & 3], W[(i + 1) & 3] ), W[(i + 2) & 3] ),
+                               W[(i + 3) & 3] );
+            }
+        }
+
+        E0 = SHA1_NEXTE( Prev, E0Save );
+        Abcd = _mm_add_epi32( Abcd, AbcdSave );
+        Data += SHA1_BLOCK_SIZE;
+    }
+
+    _mm_storeu_si128( (__m128i *)State, _mm_shuffle_epi32( Abcd, 0x1b ) );
+    State[4] = (UINT32)_mm_extract_epi32( E0, 3 );
+}
+#endif
+
+
+VOID
+Sha1Reset( SHA1_CONTEXT *Ctx )
+{
+    Ctx->State[0] = 0x67452301;
+    Ctx->State[1] = 0xefcdab89;
+    Ctx->State[2] = 0x98badcfe;
+    Ctx->State[3] = 0x10325476;
+    Ctx->State[4] = 0xc3d2e1f0;
+    Ctx->Length = 0;
+    Ctx->BlockUsed = 0;
+
+    if (mSha1Blocks == NULL) {
+        mSha1Blocks = Sha1BlocksC;
+#ifdef SHA_NI_BUILD
+        if (ShaNiSupported()) {
+            mSha1Blocks = Sha1BlocksNi;
+        }
+#endif
+    }
+}
+
+
+VOID
+Sha1Input( SHA1_CONTEXT *Ctx,
+           CONST VOID *Data,
+           UINTN Len )
+{
+    CONST UINT8 *p = Data;
+    UINTN Count;
+
+    Ctx->Length += Len;
+
+    if (Ctx->BlockUsed > 0) {
+        Count = MIN( Len, SHA1_BLOCK_SIZE - Ctx->BlockUsed );
+        CopyMem( Ctx->Block + Ctx->BlockUsed, p, Count );
+        Ctx->BlockUsed += Count;
+        p += Count;
+        Len -= Count;
+        if (Ctx->BlockUsed < SHA1_BLOCK_SIZE) {
+            return;
+        }
+        mSha1Blocks( Ctx->State, Ctx->Block, 1 );
+        Ctx->BlockUsed = 0;
+    }
+
+    Count = Len / SHA1_BLOCK_SIZE;
+    if (Count > 0) {
+        mSha1Blocks( Ctx->State, p, Count );
+        p += Count * SHA1_BLOCK_SIZE;
+        Len -= Count * SHA1_BLOCK_SIZE;
+    }
+
+    if (Len > 0) {
+        CopyMem( Ctx->Block, p, Len );
+        Ctx->BlockUsed = Len;
+    }
+}
+
+
+VOID
+Sha1Result( SHA1_CONTEXT *Ctx,
+            UINT8 *Digest )
+{
+    UINT64 Bits = Ctx->Length * 8;
+
+    Ctx->Block[Ctx->BlockUsed++] = 0x80;
+    if (Ctx->BlockUsed > SHA1_BLOCK_SIZE - 8) {
+        ZeroMem( Ctx->Block + Ctx->BlockUsed, SHA1_BLOCK_SIZE - Ctx->BlockUsed );
+        mSha1Blocks( Ctx->State, Ctx->Block, 1 );
+        Ctx->BlockUsed = 0;
+    }
+    ZeroMem( Ctx->Block + Ctx->BlockUsed, SHA1_BLOCK_SIZE - 8 - Ctx->BlockUsed );
+
+    for (int i = 0; i < 8; i++) {
+        Ctx->Block[SHA1_BLOCK_SIZE - 1 - i] = (UINT8)(Bits >> (i * 8));
+    }
+    mSha1Blocks( Ctx->State, Ctx->Block, 1 );
+
+    for (int i = 0; i < 5; i++) {
+        Digest[i * 4]     = (UINT8)(Ctx->State[i] >> 24);
+        Digest[i * 4 + 1] = (UINT8)(Ctx->State[i] >> 16);
+        Digest[i * 4 + 2] = (UINT8)(Ctx->State[i] >> 8);
+        Digest[i * 4 + 3] = (UINT8)(Ctx->State[i]);
+    }
+}
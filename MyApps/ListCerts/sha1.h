@@ -0,0 +1,34 @@
+//
+//  Copyright (c) 2012-2019  Finnbarr P. Murphy.  All rights reserved.
+//
+//  SHA-1 message digest (FIPS 180-4)
+//
+//  License: BSD 2 clause License
+//
+
+#ifndef _SHA1_H
+#define _SHA1_H
+
+#define SHA1_DIGEST_SIZE  20
+#define SHA1_BLOCK_SIZE   64
+
+typedef struct {
+    UINT32  State[5];
+    UINT64  Length;                 // bytes hashed so far
+    UINT8   Block[SHA1_BLOCK_SIZE];
+    UINTN   BlockUsed;
+} SHA1_CONTEXT;
+
+VOID
+Sha1Reset( SHA1_CONTEXT *Ctx );
+
+VOID
+Sha1Input( SHA1_CONTEXT *Ctx,
+           CONST VOID *Data,
+           UINTN Len );
+
+VOID
+Sha1Result( SHA1_CONTEXT *Ctx,
+            UINT8 *Digest );
+
+#endif
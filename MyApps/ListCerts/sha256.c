@@ -0,0 +1,269 @@
+//
+//  Copyright (c) 2012-2019  Finnbarr P. Murphy.  All rights reserved.
+//
+//  SHA-256 message digest (FIPS 180-4)
+//
+//  Uses the SHA extensions (SHA-NI) when CPUID reports them, otherwise
+//  a portable C block function.
+//
+//  License: BSD 2 clause License
+//
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+
+#if defined(MDE_CPU_X64) && defined(__GNUC__)
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <smmintrin.h>
+#define SHA_NI_BUILD
+
+// <shaintrin.h> can only be reached through <immintrin.h>, which brings in
+// the whole of the hosted intrinsics headers, so use the builtins directly
+#define SHA256_RNDS2(a, b, k)  ((__m128i)__builtin_ia32_sha256rnds2( (__v4si)(a), (__v4si)(b), (__v4si)(k) ))
+#define SHA256_MSG1(a, b)      ((__m128i)__builtin_ia32_sha256msg1( (__v4si)(a), (__v4si)(b) ))
+#define SHA256_MSG2(a, b)      ((__m128i)__builtin_ia32_sha256msg2( (__v4si)(a), (__v4si)(b) ))
+#endif
+
+#include "sha256.h"
+
+#define ROTR32(x, n)  (((x) >> (n)) | ((x) << (32 - (n))))
+
+STATIC CONST UINT32 K256[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+
+typedef VOID (*SHA256_BLOCKS)( UINT32 *State, CONST UINT8 *Data, UINTN Blocks );
+
+STATIC SHA256_BLOCKS mSha256Blocks = NULL;
+
+
+STATIC
+VOID
+Sha256Transform( UINT32 *State,
+                 CONST UINT8 *Block )
+{
+    UINT32 W[64];
+    UINT32 a, b, c, d, e, f, g, h, T1, T2;
+
+    for (int i = 0; i < 16; i++) {
+        W[i] = ((UINT32)Block[i * 4] << 24) | ((UINT32)Block[i * 4 + 1] << 16) |
+               ((UINT32)Block[i * 4 + 2] << 8) | (UINT32)Block[i * 4 + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        W[i] = (ROTR32(W[i - 2], 17) ^ ROTR32(W[i - 2], 19) ^ (W[i - 2] >> 10)) + W[i - 7] +
+               (ROTR32(W[i - 15], 7) ^ ROTR32(W[i - 15], 18) ^ (W[i - 15] >> 3)) + W[i - 16];
+    }
+
+    a = State[0]; b = State[1]; c = State[2]; d = State[3];
+    e = State[4]; f = State[5]; g = State[6]; h = State[7];
+
+    for (int i = 0; i < 64; i++) {
+        T1 = h + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) + ((e & f) ^ (~e & g)) + K256[i] + W[i];
+        T2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + T1;
+        d = c; c = b; b = a; a = T1 + T2;
+    }
+
+    State[0] += a; State[1] += b; State[2] += c; State[3] += d;
+    State[4] += e; State[5] += f; State[6] += g; State[7] += h;
+}
+
+
+STATIC
+VOID
+Sha256BlocksC( UINT32 *State,
+               CONST UINT8 *Data,
+               UINTN Blocks )
+{
+    while (Blocks-- > 0) {
+        Sha256Transform( State, Data );
+        Data += SHA256_BLOCK_SIZE;
+    }
+}
+
+
+#ifdef SHA_NI_BUILD
+//
+// The state is kept as ABEF/CDGH for sha256rnds2. Each pass of the loop
+// does four rounds and, for the first twelve, schedules four words ahead.
+//
+__attribute__((target("sha,sse4.1")))
+STATIC
+VOID
+Sha256BlocksNi( UINT32 *State,
+                CONST UINT8 *Data,
+                UINTN Blocks )
+{
+    CONST __m128i Mask = _mm_set_epi64x( 0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL );
+    __m128i State0, State1, AbefSave, CdghSave, Tmp, Msg;
+    __m128i W[4];
+
+    Tmp = _mm_loadu_si128( (CONST __m128i *)&State[0] );
+    State1 = _mm_loadu_si128( (CONST __m128i *)&State[4] );
+    Tmp = _mm_shuffle_epi32( Tmp, 0xb1 );                    // CDAB
+    State1 = _mm_shuffle_epi32( State1, 0x1b );              // EFGH
+    State0 = _mm_alignr_epi8( Tmp, State1, 8 );              // ABEF
+    State1 = _mm_blend_epi16( State1, Tmp, 0xf0 );           // CDGH
+
+    while (Blocks-- > 0) {
+        AbefSave = State0;
+        CdghSave = State1;
+
+        for (int i = 0; i < 4; i++) {
+            W[i] = _mm_shuffle_epi8( _mm_loadu_si128( (CONST __m128i *)(Data + i * 16) ), Mask );
+        }
+
+        for (int i = 0; i < 16; i++) {
+            Msg = _mm_add_epi32( W[i & 3], _mm_loadu_si128( (CONST __m128i *)&K256[i * 4] ) );
+            State1 = SHA256_RNDS2( State1, State0, Msg );
+            Msg = _mm_shuffle_epi32( Msg, 0x0e );
+            State0 = SHA256_RNDS2( State0, State1, Msg );
+
+            if (i < 12) {
+                Tmp = SHA256_MSG1( W[i & 3], W[(i + 1) & 3] );
+                Tmp = _mm_add_epi32( Tmp, _mm_alignr_epi8( W[(i + 3) & 3], W[(i + 2) & 3], 4 ) );
+                W[i & 3] = SHA256_MSG2( Tmp, W[(i + 3) & 3] );
+            }
+        }
+
+        State0 = _mm_add_epi32( State0, AbefSave );
+        State1 = _mm_add_epi32( State1, CdghSave );
+        Data += SHA256_BLOCK_SIZE;
+    }
+
+    Tmp = _mm_shuffle_epi32( State0, 0x1b );                 // FEBA
+    State1 = _mm_shuffle_epi32( State1, 0xb1 );              // DCHG
+    State0 = _mm_blend_epi16( Tmp, State1, 0xf0 );           // DCBA
+    State1 = _mm_alignr_epi8( State1, Tmp, 8 );              // HGFE
+
+    _mm_storeu_si128( (__m128i *)&State[0], State0 );
+    _mm_storeu_si128( (__m128i *)&State[4], State1 );
+}
+#endif
+
+
+//
+// SHA-NI needs SSSE3 and SSE4.1 as well; CPUID.7.0:EBX[29] on its own is
+// not enough on some virtual CPUs
+//
+BOOLEAN
+ShaNiSupported( VOID )
+{
+#ifdef SHA_NI_BUILD
+    UINT32 MaxLeaf, Ebx, Ecx;
+
+    AsmCpuid( 0, &MaxLeaf, NULL, NULL, NULL );
+    if (MaxLeaf < 7) {
+        return FALSE;
+    }
+    AsmCpuid( 1, NULL, NULL, &Ecx, NULL );
+    if (!(Ecx & BIT9) || !(Ecx & BIT19)) {
+        return FALSE;
+    }
+    AsmCpuidEx( 7, 0, NULL, &Ebx, NULL, NULL );
+    return (Ebx & BIT29) ? TRUE : FALSE;
+#else
+    return FALSE;
+#endif
+}
+
+
+VOID
+Sha256Reset( SHA256_CONTEXT *Ctx )
+{
+    Ctx->State[0] = 0x6a09e667;
+    Ctx->State[1] = 0xbb67ae85;
+    Ctx->State[2] = 0x3c6ef372;
+    Ctx->State[3] = 0xa54ff53a;
+    Ctx->State[4] = 0x510e527f;
+    Ctx->State[5] = 0x9b05688c;
+    Ctx->State[6] = 0x1f83d9ab;
+    Ctx->State[7] = 0x5be0cd19;
+    Ctx->Length = 0;
+    Ctx->BlockUsed = 0;
+
+    if (mSha256Blocks == NULL) {
+        mSha256Blocks = Sha256BlocksC;
+#ifdef SHA_NI_BUILD
+        if (ShaNiSupported()) {
+            mSha256Blocks = Sha256BlocksNi;
+        }
+#endif
+    }
+}
+
+
+VOID
+Sha256Input( SHA256_CONTEXT *Ctx,
+             CONST VOID *Data,
+             UINTN Len )
+{
+    CONST UINT8 *p = Data;
+    UINTN Count;
+
+    Ctx->Length += Len;
+
+    if (Ctx->BlockUsed > 0) {
+        Count = MIN( Len, SHA256_BLOCK_SIZE - Ctx->BlockUsed );
+        CopyMem( Ctx->Block + Ctx->BlockUsed, p, Count );
+        Ctx->BlockUsed += Count;
+        p += Count;
+        Len -= Count;
+        if (Ctx->BlockUsed < SHA256_BLOCK_SIZE) {
+            return;
+        }
+        mSha256Blocks( Ctx->State, Ctx->Block, 1 );
+        Ctx->BlockUsed = 0;
+    }
+
+    // whole blocks straight from the caller's buffer
+    Count = Len / SHA256_BLOCK_SIZE;
+    if (Count > 0) {
+        mSha256Blocks( Ctx->State, p, Count );
+        p += Count * SHA256_BLOCK_SIZE;
+        Len -= Count * SHA256_BLOCK_SIZE;
+    }
+
+    if (Len > 0) {
+        CopyMem( Ctx->Block, p, Len );
+        Ctx->BlockUsed = Len;
+    }
+}
+
+
+VOID
+Sha256Result( SHA256_CONTEXT *Ctx,
+              UINT8 *Digest )
+{
+    UINT64 Bits = Ctx->Length * 8;
+
+    Ctx->Block[Ctx->BlockUsed++] = 0x80;
+    if (Ctx->BlockUsed > SHA256_BLOCK_SIZE - 8) {
+        ZeroMem( Ctx->Block + Ctx->BlockUsed, SHA256_BLOCK_SIZE - Ctx->BlockUsed );
+        mSha256Blocks( Ctx->State, Ctx->Block, 1 );
+        Ctx->BlockUsed = 0;
+    }
+    ZeroMem( Ctx->Block + Ctx->BlockUsed, SHA256_BLOCK_SIZE - 8 - Ctx->BlockUsed );
+
+    for (int i = 0; i < 8; i++) {
+        Ctx->Block[SHA256_BLOCK_SIZE - 1 - i] = (UINT8)(Bits >> (i * 8));
+    }
+    mSha256Blocks( Ctx->State, Ctx->Block, 1 );
+
+    for (int i = 0; i < 8; i++) {
+        Digest[i * 4]     = (UINT8)(Ctx->State[i] >> 24);
+        Digest[i * 4 + 1] = (UINT8)(Ctx->State[i] >> 16);
+        Digest[i * 4 + 2] = (UINT8)(Ctx->State[i] >> 8);
+        Digest[i * 4 + 3] = (UINT8)(Ctx->State[i]);
+    }
+}
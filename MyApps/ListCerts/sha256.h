@@ -0,0 +1,38 @@
+//
+//  Copyright (c) 2012-2019  Finnbarr P. Murphy.  All rights reserved.
+//
+//  SHA-256 message digest (FIPS 180-4)
+//
+//  License: BSD 2 clause License
+//
+
+#ifndef _SHA256_H
+#define _SHA256_H
+
+#define SHA256_DIGEST_SIZE  32
+#define SHA256_BLOCK_SIZE   64
+
+typedef struct {
+    UINT32  State[8];
+    UINT64  Length;                 // bytes hashed so far
+    UINT8   Block[SHA256_BLOCK_SIZE];
+    UINTN   BlockUsed;
+} SHA256_CONTEXT;
+
+// shared by the SHA-1 and SHA-256 cores
+BOOLEAN
+ShaNiSupported( VOID );
+
+VOID
+Sha256Reset( SHA256_CONTEXT *Ctx );
+
+VOID
+Sha256Input( SHA256_CONTEXT *Ctx,
+             CONST VOID *Data,
+             UINTN Len );
+
+VOID
+Sha256Result( SHA256_CONTEXT *Ctx,
+              UINT8 *Digest );
+
+#endif
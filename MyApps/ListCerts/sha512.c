@@ -0,0 +1,164 @@
+//
+//  Copyright (c) 2012-2019  Finnbarr P. Murphy.  All rights reserved.
+//
+//  SHA-384 and SHA-512 message digests (FIPS 180-4)
+//
+//  Only used to check certificate signatures, so there is no SIMD path.
+//
+//  License: BSD 2 clause License
+//
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+
+#include "sha512.h"
+
+#define ROTR64(x, n)  (((x) >> (n)) | ((x) << (64 - (n))))
+
+STATIC CONST UINT64 K512[80] = {
+    0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+    0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+    0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+    0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+    0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+    0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+    0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+    0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+    0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+    0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+    0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+    0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+    0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+    0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+    0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+    0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+    0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+    0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+    0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+    0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+
+STATIC
+VOID
+Sha512Transform( UINT64 *State,
+                 CONST UINT8 *Block )
+{
+    UINT64 W[80];
+    UINT64 a, b, c, d, e, f, g, h, T1, T2;
+
+    for (int i = 0; i < 16; i++) {
+        W[i] = 0;
+        for (int j = 0; j < 8; j++) {
+            W[i] = (W[i] << 8) | Block[i * 8 + j];
+        }
+    }
+    for (int i = 16; i < 80; i++) {
+        W[i] = (ROTR64(W[i - 2], 19) ^ ROTR64(W[i - 2], 61) ^ (W[i - 2] >> 6)) + W[i - 7] +
+               (ROTR64(W[i - 15], 1) ^ ROTR64(W[i - 15], 8) ^ (W[i - 15] >> 7)) + W[i - 16];
+    }
+
+    a = State[0]; b = State[1]; c = State[2]; d = State[3];
+    e = State[4]; f = State[5]; g = State[6]; h = State[7];
+
+    for (int i = 0; i < 80; i++) {
+        T1 = h + (ROTR64(e, 14) ^ ROTR64(e, 18) ^ ROTR64(e, 41)) + ((e & f) ^ (~e & g)) + K512[i] + W[i];
+        T2 = (ROTR64(a, 28) ^ ROTR64(a, 34) ^ ROTR64(a, 39)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + T1;
+        d = c; c = b; b = a; a = T1 + T2;
+    }
+
+    State[0] += a; State[1] += b; State[2] += c; State[3] += d;
+    State[4] += e; State[5] += f; State[6] += g; State[7] += h;
+}
+
+
+VOID
+Sha384Reset( SHA512_CONTEXT *Ctx )
+{
+    Ctx->State[0] = 0xcbbb9d5dc1059ed8ULL;
+    Ctx->State[1] = 0x629a292a367cd507ULL;
+    Ctx->State[2] = 0x9159015a3070dd17ULL;
+    Ctx->State[3] = 0x152fecd8f70e5939ULL;
+    Ctx->State[4] = 0x67332667ffc00b31ULL;
+    Ctx->State[5] = 0x8eb44a8768581511ULL;
+    Ctx->State[6] = 0xdb0c2e0d64f98fa7ULL;
+    Ctx->State[7] = 0x47b5481dbefa4fa4ULL;
+    Ctx->Length = 0;
+    Ctx->BlockUsed = 0;
+    Ctx->DigestSize = SHA384_DIGEST_SIZE;
+}
+
+
+VOID
+Sha512Reset( SHA512_CONTEXT *Ctx )
+{
+    Ctx->State[0] = 0x6a09e667f3bcc908ULL;
+    Ctx->State[1] = 0xbb67ae8584caa73bULL;
+    Ctx->State[2] = 0x3c6ef372fe94f82bULL;
+    Ctx->State[3] = 0xa54ff53a5f1d36f1ULL;
+    Ctx->State[4] = 0x510e527fade682d1ULL;
+    Ctx->State[5] = 0x9b05688c2b3e6c1fULL;
+    Ctx->State[6] = 0x1f83d9abfb41bd6bULL;
+    Ctx->State[7] = 0x5be0cd19137e2179ULL;
+    Ctx->Length = 0;
+    Ctx->BlockUsed = 0;
+    Ctx->DigestSize = SHA512_DIGEST_SIZE;
+}
+
+
+VOID
+Sha512Input( SHA512_CONTEXT *Ctx,
+             CONST VOID *Data,
+             UINTN Len )
+{
+    CONST UINT8 *p = Data;
+    UINTN Count;
+
+    Ctx->Length += Len;
+
+    while (Len > 0) {
+        if (Ctx->BlockUsed == 0 && Len >= SHA512_BLOCK_SIZE) {
+            Sha512Transform( Ctx->State, p );
+            p += SHA512_BLOCK_SIZE;
+            Len -= SHA512_BLOCK_SIZE;
+            continue;
+        }
+        Count = MIN( Len, SHA512_BLOCK_SIZE - Ctx->BlockUsed );
+        CopyMem( Ctx->Block + Ctx->BlockUsed, p, Count );
+        Ctx->BlockUsed += Count;
+        p += Count;
+        Len -= Count;
+        if (Ctx->BlockUsed == SHA512_BLOCK_SIZE) {
+            Sha512Transform( Ctx->State, Ctx->Block );
+            Ctx->BlockUsed = 0;
+        }
+    }
+}
+
+
+VOID
+Sha512Result( SHA512_CONTEXT *Ctx,
+              UINT8 *Digest )
+{
+    UINT64 Bits = Ctx->Length * 8;
+
+    // the length field is 128 bits; the upper half is always zero here
+    Ctx->Block[Ctx->BlockUsed++] = 0x80;
+    if (Ctx->BlockUsed > SHA512_BLOCK_SIZE - 16) {
+        ZeroMem( Ctx->Block + Ctx->BlockUsed, SHA512_BLOCK_SIZE - Ctx->BlockUsed );
+        Sha512Transform( Ctx->State, Ctx->Block );
+        Ctx->BlockUsed = 0;
+    }
+    ZeroMem( Ctx->Block + Ctx->BlockUsed, SHA512_BLOCK_SIZE - 8 - Ctx->BlockUsed );
+
+    for (int i = 0; i < 8; i++) {
+        Ctx->Block[SHA512_BLOCK_SIZE - 1 - i] = (UINT8)(Bits >> (i * 8));
+    }
+    Sha512Transform( Ctx->State, Ctx->Block );
+
+    for (UINTN i = 0; i < Ctx->DigestSize; i++) {
+        Digest[i] = (UINT8)(Ctx->State[i / 8] >> (56 - (i % 8) * 8));
+    }
+}
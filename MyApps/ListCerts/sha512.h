@@ -0,0 +1,40 @@
+//
+//  Copyright (c) 2012-2019  Finnbarr P. Murphy.  All rights reserved.
+//
+//  SHA-384 and SHA-512 message digests (FIPS 180-4)
+//
+//  License: BSD 2 clause License
+//
+
+#ifndef _SHA512_H
+#define _SHA512_H
+
+#define SHA384_DIGEST_SIZE  48
+#define SHA512_DIGEST_SIZE  64
+#define SHA512_BLOCK_SIZE   128
+
+typedef struct {
+    UINT64  State[8];
+    UINT64  Length;                 // bytes hashed so far
+    UINT8   Block[SHA512_BLOCK_SIZE];
+    UINTN   BlockUsed;
+    UINTN   DigestSize;             // SHA384_DIGEST_SIZE or SHA512_DIGEST_SIZE
+} SHA512_CONTEXT;
+
+VOID
+Sha384Reset( SHA512_CONTEXT *Ctx );
+
+VOID
+Sha512Reset( SHA512_CONTEXT *Ctx );
+
+VOID
+Sha512Input( SHA512_CONTEXT *Ctx,
+             CONST VOID *Data,
+             UINTN Len );
+
+// writes Ctx->DigestSize bytes
+VOID
+Sha512Result( SHA512_CONTEXT *Ctx,
+              UINT8 *Digest );
+
+#endif
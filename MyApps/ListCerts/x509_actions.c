@@ -0,0 +1,432 @@
+//
+//  Copyright (c) 2012-2019  Finnbarr P. Murphy.  All rights reserved.
+//
+//  Decoder actions for the x509 grammar and the text builder they fill in.
+//  Kept apart from ListCerts.c so the decoder also builds on the host.
+//
+//  License: BSD 2 clause License
+//
+
+#include <Uefi.h>
+
+#include <Library/UefiLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include "asn1.h"
+#include "oid_registry.h"
+#include "x509.h"
+#include "x509_actions.h"
+
+#define TEXT_INITIAL_SIZE   256       // characters
+#define TEXT_MAXIMUM_SIZE   16384
+#define TEXT_WRAP_COLUMN    90
+
+// text buffer allocations made while decoding, shown per certificate
+// with --stats
+UINTN mTextAllocations = 0;
+
+
+VOID
+TextInit( TEXT_BUILDER *Text )
+{
+    ZeroMem( Text, sizeof(TEXT_BUILDER) );
+    Text->WrapAt = TEXT_WRAP_COLUMN;
+}
+
+
+VOID
+TextFree( TEXT_BUILDER *Text )
+{
+    if (Text->Buffer != NULL) {
+        FreePool( Text->Buffer );
+    }
+    TextInit( Text );
+}
+
+
+VOID
+TextReset( TEXT_BUILDER *Text )
+{
+    Text->Length = 0;
+    Text->WrapAt = TEXT_WRAP_COLUMN;
+    if (Text->Buffer != NULL) {
+        Text->Buffer[0] = L'\0';
+    }
+}
+
+
+//
+// Make room for Count more characters, doubling the buffer as needed up to
+// TEXT_MAXIMUM_SIZE. Returns the number of characters that fit.
+//
+UINTN
+TextReserve( TEXT_BUILDER *Text,
+             UINTN Count )
+{
+    CHAR16 *NewBuffer;
+    UINTN NewCapacity;
+
+    if (Text->Length + Count < Text->Capacity) {
+        return Count;
+    }
+
+    NewCapacity = (Text->Capacity == 0) ? TEXT_INITIAL_SIZE : Text->Capacity;
+    while (NewCapacity <= Text->Length + Count && NewCapacity < TEXT_MAXIMUM_SIZE) {
+        NewCapacity *= 2;
+    }
+    if (NewCapacity > TEXT_MAXIMUM_SIZE) {
+        NewCapacity = TEXT_MAXIMUM_SIZE;
+    }
+
+    if (NewCapacity > Text->Capacity) {
+        NewBuffer = ReallocatePool( Text->Capacity * sizeof(CHAR16),
+                                    NewCapacity * sizeof(CHAR16),
+                                    Text->Buffer );
+        mTextAllocations++;
+        if (NewBuffer != NULL) {
+            Text->Buffer = NewBuffer;
+            Text->Capacity = NewCapacity;
+        }
+    }
+
+    if (Text->Capacity == 0) {
+        Text->Truncated = TRUE;
+        return 0;
+    }
+    if (Text->Length + Count >= Text->Capacity) {
+        Text->Truncated = TRUE;
+        return Text->Capacity - Text->Length - 1;
+    }
+
+    return Count;
+}
+
+
+VOID
+TextAppend( TEXT_BUILDER *Text,
+            CONST CHAR16 *Str )
+{
+    UINTN Count = StrLen( Str );
+
+    Count = TextReserve( Text, Count );
+    CopyMem( Text->Buffer + Text->Length, Str, Count * sizeof(CHAR16) );
+    Text->Length += Count;
+    if (Text->Buffer != NULL) {
+        Text->Buffer[Text->Length] = L'\0';
+    }
+}
+
+
+//
+// Append Len characters of an ASN.1 string value. The value is not NUL
+// terminated and is widened in place rather than through a pool copy.
+//
+VOID
+TextAppendAscii( TEXT_BUILDER *Text,
+                 CONST CHAR8 *Str,
+                 UINTN Len )
+{
+    Len = TextReserve( Text, Len );
+    for (UINTN i = 0; i < Len; i++) {
+        Text->Buffer[Text->Length++] = (CHAR16)(UINT8) Str[i];
+    }
+    if (Text->Buffer != NULL) {
+        Text->Buffer[Text->Length] = L'\0';
+    }
+}
+
+
+//
+// Print the field once, with its label, and start the next one
+//
+VOID
+TextFlush( TEXT_BUILDER *Text,
+           CONST CHAR16 *Label )
+{
+    Print(L"%s%s%s\n", Label, (Text->Length > 0) ? Text->Buffer : L"",
+          Text->Truncated ? L" ..." : L"");
+    TextReset( Text );
+    Text->Truncated = FALSE;
+}
+
+
+int 
+do_version( void *context, 
+            long state_index,
+            unsigned char tag,
+            const void *value, 
+            long vlen )
+{
+    int Version = *(const char *)value;
+
+    Print(L"  Version: %d (0x%02x) ", Version + 1, Version);
+
+    return 0;
+}
+
+
+int
+do_signature( void *context, 
+              long state_index,
+              unsigned char tag,
+              const void *value,
+              long vlen )
+{
+    TextFlush( context, L"  Signature Algorithm: " );
+
+    return 0;
+}
+
+
+int
+do_algorithm( void *context,
+              long state_index,
+              unsigned char tag,
+              const void *value, 
+              long vlen )
+{
+    TEXT_BUILDER *Text = context;
+    CONST CHAR16 *Name;
+    CHAR16 buffer[100];
+
+    Name = Lookup_OID_Name( Lookup_OID(value, vlen) );
+    if (Name != NULL) {
+        TextReset( Text );
+        TextAppend( Text, Name );
+    } else {
+        Sprint_OID(value, vlen, buffer, sizeof(buffer));
+        TextAppend( Text, L" (" );
+        TextAppend( Text, buffer );
+        TextAppend( Text, L")" );
+    }
+
+    return 0;
+}
+
+
+int 
+do_serialnumber( void *context, 
+                 long state_index,
+                 unsigned char tag,
+                 const void *value, 
+                 long vlen )
+{
+    char *p = (char *)value;
+
+    Print(L"  Serial Number: ");
+    if (vlen > 4) {
+        for (int i = 0; i < vlen; i++, p++) {
+            Print(L"%02x%c", (UINT8)*p, ((i+1 == vlen)?' ':':'));
+        }
+    }
+    Print(L"\n");
+
+    return 0;
+}
+
+
+int
+do_issuer( void *context,
+           long  state_index,
+           unsigned char tag,
+           const void *value,
+           long vlen )
+{
+    TextFlush( context, L"  Issuer:" );
+
+    return 0;
+}
+
+
+int
+do_subject( void *context,
+            long state_index,
+            unsigned char tag,
+            const void *value,
+            long vlen )
+{
+    TextFlush( context, L"  Subject:" );
+
+    return 0;
+}
+
+
+int
+do_attribute_type( void *context,
+                   long state_index,
+                   unsigned char tag,
+                   const void *value,
+                   long vlen )
+{
+    TEXT_BUILDER *Text = context;
+    CONST CHAR16 *Name;
+    CHAR16 buffer[60];
+
+    Name = Lookup_OID_Name( Lookup_OID(value, vlen) );
+    if (Name != NULL) {
+        TextAppend( Text, L" " );
+        TextAppend( Text, Name );
+        TextAppend( Text, L"=" );
+    } else {
+        Sprint_OID(value, vlen, buffer, sizeof(buffer));
+        TextAppend( Text, L" (" );
+        TextAppend( Text, buffer );
+        TextAppend( Text, L")" );
+    }
+
+    return 0;
+}
+
+
+int
+do_attribute_value( void *context,
+                    long state_index,
+                    unsigned char tag,
+                    const void *value,
+                    long vlen )
+{
+    TextAppendAscii( context, value, (UINTN)vlen );
+
+    return 0;
+}
+
+
+int
+do_extensions( void *context,
+               long state_index,
+               unsigned char tag,
+               const void *value,
+               long vlen )
+{
+    TextFlush( context, L"  Extensions:" );
+
+    return 0;
+}
+
+
+int
+do_extension_id( void *context, 
+                 long state_index,
+                 unsigned char tag,
+                 const void *value,
+                 long vlen )
+{
+    TEXT_BUILDER *Text = context;
+    CONST CHAR16 *Name;
+    CHAR16 buffer[60];
+
+    if (Text->Length > Text->WrapAt) {
+        // Not sure why a CR is now required in UDK2017.  Need to investigate
+        TextAppend( Text, L"\r\n             " );
+        Text->WrapAt = Text->Length + TEXT_WRAP_COLUMN;
+    }
+
+    Name = Lookup_OID_Name( Lookup_OID(value, vlen) );
+    if (Name != NULL) {
+        TextAppend( Text, L" " );
+        TextAppend( Text, Name );
+    } else {
+        Sprint_OID(value, vlen, buffer, sizeof(buffer));
+        TextAppend( Text, L" (" );
+        TextAppend( Text, buffer );
+        TextAppend( Text, L")" );
+    }
+
+    return 0;
+}
+
+
+//
+//  Yes, a hack but it works!
+//  UTCTime is YYMMDDHHMMSSZ and GeneralizedTime YYYYMMDDHHMMSSZ; never
+//  read past len for a malformed value.
+//
+char *
+make_utc_date_string( unsigned char tag,
+                      char *s,
+                      long len )
+{
+    static char buffer[50];
+    char  *d;
+
+    d = buffer;
+    if (tag == ASN1_GENTIM && len >= 14) {
+        *d++ = *s++;     /* year */
+        *d++ = *s++;
+        len -= 2;
+    } else if (len >= 12 && *s >= '5') {
+        *d++ = '1';      /* year, RFC 5280: UTCTime YY 50 to 99 is 19YY */
+        *d++ = '9';
+    } else {
+        *d++ = '2';      /* year */
+        *d++ = '0';
+    }
+    if (len < 12) {
+        return "(invalid date)";
+    }
+    *d++ = *s++;
+    *d++ = *s++;
+    *d++ = '-';
+    *d++ = *s++;     /* month */
+    *d++ = *s++;
+    *d++ = '-';
+    *d++ = *s++;     /* day */
+    *d++ = *s++;
+    *d++ = ' ';
+    *d++ = *s++;     /* hour */
+    *d++ = *s++;
+    *d++ = ':';
+    *d++ = *s++;     /* minute */
+    *d++ = *s++;
+    *d++ = ':';
+    *d++ = *s++;     /* second */
+    *d++ = *s;
+    *d++ = ' ';
+    *d++ = 'U';
+    *d++ = 'T';
+    *d++ = 'C';
+    *d = '\0';
+
+    return buffer;
+}
+
+
+int
+do_validity_not_before( void *context,
+                        long state_index,
+                        unsigned char tag,
+                        const void *value, 
+                        long vlen )
+{
+    Print(L"  Validity:  Not Before: %a", make_utc_date_string(tag, (char *)value, vlen));
+
+    return 0;
+}
+
+
+int
+do_validity_not_after( void *context,
+                       long state_index,
+                       unsigned char tag,
+                       const void *value,
+                       long vlen )
+{
+    Print(L"   Not After: %a\n", make_utc_date_string(tag, (char *)value, vlen));
+
+    return 0;
+}
+
+
+int
+do_subject_public_key_info( void *context, 
+                            long state_index,
+                            unsigned char tag,
+                            const void *value, 
+                            long vlen )
+{
+    TextFlush( context, L"  Subject Public Key Algorithm: " );
+
+    return 0;
+}
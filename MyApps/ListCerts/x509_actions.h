@@ -0,0 +1,32 @@
+//
+//  Copyright (c) 2012-2019  Finnbarr P. Murphy.  All rights reserved.
+//
+//  Text builder used as the x509 decoder context
+//
+//  License: BSD 2 clause License
+//
+
+#ifndef _X509_ACTIONS_H
+#define _X509_ACTIONS_H
+
+// Output text for one field, built up by the decoder actions. Passed as
+// the decoder context so that appends are O(1) and bounds checked.
+typedef struct {
+    CHAR16  *Buffer;
+    UINTN   Length;                 // excluding the terminator
+    UINTN   Capacity;               // including the terminator
+    UINTN   WrapAt;                 // wrap the extension list beyond this length
+    BOOLEAN Truncated;
+} TEXT_BUILDER;
+
+extern UINTN mTextAllocations;
+
+VOID  TextInit( TEXT_BUILDER *Text );
+VOID  TextFree( TEXT_BUILDER *Text );
+VOID  TextReset( TEXT_BUILDER *Text );
+UINTN TextReserve( TEXT_BUILDER *Text, UINTN Count );
+VOID  TextAppend( TEXT_BUILDER *Text, CONST CHAR16 *Str );
+VOID  TextAppendAscii( TEXT_BUILDER *Text, CONST CHAR8 *Str, UINTN Len );
+VOID  TextFlush( TEXT_BUILDER *Text, CONST CHAR16 *Label );
+
+#endif
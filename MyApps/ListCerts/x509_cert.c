@@ -0,0 +1,404 @@
+//
+//  Copyright (c) 2012-2019  Finnbarr P. Murphy.  All rights reserved.
+//
+//  The parts of an X.509 certificate needed to build and check chains
+//
+//  The x509 bytecode decoder only reports what ListCerts prints, not the
+//  signed bytes or the key, so this is a small strict DER walker instead.
+//
+//  License: BSD 2 clause License
+//
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+
+#include "asn1.h"
+#include "oid_registry.h"
+#include "sha1.h"
+#include "sha256.h"
+#include "sha512.h"
+#include "rsa.h"
+#include "ecdsa.h"
+#include "x509.h"
+#include "x509_actions.h"
+#include "x509_cert.h"
+
+#define DER_TAG(class, form, tag)   (UINT8)(((class) << 6) | ((form) << 5) | (tag))
+#define DER_SEQUENCE                DER_TAG(ASN1_UNIV, ASN1_CONS, ASN1_SEQ)
+#define DER_VERSION                 DER_TAG(ASN1_CONT, ASN1_CONS, 0)
+
+typedef struct {
+    UINT8       Tag;
+    CONST UINT8 *Header;            // start of the element
+    CONST UINT8 *Value;
+    UINTN       Len;                // of the value
+} DER_ELEMENT;
+
+
+//
+// Read the element at *Ptr and step over it. Only single octet tags and
+// definite lengths are accepted, as DER requires.
+//
+STATIC
+BOOLEAN
+DerNext( CONST UINT8 **Ptr,
+         CONST UINT8 *End,
+         DER_ELEMENT *Element )
+{
+    CONST UINT8 *p = *Ptr;
+    UINTN Len;
+
+    if (End - p < 2 || (p[0] & 0x1f) == 0x1f) {
+        return FALSE;
+    }
+    Element->Header = p;
+    Element->Tag = *p++;
+    Len = *p++;
+    if (Len & 0x80) {
+        UINTN n = Len & 0x7f;
+        if (n == 0 || n > 4 || (UINTN)(End - p) < n) {
+            return FALSE;
+        }
+        for (Len = 0; n > 0; n--) {
+            Len = (Len << 8) | *p++;
+        }
+    }
+    if ((UINTN)(End - p) < Len) {
+        return FALSE;
+    }
+    Element->Value = p;
+    Element->Len = Len;
+    *Ptr = p + Len;
+
+    return TRUE;
+}
+
+
+STATIC
+BOOLEAN
+DerExpect( CONST UINT8 **Ptr,
+           CONST UINT8 *End,
+           UINT8 Tag,
+           DER_ELEMENT *Element )
+{
+    return DerNext( Ptr, End, Element ) && Element->Tag == Tag;
+}
+
+
+//
+// AlgorithmIdentifier: the algorithm and, for EC keys, the curve
+//
+STATIC
+BOOLEAN
+DerAlgorithm( CONST DER_ELEMENT *Seq,
+              enum OID *Algorithm,
+              enum OID *Parameter )
+{
+    CONST UINT8 *p = Seq->Value;
+    CONST UINT8 *End = Seq->Value + Seq->Len;
+    DER_ELEMENT Oid;
+
+    if (!DerExpect( &p, End, ASN1_OID, &Oid )) {
+        return FALSE;
+    }
+    *Algorithm = Lookup_OID( Oid.Value, Oid.Len );
+    if (Parameter != NULL) {
+        *Parameter = OID__NR;
+        if (p < End && DerNext( &p, End, &Oid ) && Oid.Tag == ASN1_OID) {
+            *Parameter = Lookup_OID( Oid.Value, Oid.Len );
+        }
+    }
+    return TRUE;
+}
+
+
+//
+// UTCTime or GeneralizedTime as YYYYMMDDHHMMSS. UTCTime years from 50
+// are 19xx (RFC 5280 section 4.1.2.5.1).
+//
+STATIC
+BOOLEAN
+DerTime( CONST DER_ELEMENT *Time,
+         CHAR8 *Out )
+{
+    CONST UINT8 *v = Time->Value;
+    UINTN Digits;
+
+    if (Time->Tag == ASN1_UNITIM && Time->Len >= 12) {
+        Out[0] = (v[0] < '5') ? '2' : '1';
+        Out[1] = (v[0] < '5') ? '0' : '9';
+        Digits = 12;
+        CopyMem( Out + 2, v, Digits );
+    } else if (Time->Tag == ASN1_GENTIM && Time->Len >= 14) {
+        Digits = 14;
+        CopyMem( Out, v, Digits );
+    } else {
+        return FALSE;
+    }
+    Out[14] = '\0';
+
+    for (UINTN i = 0; i < 14; i++) {
+        if (Out[i] < '0' || Out[i] > '9') {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+
+STATIC
+BOOLEAN
+DerBitString( CONST DER_ELEMENT *Bits,
+              CONST UINT8 **Value,
+              UINTN *Len )
+{
+    // keys and signatures are whole octets
+    if (Bits->Tag != ASN1_BTS || Bits->Len < 1 || Bits->Value[0] != 0) {
+        return FALSE;
+    }
+    *Value = Bits->Value + 1;
+    *Len = Bits->Len - 1;
+    return TRUE;
+}
+
+
+EFI_STATUS
+X509ParseCertificate( CONST UINT8 *Data,
+                      UINTN Len,
+                      X509_CERT *Cert )
+{
+    CONST UINT8 *p = Data;
+    CONST UINT8 *End = Data + Len;
+    CONST UINT8 *TbsEnd;
+    DER_ELEMENT Outer, Tbs, Element, Spki, Validity;
+    enum OID    TbsAlgorithm;
+
+    ZeroMem( Cert, sizeof(X509_CERT) );
+
+    if (!DerExpect( &p, End, DER_SEQUENCE, &Outer )) {
+        return EFI_INVALID_PARAMETER;
+    }
+    p = Outer.Value;
+    End = Outer.Value + Outer.Len;
+
+    // tbsCertificate
+    if (!DerExpect( &p, End, DER_SEQUENCE, &Tbs )) {
+        return EFI_INVALID_PARAMETER;
+    }
+    Cert->Tbs = Tbs.Header;
+    Cert->TbsLen = p - Tbs.Header;
+
+    // signatureAlgorithm and signatureValue
+    if (!DerExpect( &p, End, DER_SEQUENCE, &Element ) ||
+        !DerAlgorithm( &Element, &Cert->SigAlgorithm, NULL ) ||
+        !DerNext( &p, End, &Element ) ||
+        !DerBitString( &Element, &Cert->Signature, &Cert->SignatureLen )) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    p = Tbs.Value;
+    TbsEnd = Tbs.Value + Tbs.Len;
+
+    // version (optional), serialNumber, signature
+    if (!DerNext( &p, TbsEnd, &Element )) {
+        return EFI_INVALID_PARAMETER;
+    }
+    if (Element.Tag == DER_VERSION && !DerNext( &p, TbsEnd, &Element )) {
+        return EFI_INVALID_PARAMETER;
+    }
+    if (Element.Tag != ASN1_INT ||
+        !DerExpect( &p, TbsEnd, DER_SEQUENCE, &Element ) ||
+        !DerAlgorithm( &Element, &TbsAlgorithm, NULL ) ||
+        TbsAlgorithm != Cert->SigAlgorithm) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    // issuer, validity, subject
+    if (!DerExpect( &p, TbsEnd, DER_SEQUENCE, &Element )) {
+        return EFI_INVALID_PARAMETER;
+    }
+    Cert->Issuer = Element.Header;
+    Cert->IssuerLen = p - Element.Header;
+
+    if (!DerExpect( &p, TbsEnd, DER_SEQUENCE, &Validity )) {
+        return EFI_INVALID_PARAMETER;
+    }
+    {
+        CONST UINT8 *v = Validity.Value;
+        CONST UINT8 *VEnd = Validity.Value + Validity.Len;
+
+        if (!DerNext( &v, VEnd, &Element ) || !DerTime( &Element, Cert->NotBefore ) ||
+            !DerNext( &v, VEnd, &Element ) || !DerTime( &Element, Cert->NotAfter )) {
+            return EFI_INVALID_PARAMETER;
+        }
+    }
+
+    if (!DerExpect( &p, TbsEnd, DER_SEQUENCE, &Element )) {
+        return EFI_INVALID_PARAMETER;
+    }
+    Cert->Subject = Element.Header;
+    Cert->SubjectLen = p - Element.Header;
+
+    // subjectPublicKeyInfo
+    if (!DerExpect( &p, TbsEnd, DER_SEQUENCE, &Spki )) {
+        return EFI_INVALID_PARAMETER;
+    }
+    p = Spki.Value;
+    if (!DerExpect( &p, Spki.Value + Spki.Len, DER_SEQUENCE, &Element ) ||
+        !DerAlgorithm( &Element, &Cert->KeyAlgorithm, &Cert->KeyCurve ) ||
+        !DerNext( &p, Spki.Value + Spki.Len, &Element ) ||
+        !DerBitString( &Element, &Cert->PublicKey, &Cert->PublicKeyLen )) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    return EFI_SUCCESS;
+}
+
+
+//
+// Digest of the signed part of Cert with the hash named by its signature
+// algorithm. Returns the digest size, or 0 if the algorithm is unknown.
+//
+STATIC
+UINTN
+HashTbs( CONST X509_CERT *Cert,
+         UINT8 *Digest )
+{
+    SHA1_CONTEXT   Sha1;
+    SHA256_CONTEXT Sha256;
+    SHA512_CONTEXT Sha512;
+
+    switch (Cert->SigAlgorithm) {
+        case OID_sha1WithRSAEncryption:
+        case OID_id_ecdsa_with_sha1:
+            Sha1Reset( &Sha1 );
+            Sha1Input( &Sha1, Cert->Tbs, Cert->TbsLen );
+            Sha1Result( &Sha1, Digest );
+            return SHA1_DIGEST_SIZE;
+        case OID_sha256WithRSAEncryption:
+        case OID_id_ecdsa_with_sha256:
+            Sha256Reset( &Sha256 );
+            Sha256Input( &Sha256, Cert->Tbs, Cert->TbsLen );
+            Sha256Result( &Sha256, Digest );
+            return SHA256_DIGEST_SIZE;
+        case OID_sha384WithRSAEncryption:
+        case OID_id_ecdsa_with_sha384:
+            Sha384Reset( &Sha512 );
+            break;
+        case OID_sha512WithRSAEncryption:
+        case OID_id_ecdsa_with_sha512:
+            Sha512Reset( &Sha512 );
+            break;
+        default:
+            return 0;
+    }
+    Sha512Input( &Sha512, Cert->Tbs, Cert->TbsLen );
+    Sha512Result( &Sha512, Digest );
+    return Sha512.DigestSize;
+}
+
+
+STATIC
+BOOLEAN
+IsEcdsaAlgorithm( enum OID Algorithm )
+{
+    return Algorithm == OID_id_ecdsa_with_sha1 || Algorithm == OID_id_ecdsa_with_sha256 ||
+           Algorithm == OID_id_ecdsa_with_sha384 || Algorithm == OID_id_ecdsa_with_sha512;
+}
+
+
+EFI_STATUS
+X509CheckSignature( CONST X509_CERT *Cert,
+                    CONST X509_CERT *Issuer )
+{
+    UINT8       Digest[SHA512_DIGEST_SIZE];
+    UINTN       DigestSize;
+    CONST UINT8 *p;
+    CONST UINT8 *End;
+    DER_ELEMENT Seq, First, Second;
+
+    DigestSize = HashTbs( Cert, Digest );
+    if (DigestSize == 0) {
+        return EFI_UNSUPPORTED;
+    }
+
+    // RSAPublicKey or ECDSA-Sig-Value: SEQUENCE { INTEGER, INTEGER }
+    if (Issuer->KeyAlgorithm == OID_rsaEncryption) {
+        if (IsEcdsaAlgorithm( Cert->SigAlgorithm )) {
+            return EFI_SECURITY_VIOLATION;
+        }
+        p = Issuer->PublicKey;
+        End = p + Issuer->PublicKeyLen;
+        if (!DerExpect( &p, End, DER_SEQUENCE, &Seq )) {
+            return EFI_UNSUPPORTED;
+        }
+        p = Seq.Value;
+        End = Seq.Value + Seq.Len;
+        if (!DerExpect( &p, End, ASN1_INT, &First ) || !DerExpect( &p, End, ASN1_INT, &Second )) {
+            return EFI_UNSUPPORTED;
+        }
+        return RsaPkcs1Verify( First.Value, First.Len, Second.Value, Second.Len,
+                               Digest, DigestSize, Cert->Signature, Cert->SignatureLen );
+    }
+
+    if (Issuer->KeyAlgorithm == OID_id_ecPublicKey) {
+        if (!IsEcdsaAlgorithm( Cert->SigAlgorithm )) {
+            return EFI_SECURITY_VIOLATION;
+        }
+        if (Issuer->KeyCurve != OID_id_prime256v1 && Issuer->KeyCurve != OID_id_secp384r1) {
+            return EFI_UNSUPPORTED;
+        }
+        p = Cert->Signature;
+        End = p + Cert->SignatureLen;
+        if (!DerExpect( &p, End, DER_SEQUENCE, &Seq )) {
+            return EFI_SECURITY_VIOLATION;
+        }
+        p = Seq.Value;
+        End = Seq.Value + Seq.Len;
+        if (!DerExpect( &p, End, ASN1_INT, &First ) || !DerExpect( &p, End, ASN1_INT, &Second )) {
+            return EFI_SECURITY_VIOLATION;
+        }
+        return EcdsaVerify( (Issuer->KeyCurve == OID_id_secp384r1) ? EcCurveP384 : EcCurveP256,
+                            Issuer->PublicKey, Issuer->PublicKeyLen, Digest, DigestSize,
+                            First.Value, First.Len, Second.Value, Second.Len );
+    }
+
+    return EFI_UNSUPPORTED;
+}
+
+
+//
+// Append a Name as " CN=... O=..." through the decoder's own actions, so
+// that it reads the same as the Issuer and Subject lines of a listing
+//
+VOID
+X509AppendName( TEXT_BUILDER *Text,
+                CONST UINT8 *Name,
+                UINTN Len )
+{
+    CONST UINT8 *p = Name;
+    CONST UINT8 *End = Name + Len;
+    DER_ELEMENT Seq, Set, Attribute, Type, Value;
+
+    if (!DerExpect( &p, End, DER_SEQUENCE, &Seq )) {
+        return;
+    }
+    p = Seq.Value;
+    End = Seq.Value + Seq.Len;
+    while (p < End && DerExpect( &p, End, DER_TAG(ASN1_UNIV, ASN1_CONS, ASN1_SET), &Set )) {
+        CONST UINT8 *a = Set.Value;
+        CONST UINT8 *SetEnd = Set.Value + Set.Len;
+
+        while (a < SetEnd && DerExpect( &a, SetEnd, DER_SEQUENCE, &Attribute )) {
+            CONST UINT8 *t = Attribute.Value;
+            CONST UINT8 *AttributeEnd = Attribute.Value + Attribute.Len;
+
+            if (DerExpect( &t, AttributeEnd, ASN1_OID, &Type ) &&
+                DerNext( &t, AttributeEnd, &Value )) {
+                do_attribute_type( Text, 0, Type.Tag, Type.Value, (long)Type.Len );
+                do_attribute_value( Text, 0, Value.Tag, Value.Value, (long)Value.Len );
+            }
+        }
+    }
+}
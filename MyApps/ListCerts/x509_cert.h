@@ -0,0 +1,55 @@
+//
+//  Copyright (c) 2012-2019  Finnbarr P. Murphy.  All rights reserved.
+//
+//  The parts of an X.509 certificate needed to build and check chains
+//
+//  Include x509_actions.h first.
+//
+//  License: BSD 2 clause License
+//
+
+#ifndef _X509_CERT_H
+#define _X509_CERT_H
+
+#define X509_TIME_SIZE      15        // YYYYMMDDHHMMSS and a NUL
+
+// Everything points into the DER the certificate was parsed from
+typedef struct {
+    CONST UINT8 *Tbs;               // tbsCertificate with its header, as signed
+    UINTN       TbsLen;
+    CONST UINT8 *Issuer;            // Name with its header, compared bytewise
+    UINTN       IssuerLen;
+    CONST UINT8 *Subject;
+    UINTN       SubjectLen;
+    CHAR8       NotBefore[X509_TIME_SIZE];   // compare with AsciiStrCmp
+    CHAR8       NotAfter[X509_TIME_SIZE];
+    enum OID    SigAlgorithm;
+    CONST UINT8 *Signature;         // BIT STRING value less the unused bits octet
+    UINTN       SignatureLen;
+    enum OID    KeyAlgorithm;
+    enum OID    KeyCurve;           // namedCurve parameter of an EC key
+    CONST UINT8 *PublicKey;         // BIT STRING value less the unused bits octet
+    UINTN       PublicKeyLen;
+} X509_CERT;
+
+// EFI_INVALID_PARAMETER unless Data is a well formed DER certificate
+EFI_STATUS
+X509ParseCertificate( CONST UINT8 *Data,
+                      UINTN Len,
+                      X509_CERT *Cert );
+
+//
+// Check the signature on Cert with the public key of Issuer. Returns
+// EFI_SECURITY_VIOLATION if it does not verify and EFI_UNSUPPORTED for an
+// algorithm, curve or key size that cannot be checked.
+//
+EFI_STATUS
+X509CheckSignature( CONST X509_CERT *Cert,
+                    CONST X509_CERT *Issuer );
+
+VOID
+X509AppendName( TEXT_BUILDER *Text,
+                CONST UINT8 *Name,
+                UINTN Len );
+
+#endif
@@ -32,6 +32,9 @@
 #include <Guid/Acpi.h>
 
 #include <IndustryStandard/Bmp.h>
+
+#include <Library/BmpDecodeLib.h>
+#include <Library/TscTimerLib.h>
 #include <IndustryStandard/Acpi61.h>
 
 #define UTILITY_VERSION L"20190611"
@@ -48,6 +51,9 @@ typedef enum {
 
 VOID AsciiToUnicodeSizeQuote(CHAR8 *, UINT8, CHAR16 *, BOOLEAN);
 
+// --display --timing
+BOOLEAN TimeDisplay = FALSE;
+
 
 EFI_GRAPHICS_OUTPUT_BLT_PIXEL EfiGraphicsColors[16] = {
     // B    G    R   reserved
@@ -139,111 +145,58 @@ DumpHex( UINT8 *ptr,
 //
 EFI_STATUS
 DisplayImage( EFI_GRAPHICS_OUTPUT_PROTOCOL *Gop, 
-              EFI_HANDLE *BmpBuffer )
+              EFI_HANDLE *BmpBuffer,
+              BOOLEAN Timing )
 {
     EFI_GRAPHICS_OUTPUT_MODE_INFORMATION *Info;
     EFI_GRAPHICS_OUTPUT_BLT_PIXEL Background;
     EFI_GRAPHICS_OUTPUT_BLT_PIXEL *BltBuffer;
-    EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Blt;
     BMP_IMAGE_HEADER *BmpHeader;
-    BMP_COLOR_MAP *BmpColorMap;
+    BMP_DECODER Decoder;
     EFI_STATUS Status = EFI_SUCCESS;
-    UINT32 *Palette;
-    UINT8  *BitmapData;
-    UINT8  *Image;
-    UINT8  *ImageHeader;
     UINTN  SizeOfInfo;
-    UINTN  Pixels;
-    UINTN  Width, Height;
-    UINTN  ImageIndex;
-    UINTN  Index;
+    UINTN  Width;
     UINTN  ImageHeight;
     UINTN  ImageRows;
     UINTN  CurRow, CurCol;
     UINTN  MaxRows, MaxCols;
     UINTN  VertPixelDelta = 0;		
     UINTN  ImagePixelDelta = 0;		
+    UINT64 DecodeTicks;
+    UINT64 BltTicks;
+    UINT64 PortableTicks = 0;
 
     if (BmpBuffer == NULL) {
         return RETURN_INVALID_PARAMETER;
     }
 
-    BmpHeader  = (BMP_IMAGE_HEADER *) BmpBuffer;
-    BitmapData = (UINT8*)BmpBuffer + BmpHeader->ImageOffset;
-    Palette    = (UINT32*) ((UINT8*)BmpBuffer + 0x36);
-    Pixels     = BmpHeader->PixelWidth * BmpHeader->PixelHeight;
+    BmpHeader = (BMP_IMAGE_HEADER *) BmpBuffer;
+
+    // picks the row converter for the bit depth once for the whole image
+    Status = BmpDecoderInit( &Decoder, BmpBuffer, BmpHeader->Size, 0 );
+    if (EFI_ERROR (Status)) {
+        Print(L"ERROR: Unsupported or truncated BMP image [%r]\n", Status);
+        return Status;
+    }
 
-    BltBuffer = AllocateZeroPool( sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL) * Pixels);
+    BltBuffer = AllocatePool( sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL) * Decoder.Width * Decoder.Height );
     if (BltBuffer == NULL) {
         Print(L"ERROR: BltBuffer. No memory resources\n");
         return EFI_OUT_OF_RESOURCES;
     }
 
-    Image       = (UINT8 *)BmpBuffer;
-    BmpColorMap = (BMP_COLOR_MAP *) (Image + sizeof (BMP_IMAGE_HEADER));
-
-    Image       = ((UINT8 *)BmpBuffer) + BmpHeader->ImageOffset;
-    ImageHeader = Image;
-
     // fill blt buffer
-    for (Height = 0; Height < BmpHeader->PixelHeight; Height++) {
-        Blt = &BltBuffer[(BmpHeader->PixelHeight - Height - 1) * BmpHeader->PixelWidth];
-        for (Width = 0; Width < BmpHeader->PixelWidth; Width++, Image++, Blt++) {
-            switch (BmpHeader->BitPerPixel) {
-                case 1:                                 // Convert 1-bit BMP to 24-bit color
-                    for (Index = 0; Index < 8 && Width < BmpHeader->PixelWidth; Index++) {
-                        Blt->Blue  = BmpColorMap[((*Image) >> (7 - Index)) & 0x1].Blue;
-                        Blt->Green = BmpColorMap[((*Image) >> (7 - Index)) & 0x1].Green;
-                        Blt->Red   = BmpColorMap[((*Image) >> (7 - Index)) & 0x1].Red;
-                        Blt++; Width++;
-                    }
-                    Blt--; Width--;
-                    break;
-
-                case 4:                                 // Convert 4-bit BMP Palette to 24-bit color
-                    Index      = (*Image) >> 4;
-                    Blt->Blue  = BmpColorMap[Index].Blue;
-                    Blt->Green = BmpColorMap[Index].Green;
-                    Blt->Red   = BmpColorMap[Index].Red;
-                    if (Width < (BmpHeader->PixelWidth - 1)) {
-                        Blt++; Width++;
-                        Index      = (*Image) & 0x0f;
-                        Blt->Blue  = BmpColorMap[Index].Blue;
-                        Blt->Green = BmpColorMap[Index].Green;
-                        Blt->Red   = BmpColorMap[Index].Red;
-                    }
-                    break;
-
-                case 8:                                 // Convert 8-bit BMP palette to 24-bit color
-                    Blt->Blue  = BmpColorMap[*Image].Blue;
-                    Blt->Green = BmpColorMap[*Image].Green;
-                    Blt->Red   = BmpColorMap[*Image].Red;
-                    break;
-
-                case 24:                                // No conversion needed
-                    Blt->Blue  = *Image++;
-                    Blt->Green = *Image++;
-                    Blt->Red   = *Image;
-                    break;
-
-                case 32:                                // Convert to 24-bit by ignoring final byte of each pixel.
-                    Blt->Blue  = *Image++;
-                    Blt->Green = *Image++;
-                    Blt->Red   = *Image++;
-                    break;
-
-                default:
-                    FreePool(BltBuffer);
-                    return EFI_UNSUPPORTED;
-                    break;
-            };
-        }
+    DecodeTicks = AsmReadTsc();
+    Status = BmpDecodeImage( &Decoder, BltBuffer );
+    DecodeTicks = AsmReadTsc() - DecodeTicks;
+    if (EFI_ERROR (Status)) {
+        Print(L"ERROR: Corrupt %s image data\n", Decoder.ConverterName);
+        goto cleanup;
+    }
 
-        // start each row on a 32-bit boundary!
-        ImageIndex = (UINTN)Image - (UINTN)ImageHeader;
-        if ((ImageIndex % 4) != 0) {
-             Image = Image + (4 - (ImageIndex % 4));
-        }
+    if (Timing) {
+        PortableTicks = BmpTimePortableDecode( BmpBuffer, BmpHeader->Size,
+                                               Decoder.Width, Decoder.Height, 0, BltBuffer );
     }
 
     // get max rows and columns for current mode
@@ -313,6 +266,7 @@ DisplayImage( EFI_GRAPHICS_OUTPUT_PROTOCOL *Gop,
         } 
 
         // display the image
+        BltTicks = AsmReadTsc();
         Status = Gop->Blt( Gop,
                            BltBuffer,
                            EfiBltBufferToVideo,
@@ -320,6 +274,7 @@ DisplayImage( EFI_GRAPHICS_OUTPUT_PROTOCOL *Gop,
                            0, ImagePixelDelta + ((MaxRows - ImageRows) * EFI_GLYPH_HEIGHT),   // Destination X,Y
                            BmpHeader->PixelWidth, BmpHeader->PixelHeight, 
                            0 );
+        BltTicks = AsmReadTsc() - BltTicks;
         if (EFI_ERROR (Status)) {
             Print(L"ERROR: Image Display Gop->Blt [%d]\n", Status);
             goto cleanup;
@@ -328,6 +283,7 @@ DisplayImage( EFI_GRAPHICS_OUTPUT_PROTOCOL *Gop,
         SetCursorPosition(  0, MaxRows - 1 );
     } else {
         // just display the image
+        BltTicks = AsmReadTsc();
         Status = Gop->Blt( Gop,
                            BltBuffer,
                            EfiBltBufferToVideo,
@@ -335,6 +291,7 @@ DisplayImage( EFI_GRAPHICS_OUTPUT_PROTOCOL *Gop,
                            0, ImagePixelDelta + ((CurRow + 1) * EFI_GLYPH_HEIGHT),      // Destination X,Y 
                            BmpHeader->PixelWidth, BmpHeader->PixelHeight, 
                            0 );
+        BltTicks = AsmReadTsc() - BltTicks;
         if (EFI_ERROR (Status)) {
             Print(L"ERROR: Image Display Gop->Blt [%d]\n", Status);
             goto cleanup;
@@ -342,6 +299,16 @@ DisplayImage( EFI_GRAPHICS_OUTPUT_PROTOCOL *Gop,
         SetCursorPosition(  0, CurRow + ImageRows );
     }
 
+    if (Timing) {
+        UINT64 Frequency = TscFrequency();
+
+        Print(L"Decode: %ld us (%s, %d x %d)  Portable: %ld us  Blt: %ld us\n",
+              TscToMicroseconds( DecodeTicks, Frequency ), Decoder.ConverterName,
+              Decoder.Width, Decoder.Height,
+              TscToMicroseconds( PortableTicks, Frequency ),
+              TscToMicroseconds( BltTicks, Frequency ));
+    }
+
 cleanup:
     FreePool(BltBuffer);
 
@@ -487,12 +454,11 @@ ParseImage( UINT64 BmpImage,
 
     // supported bits per pixel
     if (BmpHeader->BitPerPixel != 1 &&
+        BmpHeader->BitPerPixel != 4 &&
         BmpHeader->BitPerPixel != 8 &&
-        BmpHeader->BitPerPixel != 8 &&
-        BmpHeader->BitPerPixel != 12 &&
         BmpHeader->BitPerPixel != 24 &&
         BmpHeader->BitPerPixel != 32) {
-        Print(L"ERROR: BitPerPixel is not one of 1, 4, 8, 12, 24 or 32\n");
+        Print(L"ERROR: BitPerPixel is not one of 1, 4, 8, 24 or 32\n");
         return EFI_UNSUPPORTED;
     }
 
@@ -535,7 +501,7 @@ ParseImage( UINT64 BmpImage,
             Print(L"ERROR: No graphics console found.\n");
             return Status;
         }
-        Status = DisplayImage( Gop, (EFI_HANDLE *)BmpImage );
+        Status = DisplayImage( Gop, (EFI_HANDLE *)BmpImage, TimeDisplay );
     } else if (Mode == Verbose) {
         PrintBMPHeader( (EFI_HANDLE *)BmpImage );
     } 
@@ -637,7 +603,7 @@ Usage( BOOLEAN ErrorMsg )
     Print(L"Usage: ShowBGRT [-v | --verbose]\n");
     Print(L"       ShowBGRT [-s | --save]\n");
     Print(L"       ShowBGRT [-D | --dump]\n");
-    Print(L"       ShowBGRT [-d | --display]\n");
+    Print(L"       ShowBGRT [-d | --display] [-t | --timing]\n");
     Print(L"       ShowBGRT [-V | --version]\n");
 }
 
@@ -655,7 +621,7 @@ ShellAppMain( UINTN Argc,
     CHAR16     GuidStr[100];
     MODE       Mode;
 
-    if (Argc == 2) {
+    if (Argc >= 2) {
         if (!StrCmp(Argv[1], L"--verbose") ||
             !StrCmp(Argv[1], L"-v")) {
             Mode = Verbose;
@@ -681,7 +647,10 @@ ShellAppMain( UINTN Argc,
             return Status;
         }
     }
-    if (Argc > 2) {
+    if (Argc == 3 && Mode == DisplayImageMode &&
+        (!StrCmp(Argv[2], L"--timing") || !StrCmp(Argv[2], L"-t"))) {
+        TimeDisplay = TRUE;
+    } else if (Argc > 2) {
         Usage(TRUE);
         return Status;
     }
@@ -8,298 +8,1461 @@
 //
 //  Requires pci.ids database from https://pci-ids.ucw.cz/ for full functionality 
 //
+//  If pci.idx (compiled from pci.ids by pciids2idx.py) is found it is used
+//  in preference to pci.ids. The text database is only used as a fallback.
+//
+//  Devices are enumerated by PciEnumLib, which reads configuration space
+//  through ECAM when the ACPI MCFG table is present.
+//
+
+
+#include <Uefi.h>
+#include <Library/UefiLib.h>
+#include <Library/ShellCEntryLib.h>
+#include <Library/ShellLib.h>
+#include <Library/ShellCommandLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/PrintLib.h>
+#include <Library/SortLib.h>
+#include <Library/PciEnumLib.h>
+#include <Library/TscTimerLib.h>
+
+#include <IndustryStandard/Pci.h>
+
+#define UTILITY_VERSION L"20190403"
+#undef DEBUG
+#define PCIDATABASE L"pci.ids"
+#define PCIINDEX    L"pci.idx"
+
+#define PCI_IDX_SIGNATURE  SIGNATURE_32('P', 'C', 'I', 'X')
+#define PCI_IDX_VERSION    2
+
+#define PCI_SNAPSHOT_SIGNATURE  SIGNATURE_32('P', 'C', 'I', 'S')
+#define PCI_SNAPSHOT_VERSION    1
+#define PCI_SNAPSHOT_BARS       6
+
+// binary pci.ids index as written by pciids2idx.py
+#pragma pack(1)
+typedef struct {
+   UINT32  Signature;
+   UINT16  Version;
+   UINT16  HeaderSize;
+   UINT32  VersionString;           // string pool offset
+   UINT32  VendorCount;
+   UINT32  VendorTable;             // file offset
+   UINT32  DeviceCount;
+   UINT32  DeviceTable;             // file offset
+   UINT32  StringPoolSize;
+   UINT32  StringPool;              // file offset
+   UINT32  SubsystemCount;
+   UINT32  SubsystemTable;          // file offset
+   UINT32  ClassCount;
+   UINT32  ClassTable;              // file offset
+   UINT32  SubclassCount;
+   UINT32  SubclassTable;           // file offset
+   UINT32  ProgIfCount;
+   UINT32  ProgIfTable;             // file offset
+} PCI_IDX_HEADER;
+
+typedef struct {
+   UINT16  VendorId;
+   UINT16  Reserved;
+   UINT32  Name;                    // string pool offset
+   UINT32  FirstDevice;             // index into device table
+   UINT32  DeviceCount;
+} PCI_IDX_VENDOR;
+
+typedef struct {
+   UINT16  DeviceId;
+   UINT16  Reserved;
+   UINT32  Name;                    // string pool offset
+   UINT32  FirstSubsystem;          // index into subsystem table
+   UINT32  SubsystemCount;
+} PCI_IDX_DEVICE;
+
+typedef struct {
+   UINT16  SubvendorId;
+   UINT16  SubdeviceId;
+   UINT32  Name;                    // string pool offset
+} PCI_IDX_SUBSYSTEM;
+
+// shared by base class, subclass and programming interface entries
+typedef struct {
+   UINT8   Id;
+   UINT8   Reserved;
+   UINT16  Reserved2;
+   UINT32  Name;                    // string pool offset
+   UINT32  First;                   // index into next level table
+   UINT32  Count;
+} PCI_IDX_CLASS;
+
+// enumeration snapshot as written by --save
+typedef struct {
+   UINT32  Signature;
+   UINT16  Version;
+   UINT16  EntrySize;
+   UINT32  EntryCount;
+   UINT32  Reserved;
+} PCI_SNAPSHOT_HEADER;
+
+typedef struct {
+   PCI_DEVICE_RECORD  Record;
+   UINT32             Bar[PCI_SNAPSHOT_BARS];   // unused BARs are zero
+} PCI_SNAPSHOT_ENTRY;
+#pragma pack()
+
+typedef struct {
+   UINT8             *Buffer;
+   UINTN             BufferSize;
+   PCI_IDX_VENDOR    *Vendors;
+   UINTN             VendorCount;
+   PCI_IDX_DEVICE    *Devices;
+   UINTN             DeviceCount;
+   PCI_IDX_SUBSYSTEM *Subsystems;
+   UINTN             SubsystemCount;
+   PCI_IDX_CLASS     *Classes;
+   UINTN             ClassCount;
+   PCI_IDX_CLASS     *Subclasses;
+   UINTN             SubclassCount;
+   PCI_IDX_CLASS     *ProgIfs;
+   UINTN             ProgIfCount;
+   CHAR8             *Strings;
+   UINTN             StringsSize;
+   UINT32            Version;       // string pool offset
+   UINTN             IndexSize;     // bytes used by the lookup tables
+   BOOLEAN           Text;          // built from pci.ids
+} PCI_DATABASE;
+
+// continuation lines line up with the vendor name column
+#define NAME_INDENT L"                                            "
+
+// PCI Express capability registers, relative to the capability
+#define PCIE_CAPABILITY_REG_OFFSET    0x02
+#define PCIE_LINK_CAPABILITY_OFFSET   0x0c
+#define PCIE_LINK_STATUS_OFFSET       0x12
+#define PCIE_LINK_REGISTERS_SIZE      0x14
+
+// device/port types without a link
+#define PCIE_PORT_TYPE_RC_INTEGRATED_ENDPOINT  0x9
+#define PCIE_PORT_TYPE_RC_EVENT_COLLECTOR      0xa
+
+// link speed encodings 1 to 6
+CHAR16 *mLinkSpeeds[] = { L"2.5", L"5", L"8", L"16", L"32", L"64" };
+
+//
+// Hex dump a function's configuration space, already read into Buffer.
+// All-zero lines of the extended space are omitted as most of it is
+// normally unused.
+//
+VOID
+PciDumpConfigSpace( UINT8 *Buffer,
+                    UINTN Size )
+{
+    UINTN Offset, Index;
+    BOOLEAN Zero;
+
+    for (Offset = 0; Offset < Size; Offset += 16) {
+        if (Offset >= PCI_ENUM_CONFIG_SIZE) {
+            Zero = TRUE;
+            for (Index = 0; Index < 16; Index++) {
+                if (Buffer[Offset + Index] != 0) {
+                    Zero = FALSE;
+                    break;
+                }
+            }
+            if (Zero) {
+                continue;
+            }
+        }
+
+        Print(L"        %03x:", Offset);
+        for (Index = 0; Index < 16; Index++) {
+            Print(L" %02x", Buffer[Offset + Index]);
+        }
+        Print(L"\n");
+    }
+    Print(L"\n");
+}
+
+
+CHAR16 *
+PciCapabilityName( UINT8 Id )
+{
+    switch (Id) {
+        case 0x01: return L"Power Management";
+        case 0x02: return L"AGP";
+        case 0x03: return L"Vital Product Data";
+        case 0x04: return L"Slot Identification";
+        case 0x05: return L"MSI";
+        case 0x06: return L"CompactPCI Hot Swap";
+        case 0x07: return L"PCI-X";
+        case 0x08: return L"HyperTransport";
+        case 0x09: return L"Vendor Specific";
+        case 0x0a: return L"Debug Port";
+        case 0x0b: return L"CompactPCI Resource Control";
+        case 0x0c: return L"PCI Hot-Plug";
+        case 0x0d: return L"Bridge Subsystem Vendor ID";
+        case 0x0e: return L"AGP 8x";
+        case 0x0f: return L"Secure Device";
+        case 0x10: return L"PCI Express";
+        case 0x11: return L"MSI-X";
+        case 0x12: return L"SATA Configuration";
+        case 0x13: return L"Advanced Features";
+        case 0x14: return L"Enhanced Allocation";
+        case 0x15: return L"Flattening Portal Bridge";
+    }
+
+    return L"Unknown";
+}
+
+
+CHAR16 *
+PciExtCapabilityName( UINT16 Id )
+{
+    switch (Id) {
+        case 0x0001: return L"Advanced Error Reporting";
+        case 0x0002: return L"Virtual Channel";
+        case 0x0003: return L"Device Serial Number";
+        case 0x0004: return L"Power Budgeting";
+        case 0x0005: return L"Root Complex Link Declaration";
+        case 0x0006: return L"Root Complex Internal Link Control";
+        case 0x0007: return L"Root Complex Event Collector Endpoint Association";
+        case 0x0008: return L"Multi-Function Virtual Channel";
+        case 0x0009: return L"Virtual Channel";
+        case 0x000a: return L"Root Complex Register Block";
+        case 0x000b: return L"Vendor Specific";
+        case 0x000d: return L"Access Control Services";
+        case 0x000e: return L"Alternative Routing-ID Interpretation";
+        case 0x000f: return L"Address Translation Services";
+        case 0x0010: return L"Single Root I/O Virtualization";
+        case 0x0011: return L"Multi-Root I/O Virtualization";
+        case 0x0012: return L"Multicast";
+        case 0x0013: return L"Page Request";
+        case 0x0015: return L"Resizable BAR";
+        case 0x0016: return L"Dynamic Power Allocation";
+        case 0x0017: return L"TPH Requester";
+        case 0x0018: return L"Latency Tolerance Reporting";
+        case 0x0019: return L"Secondary PCI Express";
+        case 0x001b: return L"Process Address Space ID";
+        case 0x001d: return L"Downstream Port Containment";
+        case 0x001e: return L"L1 PM Substates";
+        case 0x001f: return L"Precision Time Measurement";
+        case 0x0023: return L"Designated Vendor Specific";
+        case 0x0025: return L"Data Link Feature";
+        case 0x0026: return L"Physical Layer 16.0 GT/s";
+        case 0x0027: return L"Lane Margining at the Receiver";
+    }
+
+    return L"Unknown";
+}
+
+
+CHAR16 *
+PciLinkSpeed( UINT8 Speed )
+{
+    if (Speed == 0 || Speed > ARRAY_SIZE(mLinkSpeeds)) {
+        return L"?";
+    }
+
+    return mLinkSpeeds[Speed - 1];
+}
+
+
+//
+// Decode the link registers of a PCI Express capability at Offset. The
+// negotiated speed and width are compared against the port's own maximum;
+// returns TRUE if the link trained below it.
+//
+BOOLEAN
+PciPrintLink( UINT8 *Buffer,
+              UINTN Offset )
+{
+    UINT16 CapReg  = *(UINT16 *)(Buffer + Offset + PCIE_CAPABILITY_REG_OFFSET);
+    UINT32 LinkCap = *(UINT32 *)(Buffer + Offset + PCIE_LINK_CAPABILITY_OFFSET);
+    UINT16 LinkSta = *(UINT16 *)(Buffer + Offset + PCIE_LINK_STATUS_OFFSET);
+    UINT8  PortType = (CapReg >> 4) & 0x0f;
+    UINT8  MaxSpeed = LinkCap & 0x0f;
+    UINT8  MaxWidth = (LinkCap >> 4) & 0x3f;
+    UINT8  Speed = LinkSta & 0x0f;
+    UINT8  Width = (LinkSta >> 4) & 0x3f;
+    BOOLEAN Degraded;
+
+    // integrated endpoints and event collectors have no link
+    if (PortType == PCIE_PORT_TYPE_RC_INTEGRATED_ENDPOINT ||
+        PortType == PCIE_PORT_TYPE_RC_EVENT_COLLECTOR ||
+        MaxWidth == 0) {
+        return FALSE;
+    }
+
+    if (Width == 0) {
+        Print(L"              Link: down (capable %s GT/s x%d)\n",
+              PciLinkSpeed( MaxSpeed ), MaxWidth);
+        return FALSE;
+    }
+
+    Degraded = (Speed < MaxSpeed || Width < MaxWidth);
+    Print(L"              Link: %s GT/s x%d (capable %s GT/s x%d)%s\n",
+          PciLinkSpeed( Speed ), Width,
+          PciLinkSpeed( MaxSpeed ), MaxWidth,
+          Degraded ? L"  ** DEGRADED **" : L"");
+
+    return Degraded;
+}
+
+
+//
+// Walk the capability list and, for PCI Express functions with ConfigSize
+// bytes of configuration space, the extended capability list. Buffer holds
+// the first Size bytes; extended capability headers beyond it are read as
+// the list is walked. Visited dwords are tracked so that a corrupt next
+// pointer cannot make the walk loop.
+//
+BOOLEAN
+PciPrintCapabilities( PCI_ENUM_CONTEXT *Enum,
+                      PCI_DEVICE_RECORD *Record,
+                      UINT8 *Buffer,
+                      UINTN Size,
+                      UINTN ConfigSize )
+{
+    PCI_DEVICE_INDEPENDENT_REGION *Common = (PCI_DEVICE_INDEPENDENT_REGION *) Buffer;
+    BOOLEAN Degraded = FALSE;
+    BOOLEAN Express = FALSE;
+    UINT32 Visited[PCI_ENUM_EXTENDED_SIZE / 4 / 32];
+    UINT32 Header;
+    UINTN Offset;
+
+    if ((Common->Status & EFI_PCI_STATUS_CAPABILITY) == 0) {
+        return FALSE;
+    }
+
+    if ((Record->HeaderType & HEADER_LAYOUT_CODE) == HEADER_TYPE_CARDBUS_BRIDGE) {
+        Offset = Buffer[EFI_PCI_CARDBUS_BRIDGE_CAPABILITY_PTR];
+    } else {
+        Offset = Buffer[PCI_CAPBILITY_POINTER_OFFSET];
+    }
+
+    ZeroMem( Visited, sizeof(Visited) );
+    while (TRUE) {
+        Offset &= 0xfc;
+        if (Offset < PCI_ENUM_HEADER_SIZE || (Visited[Offset / 128] & (1u << (Offset / 4 % 32)))) {
+            break;
+        }
+        Visited[Offset / 128] |= 1u << (Offset / 4 % 32);
+
+        Print(L"        [%03x] %02x %s\n", Offset, Buffer[Offset],
+              PciCapabilityName( Buffer[Offset] ));
+        if (Buffer[Offset] == EFI_PCI_CAPABILITY_ID_PCIEXP &&
+            Offset + PCIE_LINK_REGISTERS_SIZE <= Size) {
+            Express = TRUE;
+            Degraded |= PciPrintLink( Buffer, Offset );
+        }
+
+        Offset = Buffer[Offset + 1];
+    }
+
+    // extended capabilities start at 0x100 in PCI Express devices only
+    if (!Express || ConfigSize < PCI_ENUM_EXTENDED_SIZE) {
+        return Degraded;
+    }
+
+    Offset = PCI_ENUM_CONFIG_SIZE;
+    while (TRUE) {
+        if (Offset < Size) {
+            Header = *(UINT32 *)(Buffer + Offset);
+        } else if (EFI_ERROR(PciEnumReadConfig( Enum, Record, Offset, 1, &Header ))) {
+            break;
+        }
+        if (Header == 0 || Header == 0xffffffff ||
+            (Visited[Offset / 128] & (1u << (Offset / 4 % 32)))) {
+            break;
+        }
+        Visited[Offset / 128] |= 1u << (Offset / 4 % 32);
+
+        Print(L"        [%03x] %04x %s v%d\n", Offset, Header & 0xffff,
+              PciExtCapabilityName( (UINT16)(Header & 0xffff) ), (Header >> 16) & 0x0f);
+
+        Offset = (Header >> 20) & 0xffc;
+        if (Offset < PCI_ENUM_CONFIG_SIZE) {
+            break;
+        }
+    }
+
+    return Degraded;
+}
+
+
+//
+// Read the named file into a single pool buffer.  Extra zeroed bytes are
+// appended so that text databases are always NUL-terminated.
+//
+EFI_STATUS
+ReadWholeFile( CHAR16 *FileName,
+               UINT8 **Buffer,
+               UINTN *BufferSize,
+               UINTN Extra )
+{
+    SHELL_FILE_HANDLE FileHandle = (SHELL_FILE_HANDLE)NULL;
+    EFI_FILE_INFO *FileInfo = NULL;
+    EFI_STATUS Status = EFI_SUCCESS;
+    UINTN Size;
+
+    *Buffer = NULL;
+    *BufferSize = 0;
+
+    Status = ShellOpenFileByName( FileName, 
+                                  &FileHandle,
+                                  EFI_FILE_MODE_READ,
+                                  0 );
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+
+    FileInfo = ShellGetFileInfo( FileHandle );
+    if (FileInfo == NULL) {
+        ShellCloseFile( &FileHandle );
+        return EFI_NOT_FOUND;
+    }
+    Size = (UINTN) FileInfo->FileSize;
+    FreePool( FileInfo );
+
+    *Buffer = AllocateZeroPool( Size + Extra );
+    if (*Buffer == NULL) {
+        ShellCloseFile( &FileHandle );
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    *BufferSize = Size;
+    Status = ShellReadFile( FileHandle, BufferSize, *Buffer );
+    ShellCloseFile( &FileHandle );
+    if (EFI_ERROR(Status) || *BufferSize != Size) {
+        FreePool( *Buffer );
+        *Buffer = NULL;
+        *BufferSize = 0;
+        return EFI_VOLUME_CORRUPTED;
+    }
+
+    return EFI_SUCCESS;
+}
+
+
+//
+// Read a database file, found on the shell path, into a single pool buffer
+//
+EFI_STATUS
+ReadDatabaseFile( CHAR16 *FileName,
+                  UINT8 **Buffer,
+                  UINTN *BufferSize,
+                  UINTN Extra )
+{
+    EFI_STATUS Status;
+    CHAR16 *FullFileName;
+
+    *Buffer = NULL;
+    *BufferSize = 0;
+
+    FullFileName = ShellFindFilePath( FileName );
+    if (FullFileName == NULL) {
+        return EFI_NOT_FOUND;
+    }
+
+    Status = ReadWholeFile( FullFileName, Buffer, BufferSize, Extra );
+    FreePool( FullFileName );
+
+    return Status;
+}
+
+
+//
+// Check that a table of Count entries of EntrySize bytes lies within the index
+//
+BOOLEAN
+PciIndexTableValid( UINTN BufferSize,
+                    UINT32 Offset,
+                    UINT32 Count,
+                    UINTN EntrySize )
+{
+    UINT64 End = (UINT64)Offset + (UINT64)Count * EntrySize;
+
+    return (End <= BufferSize);
+}
+
+
+VOID
+FreePciDatabase( PCI_DATABASE *Db )
+{
+    if (Db->Text) {
+        if (Db->Vendors != NULL) {
+            FreePool( Db->Vendors );
+        }
+        if (Db->Devices != NULL) {
+            FreePool( Db->Devices );
+        }
+        if (Db->Subsystems != NULL) {
+            FreePool( Db->Subsystems );
+        }
+        if (Db->Classes != NULL) {
+            FreePool( Db->Classes );
+        }
+        if (Db->Subclasses != NULL) {
+            FreePool( Db->Subclasses );
+        }
+        if (Db->ProgIfs != NULL) {
+            FreePool( Db->ProgIfs );
+        }
+    }
+    if (Db->Buffer != NULL) {
+        FreePool( Db->Buffer );
+    }
+    ZeroMem( Db, sizeof(PCI_DATABASE) );
+}
+
+
+//
+// Load pci.idx into memory in a single read and validate it
+//
+EFI_STATUS
+LoadPciIndex( PCI_DATABASE *Db )
+{
+    EFI_STATUS Status = EFI_SUCCESS;
+    PCI_IDX_HEADER *Header;
+    UINTN Size;
+
+    ZeroMem( Db, sizeof(PCI_DATABASE) );
+
+    Status = ReadDatabaseFile( PCIINDEX, &Db->Buffer, &Db->BufferSize, 0 );
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+
+    Size = Db->BufferSize;
+    Header = (PCI_IDX_HEADER *) Db->Buffer;
+    if (Size < sizeof(PCI_IDX_HEADER) ||
+        Header->Signature != PCI_IDX_SIGNATURE ||
+        Header->Version != PCI_IDX_VERSION ||
+        !PciIndexTableValid( Size, Header->VendorTable, Header->VendorCount, sizeof(PCI_IDX_VENDOR) ) ||
+        !PciIndexTableValid( Size, Header->DeviceTable, Header->DeviceCount, sizeof(PCI_IDX_DEVICE) ) ||
+        !PciIndexTableValid( Size, Header->SubsystemTable, Header->SubsystemCount, sizeof(PCI_IDX_SUBSYSTEM) ) ||
+        !PciIndexTableValid( Size, Header->ClassTable, Header->ClassCount, sizeof(PCI_IDX_CLASS) ) ||
+        !PciIndexTableValid( Size, Header->SubclassTable, Header->SubclassCount, sizeof(PCI_IDX_CLASS) ) ||
+        !PciIndexTableValid( Size, Header->ProgIfTable, Header->ProgIfCount, sizeof(PCI_IDX_CLASS) ) ||
+        !PciIndexTableValid( Size, Header->StringPool, Header->StringPoolSize, sizeof(CHAR8) ) ||
+        Header->StringPoolSize == 0 ||
+        Db->Buffer[Header->StringPool + Header->StringPoolSize - 1] != '\0') {
+        FreePciDatabase( Db );
+        return EFI_VOLUME_CORRUPTED;
+    }
+
+    Db->Vendors        = (PCI_IDX_VENDOR *) (Db->Buffer + Header->VendorTable);
+    Db->VendorCount    = Header->VendorCount;
+    Db->Devices        = (PCI_IDX_DEVICE *) (Db->Buffer + Header->DeviceTable);
+    Db->DeviceCount    = Header->DeviceCount;
+    Db->Subsystems     = (PCI_IDX_SUBSYSTEM *) (Db->Buffer + Header->SubsystemTable);
+    Db->SubsystemCount = Header->SubsystemCount;
+    Db->Classes        = (PCI_IDX_CLASS *) (Db->Buffer + Header->ClassTable);
+    Db->ClassCount     = Header->ClassCount;
+    Db->Subclasses     = (PCI_IDX_CLASS *) (Db->Buffer + Header->SubclassTable);
+    Db->SubclassCount  = Header->SubclassCount;
+    Db->ProgIfs        = (PCI_IDX_CLASS *) (Db->Buffer + Header->ProgIfTable);
+    Db->ProgIfCount    = Header->ProgIfCount;
+    Db->Strings        = (CHAR8 *) (Db->Buffer + Header->StringPool);
+    Db->StringsSize    = Header->StringPoolSize;
+    Db->Version        = Header->VersionString;
+    Db->IndexSize      = Db->BufferSize;
+
+    return EFI_SUCCESS;
+}
+
+
+//
+// Grow a table by doubling so that it can hold at least Count + 1 entries
+//
+EFI_STATUS
+PciDatabaseGrow( VOID **Table,
+                 UINTN *Capacity,
+                 UINTN Count,
+                 UINTN EntrySize )
+{
+    VOID  *NewTable;
+    UINTN NewCapacity;
+
+    if (Count < *Capacity) {
+        return EFI_SUCCESS;
+    }
+
+    NewCapacity = (*Capacity == 0) ? 256 : *Capacity * 2;
+    NewTable = ReallocatePool( *Capacity * EntrySize,
+                               NewCapacity * EntrySize,
+                               *Table );
+    if (NewTable == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+    }
+    *Table = NewTable;
+    *Capacity = NewCapacity;
+
+    return EFI_SUCCESS;
+}
+
+
+BOOLEAN
+ParseHex( CHAR8 *Str,
+          UINTN Digits,
+          UINT16 *Value )
+{
+    UINT16 Result = 0;
+    CHAR8  c;
+
+    for (UINTN i = 0; i < Digits; i++) {
+        c = Str[i];
+        if (c >= '0' && c <= '9') {
+            c -= '0';
+        } else if (c >= 'a' && c <= 'f') {
+            c -= 'a' - 10;
+        } else if (c >= 'A' && c <= 'F') {
+            c -= 'A' - 10;
+        } else {
+            return FALSE;
+        }
+        Result = (UINT16)((Result << 4) | c);
+    }
+    *Value = Result;
+
+    return TRUE;
+}
+
+
+//
+// Skip the ID and separating white space, terminate the name in place
+// (dropping trailing white space) and return its offset from the start
+// of the buffer
+//
+UINT32
+TerminateName( CHAR8 *Buffer,
+               CHAR8 *Str )
+{
+    CHAR8 *Name;
+
+    while (*Str == ' ' || *Str == '\t') {
+        Str++;
+    }
+    Name = Str;
+    while (*Str != '\0' && *Str != '\n' && *Str != '\r') {
+        Str++;
+    }
+    while (Str > Name && (Str[-1] == ' ' || Str[-1] == '\t')) {
+        Str--;
+    }
+    *Str = '\0';
+
+    return (UINT32)(Name - Buffer);
+}
+
+
+INTN
+EFIAPI
+CompareVendor( CONST VOID *Left,
+               CONST VOID *Right )
+{
+    return (INTN)((PCI_IDX_VENDOR *)Left)->VendorId - (INTN)((PCI_IDX_VENDOR *)Right)->VendorId;
+}
+
+
+INTN
+EFIAPI
+CompareDevice( CONST VOID *Left,
+               CONST VOID *Right )
+{
+    return (INTN)((PCI_IDX_DEVICE *)Left)->DeviceId - (INTN)((PCI_IDX_DEVICE *)Right)->DeviceId;
+}
+
+
+INTN
+EFIAPI
+CompareSubsystem( CONST VOID *Left,
+                  CONST VOID *Right )
+{
+    PCI_IDX_SUBSYSTEM *L = (PCI_IDX_SUBSYSTEM *)Left;
+    PCI_IDX_SUBSYSTEM *R = (PCI_IDX_SUBSYSTEM *)Right;
+
+    if (L->SubvendorId != R->SubvendorId) {
+        return (INTN)L->SubvendorId - (INTN)R->SubvendorId;
+    }
+
+    return (INTN)L->SubdeviceId - (INTN)R->SubdeviceId;
+}
+
+
+INTN
+EFIAPI
+CompareClass( CONST VOID *Left,
+              CONST VOID *Right )
+{
+    return (INTN)((PCI_IDX_CLASS *)Left)->Id - (INTN)((PCI_IDX_CLASS *)Right)->Id;
+}
+
+
+//
+// Sort a table slice unless it is already in order
+//
+VOID
+SortPciTable( VOID *Table,
+              UINTN Count,
+              UINTN EntrySize,
+              SORT_COMPARE Compare )
+{
+    UINT8 *Entry = (UINT8 *) Table;
+
+    for (UINTN Index = 1; Index < Count; Index++) {
+        if (Compare( Entry + (Index - 1) * EntrySize, Entry + Index * EntrySize ) > 0) {
+            PerformQuickSort( Table, Count, EntrySize, Compare );
+            return;
+        }
+    }
+}
+
+
+//
+// pci.ids asks contributors to keep it sorted but do not rely on it.
+// Child slices travel with their parent entries so the order of the
+// levels does not matter.
+//
+VOID
+SortPciDatabase( PCI_DATABASE *Db )
+{
+    UINTN Index;
+
+    SortPciTable( Db->Vendors, Db->VendorCount, sizeof(PCI_IDX_VENDOR), CompareVendor );
+    for (Index = 0; Index < Db->VendorCount; Index++) {
+        SortPciTable( &Db->Devices[Db->Vendors[Index].FirstDevice], Db->Vendors[Index].DeviceCount,
+                      sizeof(PCI_IDX_DEVICE), CompareDevice );
+    }
+    for (Index = 0; Index < Db->DeviceCount; Index++) {
+        SortPciTable( &Db->Subsystems[Db->Devices[Index].FirstSubsystem], Db->Devices[Index].SubsystemCount,
+                      sizeof(PCI_IDX_SUBSYSTEM), CompareSubsystem );
+    }
+
+    SortPciTable( Db->Classes, Db->ClassCount, sizeof(PCI_IDX_CLASS), CompareClass );
+    for (Index = 0; Index < Db->ClassCount; Index++) {
+        SortPciTable( &Db->Subclasses[Db->Classes[Index].First], Db->Classes[Index].Count,
+                      sizeof(PCI_IDX_CLASS), CompareClass );
+    }
+    for (Index = 0; Index < Db->SubclassCount; Index++) {
+        SortPciTable( &Db->ProgIfs[Db->Subclasses[Index].First], Db->Subclasses[Index].Count,
+                      sizeof(PCI_IDX_CLASS), CompareClass );
+    }
+}
+
+
+//
+// Append a class, subclass or programming interface entry
+//
+EFI_STATUS
+AddPciClass( PCI_IDX_CLASS **Table,
+             UINTN *Capacity,
+             UINTN *Count,
+             UINT16 Id,
+             UINT32 Name,
+             UINTN First )
+{
+    EFI_STATUS Status;
+    PCI_IDX_CLASS *Entry;
+
+    Status = PciDatabaseGrow( (VOID **)Table, Capacity, *Count, sizeof(PCI_IDX_CLASS) );
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+
+    Entry = &(*Table)[(*Count)++];
+    ZeroMem( Entry, sizeof(PCI_IDX_CLASS) );
+    Entry->Id = (UINT8) Id;
+    Entry->Name = Name;
+    Entry->First = (UINT32) First;
+
+    return EFI_SUCCESS;
+}
+
+
+//
+// Read pci.ids in one go and build the lookup tables over it in a single
+// pass. Names are terminated in place so the file buffer doubles as the
+// string pool.
+//
+EFI_STATUS
+LoadPciText( PCI_DATABASE *Db )
+{
+    EFI_STATUS Status = EFI_SUCCESS;
+    PCI_IDX_VENDOR *Vendor = NULL;
+    PCI_IDX_DEVICE *Device = NULL;
+    PCI_IDX_CLASS *Class = NULL;
+    PCI_IDX_CLASS *Subclass = NULL;
+    PCI_IDX_SUBSYSTEM *Subsystem;
+    BOOLEAN InClasses = FALSE;
+    CHAR8  *Line, *Next, *Str;
+    UINTN  VendorCapacity = 0;
+    UINTN  DeviceCapacity = 0;
+    UINTN  SubsystemCapacity = 0;
+    UINTN  ClassCapacity = 0;
+    UINTN  SubclassCapacity = 0;
+    UINTN  ProgIfCapacity = 0;
+    UINT16 Id, Id2;
+
+    ZeroMem( Db, sizeof(PCI_DATABASE) );
+    Db->Text = TRUE;
+
+    Status = ReadDatabaseFile( PCIDATABASE, &Db->Buffer, &Db->BufferSize, 1 );
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+
+    Db->Strings = (CHAR8 *) Db->Buffer;
+    Db->StringsSize = Db->BufferSize + 1;
+    Db->Version = (UINT32) Db->BufferSize;            // empty string
+
+    for (Line = Db->Strings; *Line != '\0'; Line = Next) {
+        for (Next = Line; *Next != '\0' && *Next != '\n'; Next++) {
+            ;
+        }
+        if (*Next == '\n') {
+            Next++;
+        }
+
+        if (Line[0] == '#') {
+            for (Str = Line; Db->Version == Db->BufferSize && Str + 9 < Next; Str++) {
+                if (!AsciiStrnCmp( Str, "Version: ", 9 )) {
+                    Db->Version = TerminateName( Db->Strings, Str + 9 );
+                }
+            }
+            continue;
+        }
+
+        // device class section follows the vendors
+        if (Line[0] == 'C' && Line[1] == ' ' && ParseHex( Line + 2, 2, &Id )) {
+            InClasses = TRUE;
+            Status = AddPciClass( &Db->Classes, &ClassCapacity, &Db->ClassCount,
+                                  Id, TerminateName( Db->Strings, Line + 4 ), Db->SubclassCount );
+            if (EFI_ERROR(Status)) {
+                break;
+            }
+            Class = &Db->Classes[Db->ClassCount - 1];
+            Subclass = NULL;
+            continue;
+        }
+
+        if (InClasses) {
+            if (Line[0] != '\t') {
+                Class = NULL;                            // some other section
+                Subclass = NULL;
+            } else if (Line[1] != '\t' && Class != NULL && ParseHex( Line + 1, 2, &Id )) {
+                Status = AddPciClass( &Db->Subclasses, &SubclassCapacity, &Db->SubclassCount,
+                                      Id, TerminateName( Db->Strings, Line + 3 ), Db->ProgIfCount );
+                if (EFI_ERROR(Status)) {
+                    break;
+                }
+                Subclass = &Db->Subclasses[Db->SubclassCount - 1];
+                Class->Count++;
+            } else if (Line[1] == '\t' && Subclass != NULL && ParseHex( Line + 2, 2, &Id )) {
+                Status = AddPciClass( &Db->ProgIfs, &ProgIfCapacity, &Db->ProgIfCount,
+                                      Id, TerminateName( Db->Strings, Line + 4 ), 0 );
+                if (EFI_ERROR(Status)) {
+                    break;
+                }
+                Subclass->Count++;
+            }
+            continue;
+        }
+
+        if (Line[0] != '\t' && ParseHex( Line, 4, &Id )) {
+            Status = PciDatabaseGrow( (VOID **)&Db->Vendors, &VendorCapacity,
+                                      Db->VendorCount, sizeof(PCI_IDX_VENDOR) );
+            if (EFI_ERROR(Status)) {
+                break;
+            }
+            Vendor = &Db->Vendors[Db->VendorCount++];
+            Vendor->VendorId = Id;
+            Vendor->Reserved = 0;
+            Vendor->Name = TerminateName( Db->Strings, Line + 4 );
+            Vendor->FirstDevice = (UINT32) Db->DeviceCount;
+            Vendor->DeviceCount = 0;
+            Device = NULL;
+        } else if (Vendor != NULL && Line[0] == '\t' && Line[1] != '\t' &&
+                   ParseHex( Line + 1, 4, &Id )) {
+            Status = PciDatabaseGrow( (VOID **)&Db->Devices, &DeviceCapacity,
+                                      Db->DeviceCount, sizeof(PCI_IDX_DEVICE) );
+            if (EFI_ERROR(Status)) {
+                break;
+            }
+            Device = &Db->Devices[Db->DeviceCount++];
+            Device->DeviceId = Id;
+            Device->Reserved = 0;
+            Device->Name = TerminateName( Db->Strings, Line + 5 );
+            Device->FirstSubsystem = (UINT32) Db->SubsystemCount;
+            Device->SubsystemCount = 0;
+            Vendor->DeviceCount++;
+        } else if (Device != NULL && Line[0] == '\t' && Line[1] == '\t' &&
+                   ParseHex( Line + 2, 4, &Id ) && Line[6] == ' ' &&
+                   ParseHex( Line + 7, 4, &Id2 )) {
+            Status = PciDatabaseGrow( (VOID **)&Db->Subsystems, &SubsystemCapacity,
+                                      Db->SubsystemCount, sizeof(PCI_IDX_SUBSYSTEM) );
+            if (EFI_ERROR(Status)) {
+                break;
+            }
+            Subsystem = &Db->Subsystems[Db->SubsystemCount++];
+            Subsystem->SubvendorId = Id;
+            Subsystem->SubdeviceId = Id2;
+            Subsystem->Name = TerminateName( Db->Strings, Line + 11 );
+            Device->SubsystemCount++;
+        }
+    }
 
+    if (EFI_ERROR(Status)) {
+        FreePciDatabase( Db );
+        return Status;
+    }
 
-#include <Uefi.h>
-#include <Library/UefiLib.h>
-#include <Library/ShellCEntryLib.h>
-#include <Library/ShellLib.h>
-#include <Library/ShellCommandLib.h>
-#include <Library/BaseLib.h>
-#include <Library/BaseMemoryLib.h>
-#include <Library/MemoryAllocationLib.h>
-#include <Library/UefiBootServicesTableLib.h>
-#include <Library/PrintLib.h>
+    SortPciDatabase( Db );
 
-#include <Protocol/PciEnumerationComplete.h>
-#include <Protocol/PciRootBridgeIo.h>
+    Db->IndexSize = VendorCapacity * sizeof(PCI_IDX_VENDOR) +
+                    DeviceCapacity * sizeof(PCI_IDX_DEVICE) +
+                    SubsystemCapacity * sizeof(PCI_IDX_SUBSYSTEM) +
+                    (ClassCapacity + SubclassCapacity + ProgIfCapacity) * sizeof(PCI_IDX_CLASS);
 
-#include <IndustryStandard/Pci.h>
+    return EFI_SUCCESS;
+}
 
-#define CALC_EFI_PCI_ADDRESS(Bus, Dev, Func, Reg) \
-    ((UINT64) ((((UINTN) Bus) << 24) + (((UINTN) Dev) << 16) + (((UINTN) Func) << 8) + ((UINTN) Reg)))
 
-// all typedefs from EDKII sources
-#pragma pack(1)
-typedef union {
-   PCI_DEVICE_HEADER_TYPE_REGION  Device;
-   PCI_CARDBUS_CONTROL_REGISTER   CardBus;
-} NON_COMMON_UNION;
+//
+// Prefer the binary index, fall back to the text database
+//
+EFI_STATUS
+LoadPciDatabase( PCI_DATABASE *Db )
+{
+    if (!EFI_ERROR(LoadPciIndex( Db ))) {
+        return EFI_SUCCESS;
+    }
 
-typedef struct {
-   PCI_DEVICE_INDEPENDENT_REGION  Common;
-   NON_COMMON_UNION               NonCommon;
-   UINT32                         Data[48];
-} PCI_CONFIG_SPACE;
-#pragma pack()
+    return LoadPciText( Db );
+}
 
-#define UTILITY_VERSION L"20190403"
-#undef DEBUG
-#define LINE_MAX 1024
-#define PCIDATABASE L"pci.ids"
 
-#define EFI_PCI_EMUMERATION_COMPLETE_GUID \
-    { 0x30cfe3e7, 0x3de1, 0x4586, {0xbe, 0x20, 0xde, 0xab, 0xa1, 0xb3, 0xb7, 0x93}}
+CHAR8 *
+PciIndexString( PCI_DATABASE *Db,
+                UINT32 Offset )
+{
+    if (Offset >= Db->StringsSize) {
+        return "";
+    }
+
+    return Db->Strings + Offset;
+}
 
 
-CHAR16 *
-GetDeviceDesc( CHAR16 *Line )
+PCI_IDX_VENDOR *
+PciIndexFindVendor( PCI_DATABASE *Db,
+                    UINT16 VendorId )
 {
-    static CHAR16 DeviceDesc[LINE_MAX];
-    CHAR16 *s = Line;
-    CHAR16 *d = DeviceDesc;
-
-    s++;
-    while (*s++) {
-        if (*s == L' ' || *s == L'\t')
-           break;
+    UINTN Low = 0;
+    UINTN High = Db->VendorCount;
+    UINTN Mid;
+
+    while (Low < High) {
+        Mid = Low + (High - Low) / 2;
+        if (Db->Vendors[Mid].VendorId == VendorId) {
+            return &Db->Vendors[Mid];
+        } else if (Db->Vendors[Mid].VendorId < VendorId) {
+            Low = Mid + 1;
+        } else {
+            High = Mid;
+        }
     }
 
-    while (*s++) {
-        if (*s != L' ' && *s != L'\t')
-           break;
+    return NULL;
+}
+
+
+PCI_IDX_DEVICE *
+PciIndexFindDevice( PCI_DATABASE *Db,
+                    PCI_IDX_VENDOR *Vendor,
+                    UINT16 DeviceId )
+{
+    UINTN Low = Vendor->FirstDevice;
+    UINTN High = Low + Vendor->DeviceCount;
+    UINTN Mid;
+
+    if (High > Db->DeviceCount) {
+        return NULL;
     }
 
-    while (*s) {
-        *(d++) = *(s++);
+    while (Low < High) {
+        Mid = Low + (High - Low) / 2;
+        if (Db->Devices[Mid].DeviceId == DeviceId) {
+            return &Db->Devices[Mid];
+        } else if (Db->Devices[Mid].DeviceId < DeviceId) {
+            Low = Mid + 1;
+        } else {
+            High = Mid;
+        }
     }
-    *d = 0;
 
-    return DeviceDesc;
+    return NULL;
 }
 
 
-CHAR16 *
-GetVendorDesc( CHAR16 *Line )
+PCI_IDX_SUBSYSTEM *
+PciIndexFindSubsystem( PCI_DATABASE *Db,
+                       PCI_IDX_DEVICE *Device,
+                       UINT16 SubvendorId,
+                       UINT16 SubdeviceId )
 {
-    static CHAR16 VendorDesc[LINE_MAX];
-    CHAR16 *s = Line;
-    CHAR16 *d = VendorDesc;
+    PCI_IDX_SUBSYSTEM Key;
+    UINTN Low = Device->FirstSubsystem;
+    UINTN High = Low + Device->SubsystemCount;
+    UINTN Mid;
+    INTN  Result;
+
+    if (High > Db->SubsystemCount) {
+        return NULL;
+    }
 
-    while (*s++) {
-        if (*s == L' ' || *s == L'\t')
-            break;
+    Key.SubvendorId = SubvendorId;
+    Key.SubdeviceId = SubdeviceId;
+
+    while (Low < High) {
+        Mid = Low + (High - Low) / 2;
+        Result = CompareSubsystem( &Db->Subsystems[Mid], &Key );
+        if (Result == 0) {
+            return &Db->Subsystems[Mid];
+        } else if (Result < 0) {
+            Low = Mid + 1;
+        } else {
+            High = Mid;
+        }
     }
 
-    while (*s++) {
-        if (*s != L' ' && *s != L'\t')
-            break;
+    return NULL;
+}
+
+
+//
+// Search one level of the class hierarchy. Table holds TableCount entries
+// of which the slice First..First+Count belongs to the parent.
+//
+PCI_IDX_CLASS *
+PciIndexFindClass( PCI_IDX_CLASS *Table,
+                   UINTN TableCount,
+                   UINTN First,
+                   UINTN Count,
+                   UINT8 Id )
+{
+    UINTN Low = First;
+    UINTN High = First + Count;
+    UINTN Mid;
+
+    if (High > TableCount) {
+        return NULL;
     }
 
-    while (*s) {
-        *(d++) = *(s++);
+    while (Low < High) {
+        Mid = Low + (High - Low) / 2;
+        if (Table[Mid].Id == Id) {
+            return &Table[Mid];
+        } else if (Table[Mid].Id < Id) {
+            Low = Mid + 1;
+        } else {
+            High = Mid;
+        }
     }
-    *d = 0;
 
-    return VendorDesc;
+    return NULL;
 }
 
 
 //
-// Copyed from UDK2015 Source.
+// Print vendor and device names, followed by subsystem and class names on
+// continuation lines. Subsystem IDs are only meaningful for type 0 headers.
 //
-EFI_STATUS
-PciGetNextBusRange( EFI_ACPI_ADDRESS_SPACE_DESCRIPTOR **Descriptors,
-                    UINT16 *MinBus,
-                    UINT16 *MaxBus,
-                    BOOLEAN *IsEnd )
+BOOLEAN
+SearchPciIndex( PCI_DATABASE *Db,
+                PCI_DEVICE_RECORD *Record )
 {
-    *IsEnd = FALSE;
+    PCI_IDX_VENDOR *Vendor;
+    PCI_IDX_DEVICE *Device = NULL;
+    PCI_IDX_SUBSYSTEM *Subsystem;
+    PCI_IDX_CLASS *Class, *Subclass, *ProgIf;
+
+    Vendor = PciIndexFindVendor( Db, Record->VendorId );
+    if (Vendor != NULL) {
+        Print(L"     %a", PciIndexString( Db, Vendor->Name ));
+        Device = PciIndexFindDevice( Db, Vendor, Record->DeviceId );
+        if (Device != NULL) {
+            Print(L", %a", PciIndexString( Db, Device->Name ));
+        }
+    }
 
-    if ((*Descriptors) == NULL) {
-        *MinBus = 0;
-        *MaxBus = PCI_MAX_BUS;
-        return EFI_SUCCESS;
+    if (Device != NULL && (Record->HeaderType & HEADER_LAYOUT_CODE) == HEADER_TYPE_DEVICE) {
+        Subsystem = PciIndexFindSubsystem( Db, Device,
+                                           Record->SubsystemVendorId,
+                                           Record->SubsystemId );
+        if (Subsystem != NULL) {
+            Print(L"\n%s%a", NAME_INDENT, PciIndexString( Db, Subsystem->Name ));
+        }
     }
 
-    while ((*Descriptors)->Desc != ACPI_END_TAG_DESCRIPTOR) {
-        if ((*Descriptors)->ResType == ACPI_ADDRESS_SPACE_TYPE_BUS) {
-            *MinBus = (UINT16) (*Descriptors)->AddrRangeMin;
-            *MaxBus = (UINT16) (*Descriptors)->AddrRangeMax;
-            (*Descriptors)++;
-            return (EFI_SUCCESS);
+    Class = PciIndexFindClass( Db->Classes, Db->ClassCount, 0, Db->ClassCount,
+                               Record->ClassCode[2] );
+    if (Class == NULL) {
+        return (Device != NULL);
+    }
+    Print(L"\n%s%a", NAME_INDENT, PciIndexString( Db, Class->Name ));
+
+    Subclass = PciIndexFindClass( Db->Subclasses, Db->SubclassCount, Class->First, Class->Count,
+                                  Record->ClassCode[1] );
+    if (Subclass != NULL) {
+        Print(L", %a", PciIndexString( Db, Subclass->Name ));
+        ProgIf = PciIndexFindClass( Db->ProgIfs, Db->ProgIfCount, Subclass->First, Subclass->Count,
+                                    Record->ClassCode[0] );
+        if (ProgIf != NULL) {
+            Print(L", %a", PciIndexString( Db, ProgIf->Name ));
         }
+    }
+
+    return (Device != NULL);
+}
+
+
+//
+// Print PCI.ID database version string
+//
+VOID
+PrintPciDatabaseVersion( VOID )
+{
+    PCI_DATABASE Db;
 
-        (*Descriptors)++;
+    if (!EFI_ERROR(LoadPciDatabase( &Db ))) {
+        Print(L"Database Version: %a\n", PciIndexString( &Db, Db.Version ));
+        FreePciDatabase( &Db );
     }
+}
+
+
+//
+// Time a serial enumeration in a separate context so that the statistics
+// of the displayed one are not disturbed
+//
+UINT64
+TimeSerialScan( UINT32 Flags )
+{
+    PCI_ENUM_CONTEXT Serial;
+    EFI_STATUS Status;
+    UINT64 Ticks;
 
-    if ((*Descriptors)->Desc == ACPI_END_TAG_DESCRIPTOR) {
-        *IsEnd = TRUE;
+    if (EFI_ERROR(PciEnumInit( &Serial, Flags ))) {
+        return 0;
     }
 
-    return EFI_SUCCESS;
+    Ticks = AsmReadTsc();
+    Status = PciEnumScan( &Serial, FALSE );
+    Ticks = EFI_ERROR(Status) ? 0 : AsmReadTsc() - Ticks;
+
+    PciEnumFree( &Serial );
+
+    return Ticks;
+}
+
+
+//
+// Print one function, with names if a database is loaded. ConfigBuf is
+// only needed for the hex dump and capability list. Returns TRUE if the
+// function has a degraded PCI Express link.
+//
+BOOLEAN
+PrintPciDevice( PCI_ENUM_CONTEXT *Enum,
+                PCI_DEVICE_RECORD *Record,
+                PCI_DATABASE *Db,
+                UINT8 *ConfigBuf,
+                BOOLEAN Extended,
+                BOOLEAN Capabilities )
+{
+    BOOLEAN Degraded = FALSE;
+    UINTN ConfigSize;
+    UINTN Size;
+
+    Print(L" %02d     %04x     %04x     %04x     %04x", 
+          Record->Bus, Record->VendorId, Record->DeviceId, 
+          Record->SubsystemVendorId, Record->SubsystemId);
+
+    if (Db != NULL) {
+        SearchPciIndex( Db, Record );
+    }
+
+    Print(L"\n");
+
+    if (ConfigBuf == NULL) {
+        return FALSE;
+    }
+
+    // only the hex dump needs the whole extended space
+    ConfigSize = PciEnumConfigSize( Enum, Record );
+    Size = Extended ? ConfigSize : MIN( ConfigSize, PCI_ENUM_CONFIG_SIZE );
+    if (EFI_ERROR(PciEnumReadConfig( Enum, Record, 0, Size / sizeof(UINT32), (UINT32 *) ConfigBuf ))) {
+        return FALSE;
+    }
+
+    if (Capabilities) {
+        Degraded = PciPrintCapabilities( Enum, Record, ConfigBuf, Size, ConfigSize );
+        if (!Extended) {
+            Print(L"\n");
+        }
+    }
+    if (Extended) {
+        PciDumpConfigSpace( ConfigBuf, Size );
+    }
+
+    return Degraded;
 }
 
 
 //
-// Copyed from UDK2015 Source. 
+// Capture the enumerated functions together with their base address
+// registers. BARs are not part of the device record and are read here.
 //
 EFI_STATUS
-PciGetProtocolAndResource( EFI_HANDLE Handle,
-                           EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL **IoDev,
-                           EFI_ACPI_ADDRESS_SPACE_DESCRIPTOR **Descriptors )
+BuildSnapshot( PCI_ENUM_CONTEXT *Enum,
+               PCI_SNAPSHOT_ENTRY **Entries )
 {
+    PCI_SNAPSHOT_ENTRY *Entry;
+    UINTN BarCount;
+
+    *Entries = AllocateZeroPool( (Enum->DeviceCount + 1) * sizeof(PCI_SNAPSHOT_ENTRY) );
+    if (*Entries == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    for (UINTN Index = 0; Index < Enum->DeviceCount; Index++) {
+        Entry = &(*Entries)[Index];
+        CopyMem( &Entry->Record, &Enum->Devices[Index], sizeof(PCI_DEVICE_RECORD) );
+
+        switch (Entry->Record.HeaderType & HEADER_LAYOUT_CODE) {
+            case HEADER_TYPE_DEVICE:             BarCount = 6; break;
+            case HEADER_TYPE_PCI_TO_PCI_BRIDGE:  BarCount = 2; break;
+            default:                             BarCount = 0; break;
+        }
+        if (BarCount > 0) {
+            PciEnumReadConfig( Enum, &Entry->Record, PCI_BASE_ADDRESSREG_OFFSET, BarCount, Entry->Bar );
+        }
+    }
+
+    return EFI_SUCCESS;
+}
+
+
+EFI_STATUS
+SaveSnapshot( CHAR16 *FileName,
+              PCI_SNAPSHOT_ENTRY *Entries,
+              UINTN EntryCount )
+{
+    SHELL_FILE_HANDLE FileHandle = (SHELL_FILE_HANDLE)NULL;
+    PCI_SNAPSHOT_HEADER Header;
     EFI_STATUS Status;
+    UINTN Size;
+
+    // replace, rather than overwrite, an existing snapshot
+    Status = ShellOpenFileByName( FileName,
+                                  &FileHandle,
+                                  EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE,
+                                  0 );
+    if (!EFI_ERROR(Status)) {
+        Status = ShellDeleteFile( &FileHandle );
+        if (EFI_ERROR(Status)) {
+            return Status;
+        }
+    }
 
-    Status = gBS->HandleProtocol( Handle,
-                                  &gEfiPciRootBridgeIoProtocolGuid,
-                                  (VOID**)IoDev );
-    if (EFI_ERROR (Status)) {
+    Status = ShellOpenFileByName( FileName,
+                                  &FileHandle,
+                                  EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE,
+                                  0 );
+    if (EFI_ERROR(Status)) {
         return Status;
     }
 
-    Status = (*IoDev)->Configuration ( *IoDev,
-                                       (VOID**)Descriptors );
-    if (Status == EFI_UNSUPPORTED) {
-        *Descriptors = NULL;
-        return EFI_SUCCESS;
+    ZeroMem( &Header, sizeof(Header) );
+    Header.Signature  = PCI_SNAPSHOT_SIGNATURE;
+    Header.Version    = PCI_SNAPSHOT_VERSION;
+    Header.EntrySize  = sizeof(PCI_SNAPSHOT_ENTRY);
+    Header.EntryCount = (UINT32) EntryCount;
+
+    Size = sizeof(Header);
+    Status = ShellWriteFile( FileHandle, &Size, &Header );
+    if (!EFI_ERROR(Status)) {
+        Size = EntryCount * sizeof(PCI_SNAPSHOT_ENTRY);
+        Status = ShellWriteFile( FileHandle, &Size, Entries );
     }
 
+    ShellCloseFile( &FileHandle );
+
     return Status;
 }
 
 
-VOID
-LowerCaseStr( CHAR16 *Str )
+//
+// Read a snapshot. Entries points into Buffer, which the caller frees.
+//
+EFI_STATUS
+LoadSnapshot( CHAR16 *FileName,
+              UINT8 **Buffer,
+              PCI_SNAPSHOT_ENTRY **Entries,
+              UINTN *EntryCount )
 {
-    for (int i = 0; Str[i] != L'\0'; i++) {
-        if (Str[i] >= L'A' && Str[i] <= L'Z') {
-            Str[i] -= (CHAR16)(L'A' - L'a');
-        }
+    PCI_SNAPSHOT_HEADER *Header;
+    EFI_STATUS Status;
+    UINTN BufferSize;
+
+    // the file named, as for --save, not one found on the shell path
+    Status = ReadWholeFile( FileName, Buffer, &BufferSize, 0 );
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+
+    Header = (PCI_SNAPSHOT_HEADER *) *Buffer;
+    if (BufferSize < sizeof(PCI_SNAPSHOT_HEADER) ||
+        Header->Signature != PCI_SNAPSHOT_SIGNATURE ||
+        Header->Version != PCI_SNAPSHOT_VERSION ||
+        Header->EntrySize != sizeof(PCI_SNAPSHOT_ENTRY) ||
+        Header->EntryCount > (BufferSize - sizeof(PCI_SNAPSHOT_HEADER)) / sizeof(PCI_SNAPSHOT_ENTRY)) {
+        FreePool( *Buffer );
+        *Buffer = NULL;
+        return EFI_INCOMPATIBLE_VERSION;
     }
+
+    *Entries = (PCI_SNAPSHOT_ENTRY *)(Header + 1);
+    *EntryCount = Header->EntryCount;
+
+    return EFI_SUCCESS;
 }
 
 
+//
+// Whether a function looks the same in two snapshots. The root bridge
+// index is left out as it follows handle order, which can change between
+// boots.
+//
 BOOLEAN
-SearchPciData( SHELL_FILE_HANDLE FileHandle,
-               CHAR16 *ReadLine,
-               UINTN VendorID, 
-               UINTN DeviceID )
+SameSnapshotEntry( PCI_SNAPSHOT_ENTRY *Left,
+                   PCI_SNAPSHOT_ENTRY *Right )
 {
-    EFI_STATUS Status = EFI_SUCCESS;
-    BOOLEAN Found = FALSE;
-    BOOLEAN VendorFound = FALSE;
-    BOOLEAN Ascii = TRUE;
-    UINTN   Size = LINE_MAX;
-    CHAR16  Vendor[5];
-    CHAR16  Device[5];
-
-    UnicodeSPrint(Vendor, sizeof(Vendor), L"%04x", VendorID);
-    LowerCaseStr(Vendor);
-    UnicodeSPrint(Device, sizeof(Device), L"%04x", DeviceID);
-    LowerCaseStr(Device);
-
-    ShellSetFilePosition(FileHandle, 0);
-
-    // Read file line by line
-    for (;!ShellFileHandleEof(FileHandle); Size = LINE_MAX) {
-        Status = ShellFileHandleReadLine( FileHandle, ReadLine, &Size, TRUE, &Ascii );
-        if (Status == EFI_BUFFER_TOO_SMALL) {
-            Status = EFI_SUCCESS;
-        } else if (EFI_ERROR(Status)) {
-            break;
-        }
+    return Left->Record.VendorId == Right->Record.VendorId &&
+           Left->Record.DeviceId == Right->Record.DeviceId &&
+           CompareMem( Left->Record.ClassCode, Right->Record.ClassCode, sizeof(Left->Record.ClassCode) ) == 0 &&
+           Left->Record.RevisionId == Right->Record.RevisionId &&
+           Left->Record.HeaderType == Right->Record.HeaderType &&
+           Left->Record.SecondaryBus == Right->Record.SecondaryBus &&
+           Left->Record.SubordinateBus == Right->Record.SubordinateBus &&
+           Left->Record.SubsystemVendorId == Right->Record.SubsystemVendorId &&
+           Left->Record.SubsystemId == Right->Record.SubsystemId &&
+           CompareMem( Left->Bar, Right->Bar, sizeof(Left->Bar) ) == 0;
+}
 
-        // Skip comment and empty lines
-        if (ReadLine[0] == L'#' || ReadLine[0] == L' ' || 
-            ReadLine[0] == L'\n' || ReadLine[0] == L'\r') {
-            continue;
-        }
- 
-        if (StrnCmp(ReadLine, Vendor, 4) == 0) {
-            Print(L"     %s", GetVendorDesc(ReadLine));
-            VendorFound = TRUE;
-        } else if (VendorFound && StrnCmp(&ReadLine[1], Device, 4) == 0) {
-            Print(L", %s", GetDeviceDesc(ReadLine));
-            Found = TRUE;
-            break;
-        } else if (VendorFound && (StrnCmp(ReadLine, L"\t", 1) != 0) && 
-                  (StrnCmp(ReadLine, L"\t\t", 2) != 0)) {
-            break;
-        }
+
+INTN
+CompareSnapshotAddress( PCI_SNAPSHOT_ENTRY *Left,
+                        PCI_SNAPSHOT_ENTRY *Right )
+{
+    if (Left->Record.Segment != Right->Record.Segment) {
+        return (Left->Record.Segment < Right->Record.Segment) ? -1 : 1;
+    }
+    if (Left->Record.Bus != Right->Record.Bus) {
+        return (INTN)Left->Record.Bus - (INTN)Right->Record.Bus;
+    }
+    if (Left->Record.Device != Right->Record.Device) {
+        return (INTN)Left->Record.Device - (INTN)Right->Record.Device;
     }
 
-    return Found;
-} 
+    return (INTN)Left->Record.Function - (INTN)Right->Record.Function;
+}
 
 
-//
-// Print PCI.ID database version string
-//
 VOID
-PrintPciDatabaseVersion( VOID )
+PrintSnapshotEntry( CHAR16 Marker,
+                    PCI_SNAPSHOT_ENTRY *Entry,
+                    PCI_DATABASE *Db )
 {
-    SHELL_FILE_HANDLE InFileHandle = (SHELL_FILE_HANDLE)NULL;
-    EFI_STATUS Status = EFI_SUCCESS;
-    BOOLEAN Ascii = TRUE;
-    CHAR16 *FullFileName = (CHAR16 *)NULL;
-    CHAR16 FileName[] = PCIDATABASE;
-    CHAR16 *ReadLine = (CHAR16 *)NULL;
-    CHAR16 *Sptr, *Vptr;
-    CHAR16 Version[12];
-    UINTN Size = LINE_MAX;
+    Print(L"%c%02d:%02d.%d  %04x     %04x     %04x     %04x", Marker,
+          Entry->Record.Bus, Entry->Record.Device, Entry->Record.Function,
+          Entry->Record.VendorId, Entry->Record.DeviceId,
+          Entry->Record.SubsystemVendorId, Entry->Record.SubsystemId);
 
-    FullFileName = ShellFindFilePath( FileName );
-    if (FullFileName == NULL) {
-        return;
+    if (Db != NULL) {
+        SearchPciIndex( Db, &Entry->Record );
     }
+    Print(L"\n");
 
-    // open database file
-    Status = ShellOpenFileByName( FullFileName, 
-                                  &InFileHandle,
-                                  EFI_FILE_MODE_READ,
-                                  0 );
-    if (EFI_ERROR(Status)) {
-        return;
+    Print(L"           Class %02x%02x%02x  BARs", Entry->Record.ClassCode[2],
+          Entry->Record.ClassCode[1], Entry->Record.ClassCode[0]);
+    for (UINTN Index = 0; Index < PCI_SNAPSHOT_BARS; Index++) {
+        Print(L" %08x", Entry->Bar[Index]);
     }
+    Print(L"\n");
+}
 
-    // allocate a buffer to read lines into
-    ReadLine = AllocateZeroPool( Size );
-    if (ReadLine == NULL) {
-        return;
-    }
 
-    // look for database version string 
-    for (;!ShellFileHandleEof(InFileHandle); Size = LINE_MAX) {
-        Status = ShellFileHandleReadLine( InFileHandle, ReadLine, &Size, TRUE, &Ascii );
-        if (Status == EFI_BUFFER_TOO_SMALL) {
-            Status = EFI_SUCCESS;
-        } else if (EFI_ERROR(Status)) {
-            break;
+//
+// Walk two snapshots, both sorted by address, and count (and if Report is
+// set print) the functions added, removed or changed. Returns the total.
+//
+UINTN
+DiffSnapshot( PCI_SNAPSHOT_ENTRY *Old,
+              UINTN OldCount,
+              PCI_SNAPSHOT_ENTRY *New,
+              UINTN NewCount,
+              PCI_DATABASE *Db,
+              BOOLEAN Report )
+{
+    UINTN i = 0, j = 0;
+    UINTN Added = 0, Removed = 0, Changed = 0;
+    INTN Result;
+
+    while (i < OldCount || j < NewCount) {
+        if (i == OldCount) {
+            Result = 1;
+        } else if (j == NewCount) {
+            Result = -1;
+        } else {
+            Result = CompareSnapshotAddress( &Old[i], &New[j] );
         }
 
-        if (ReadLine[0] == L'#' ) {
-            if ((Sptr = StrStr( ReadLine, L"Version: ")) != NULL) {
-                Sptr += 9;
-                Vptr = &Version[0];  
-                while (*Sptr  && *Sptr != L'\n' && *Sptr != L'\r') {
-                    *Vptr++ = *Sptr++;
+        if (Result < 0) {
+            Removed++;
+            if (Report) {
+                PrintSnapshotEntry( L'-', &Old[i], Db );
+            }
+            i++;
+        } else if (Result > 0) {
+            Added++;
+            if (Report) {
+                PrintSnapshotEntry( L'+', &New[j], Db );
+            }
+            j++;
+        } else {
+            if (!SameSnapshotEntry( &Old[i], &New[j] )) {
+                Changed++;
+                if (Report) {
+                    PrintSnapshotEntry( L'<', &Old[i], Db );
+                    PrintSnapshotEntry( L'>', &New[j], Db );
                 }
-                *Vptr = L'\0';
-                Print(L"Database Version: %s\n", Version);
-                break;
             }
+            i++;
+            j++;
         }
+    }
 
-        if (ReadLine[0] == L' ' || ReadLine[0] == L'\n' || ReadLine[0] == L'\r') {
-            break;
-        }
+    if (Report) {
+        Print(L"\n");
+        Print(L"%d added, %d removed, %d changed\n", Added, Removed, Changed);
     }
- 
-    ShellCloseFile( &InFileHandle );
-    FreePool( ReadLine );
 
-    return;
+    return Added + Removed + Changed;
 }
 
 
@@ -310,7 +1473,9 @@ Usage( BOOLEAN ErrorMsg )
         Print(L"ERROR: Unknown option(s).\n");
     }
 
-    Print(L"Usage: ShowPCIx [ -n | --nodatabase ]\n");
+    Print(L"Usage: ShowPCIx [ -n | --nodatabase ] [ -t | --topology ] [ -x | --extended ]\n");
+    Print(L"                [ -c | --capabilities ] [ -p | --parallel ] [ --noecam ] [ --stats ]\n");
+    Print(L"                [ --save <file> ] [ --diff <file> ]\n");
     Print(L"       ShowPCIx [ -V | --version ]\n");
 }
 
@@ -320,38 +1485,63 @@ EFIAPI
 ShellAppMain( UINTN Argc, 
               CHAR16 **Argv )
 {
-    EFI_GUID gEfiPciEnumerationCompleteProtocolGuid = EFI_PCI_EMUMERATION_COMPLETE_GUID;  
-    EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *IoDev;
-    EFI_ACPI_ADDRESS_SPACE_DESCRIPTOR *Descriptors;
-    SHELL_FILE_HANDLE InFileHandle = (SHELL_FILE_HANDLE)NULL;
-    PCI_DEVICE_HEADER_TYPE_REGION *DeviceHeader;
-    PCI_DEVICE_INDEPENDENT_REGION PciHeader;
-    PCI_CONFIG_SPACE ConfigSpace;
+    PCI_ENUM_CONTEXT Enum;
+    PCI_DEVICE_RECORD *Record;
+    PCI_DATABASE Db;
     EFI_STATUS Status = EFI_SUCCESS;
-    EFI_HANDLE *HandleBuf;
-    BOOLEAN IsEnd; 
     BOOLEAN NoDatabase = FALSE;
-    CHAR16 *FullFileName = (CHAR16 *)NULL;
-    CHAR16 FileName[] = PCIDATABASE;
-    CHAR16 *ReadLine = (CHAR16 *)NULL;
-    UINT64 Address;
-    UINT16 MinBus, MaxBus;
-    UINTN HandleBufSize;
-    UINTN HandleCount;
-    UINTN Size = LINE_MAX;
-    VOID *Interface;
+    BOOLEAN UseDatabase = FALSE;
+    BOOLEAN Stats = FALSE;
+    BOOLEAN Extended = FALSE;
+    BOOLEAN Capabilities = FALSE;
+    UINT32 Flags = 0;
+    UINT8 *ConfigBuf = NULL;
+    UINTN Degraded = 0;
+    UINT64 LoadTicks = 0;
+    UINT64 ScanTicks = 0;
+    UINT64 SerialTicks = 0;
+    UINT64 Frequency = 0;
+    CHAR16 *SaveFile = NULL;
+    CHAR16 *DiffFile = NULL;
+    PCI_SNAPSHOT_ENTRY *Snapshot = NULL;
+    PCI_SNAPSHOT_ENTRY *OldSnapshot;
+    UINT8 *OldBuffer = NULL;
+    UINTN OldCount;
+
+    ZeroMem( &Db, sizeof(Db) );
+    ZeroMem( &Enum, sizeof(Enum) );
   
-    if (Argc == 2) {
-        if (!StrCmp(Argv[1], L"--version") ||
-            !StrCmp(Argv[1], L"-V")) {
+    for (int i = 1; i < Argc; i++) {
+        if (!StrCmp(Argv[i], L"--version") ||
+            !StrCmp(Argv[i], L"-V")) {
             Print(L"Version: %s\n", UTILITY_VERSION);
             PrintPciDatabaseVersion();
             return Status;
-        } else if (!StrCmp(Argv[1], L"--nodatabase") ||
-            !StrCmp(Argv[1], L"-n")) {
+        } else if (!StrCmp(Argv[i], L"--nodatabase") ||
+            !StrCmp(Argv[i], L"-n")) {
             NoDatabase = TRUE;
-        } else if (!StrCmp(Argv[1], L"--help") ||
-            !StrCmp(Argv[1], L"-h")) {
+        } else if (!StrCmp(Argv[i], L"--stats")) {
+            Stats = TRUE;
+        } else if (!StrCmp(Argv[i], L"--noecam")) {
+            Flags |= PCI_ENUM_NO_ECAM;
+        } else if (!StrCmp(Argv[i], L"--topology") ||
+            !StrCmp(Argv[i], L"-t")) {
+            Flags |= PCI_ENUM_TOPOLOGY;
+        } else if (!StrCmp(Argv[i], L"--extended") ||
+            !StrCmp(Argv[i], L"-x")) {
+            Extended = TRUE;
+        } else if (!StrCmp(Argv[i], L"--capabilities") ||
+            !StrCmp(Argv[i], L"-c")) {
+            Capabilities = TRUE;
+        } else if (!StrCmp(Argv[i], L"--parallel") ||
+            !StrCmp(Argv[i], L"-p")) {
+            Flags |= PCI_ENUM_PARALLEL;
+        } else if (!StrCmp(Argv[i], L"--save") && i + 1 < Argc) {
+            SaveFile = Argv[++i];
+        } else if (!StrCmp(Argv[i], L"--diff") && i + 1 < Argc) {
+            DiffFile = Argv[++i];
+        } else if (!StrCmp(Argv[i], L"--help") ||
+            !StrCmp(Argv[i], L"-h")) {
             Usage(FALSE);
             return Status;
         } else {
@@ -359,180 +1549,178 @@ ShellAppMain( UINTN Argc,
             return Status;
         }
     }
-    if (Argc > 2) {
-        Usage(TRUE);
-        return Status;
-    }
 
-    Status = gBS->LocateProtocol( &gEfiPciEnumerationCompleteProtocolGuid,
-                                  NULL,
-                                  &Interface );
-    if (EFI_ERROR(Status)) {
+    Status = PciEnumInit( &Enum, Flags );
+    if (Status == EFI_NOT_READY) {
         Print(L"ERROR: Could not find PCI enumeration protocol\n");
         return Status;
+    } else if (EFI_ERROR(Status)) {
+        Print(L"ERROR: Failed to find any PCI handles\n");
+        return Status;
     }
 
-    HandleBufSize = sizeof(EFI_HANDLE);
-    HandleBuf = (EFI_HANDLE *) AllocateZeroPool( HandleBufSize );
-    if (HandleBuf == NULL) {
-        Print(L"ERROR: Out of memory resources\n");
-        goto Done;
+    // build the lookup tables once, before any devices are named; snapshot
+    // operations only name changed functions and load them on demand
+    if (NoDatabase == FALSE && SaveFile == NULL && DiffFile == NULL) {
+        LoadTicks = AsmReadTsc();
+        Status = LoadPciDatabase( &Db );
+        LoadTicks = AsmReadTsc() - LoadTicks;
+        if (Status == EFI_NOT_FOUND) {
+            Print(L"ERROR: Could not find %s\n", PCIDATABASE);
+            goto Done;
+        } else if (EFI_ERROR(Status)) {
+            Print(L"ERROR: Could not load %s [%r]\n", PCIDATABASE, Status);
+            goto Done;
+        }
+        UseDatabase = TRUE;
     }
 
-    Status = gBS->LocateHandle( ByProtocol,
-                                &gEfiPciRootBridgeIoProtocolGuid,
-                                NULL,
-                                &HandleBufSize,
-                                HandleBuf );
-
-    if (Status == EFI_BUFFER_TOO_SMALL) {
-        HandleBuf = ReallocatePool( sizeof (EFI_HANDLE), 
-                                    HandleBufSize, 
-                                    HandleBuf );
-        if (HandleBuf == NULL) {
+    if (Extended || Capabilities) {
+        ConfigBuf = AllocatePool( PCI_ENUM_EXTENDED_SIZE );
+        if (ConfigBuf == NULL) {
             Print(L"ERROR: Out of memory resources\n");
+            Status = EFI_OUT_OF_RESOURCES;
             goto Done;
         }
-
-        Status = gBS->LocateHandle( ByProtocol,
-                                    &gEfiPciRootBridgeIoProtocolGuid,
-                                    NULL,
-                                    &HandleBufSize,
-                                    HandleBuf );
     }
 
-    if (EFI_ERROR (Status)) {
-        Print(L"ERROR: Failed to find any PCI handles\n");
+    ScanTicks = AsmReadTsc();
+    Status = PciEnumScan( &Enum, FALSE );
+    ScanTicks = AsmReadTsc() - ScanTicks;
+    if (EFI_ERROR(Status)) {
+        Print(L"ERROR: Enumerating PCI devices [%r]\n", Status);
         goto Done;
     }
 
-    if (NoDatabase == FALSE) {
-        FullFileName = ShellFindFilePath( FileName );
-        if (FullFileName == NULL) {
-            Print(L"ERROR: Could not find %s\n", FileName);
-            Status = EFI_NOT_FOUND;
+    // time the same enumeration on the BSP alone for comparison
+    if ((Flags & PCI_ENUM_PARALLEL) && Stats) {
+        SerialTicks = TimeSerialScan( Flags & ~PCI_ENUM_PARALLEL );
+    }
+
+    if (SaveFile != NULL || DiffFile != NULL) {
+        Status = BuildSnapshot( &Enum, &Snapshot );
+        if (EFI_ERROR(Status)) {
+            Print(L"ERROR: Out of memory resources\n");
             goto Done;
         }
+    }
 
-        // open the file
-        Status = ShellOpenFileByName( FullFileName, 
-                                      &InFileHandle,
-                                      EFI_FILE_MODE_READ,
-                                      0 );
+    // compare before saving so that the same file can be diffed and updated
+    if (DiffFile != NULL) {
+        Status = LoadSnapshot( DiffFile, &OldBuffer, &OldSnapshot, &OldCount );
         if (EFI_ERROR(Status)) {
-            Print(L"ERROR: Could not open %s\n", FileName);
+            Print(L"ERROR: Could not load snapshot %s [%r]\n", DiffFile, Status);
             goto Done;
         }
 
-        // allocate a buffer to read lines into
-        ReadLine = AllocateZeroPool( Size );
-        if (ReadLine == NULL) {
-            Print(L"ERROR: Could not allocate memory\n");
-            Status = EFI_OUT_OF_RESOURCES;
-            goto Done;
+        if (DiffSnapshot( OldSnapshot, OldCount, Snapshot, Enum.DeviceCount, NULL, FALSE ) == 0) {
+            Print(L"No changes since %s (%d functions)\n", DiffFile, Enum.DeviceCount);
+        } else {
+            if (NoDatabase == FALSE && !EFI_ERROR(LoadPciDatabase( &Db ))) {
+                UseDatabase = TRUE;
+            }
+            Print(L"\n");
+            Print(L" BDF      Vendor   Device  Subvendor SVDevice\n");
+            Print(L"\n");
+            DiffSnapshot( OldSnapshot, OldCount, Snapshot, Enum.DeviceCount,
+                          UseDatabase ? &Db : NULL, TRUE );
         }
     }
 
-    HandleCount = HandleBufSize / sizeof (EFI_HANDLE);
-
-    for (UINT16 Index = 0; Index < HandleCount; Index++) {
-        Status = PciGetProtocolAndResource( HandleBuf[Index],
-                                            &IoDev,
-                                            &Descriptors );
+    if (SaveFile != NULL) {
+        Status = SaveSnapshot( SaveFile, Snapshot, Enum.DeviceCount );
         if (EFI_ERROR(Status)) {
-            Print(L"ERROR: PciGetProtocolAndResource [%d]\n, Status");
+            Print(L"ERROR: Could not write snapshot %s [%r]\n", SaveFile, Status);
             goto Done;
         }
-  
-        while(1) {
-            Status = PciGetNextBusRange( &Descriptors, &MinBus, &MaxBus, &IsEnd );
-            if (EFI_ERROR(Status)) {
-                Print(L"ERROR: Retrieving PCI bus range [%d]\n", Status);
-                goto Done;
-            }
+        Print(L"Saved %d functions to %s\n", Enum.DeviceCount, SaveFile);
+    }
 
-            if ( IsEnd ) {
-                break;
-            }
+    if (SaveFile != NULL || DiffFile != NULL) {
+        goto Done;
+    }
 
+    for (UINTN Index = 0; Index < Enum.DeviceCount; Index++) {
+        Record = &Enum.Devices[Index];
+        if (Index == 0 || Record->RootBridge != Enum.Devices[Index - 1].RootBridge) {
             Print(L"\n");
             Print(L"Bus    Vendor   Device  Subvendor SVDevice\n");
             Print(L"\n");
-
-            for ( UINT16 Bus = MinBus; Bus <= MaxBus; Bus++ ) {
-                for ( UINT16 Device = 0; Device <= PCI_MAX_DEVICE; Device++ ) {
-                    for ( UINT16 Func = 0; Func <= PCI_MAX_FUNC; Func++ ) {
-                        Address = CALC_EFI_PCI_ADDRESS( Bus, Device, Func, 0 );
-
-                        Status = IoDev->Pci.Read( IoDev,
-                                                  EfiPciWidthUint8,
-                                                  Address,
-                                                  sizeof(ConfigSpace),
-                                                  &ConfigSpace );
-
-                        DeviceHeader = (PCI_DEVICE_HEADER_TYPE_REGION *) &(ConfigSpace.NonCommon.Device);
-
-                        Status = IoDev->Pci.Read( IoDev,
-                                                  EfiPciWidthUint16,
-                                                  Address,
-                                                  1,
-                                                  &PciHeader.VendorId );
-
-                        if ( PciHeader.VendorId == 0xffff && Func == 0 ) {
-                            break;
-                        }
-
-                        if ( PciHeader.VendorId != 0xffff ) {
-                           Status = IoDev->Pci.Read( IoDev,
-                                                     EfiPciWidthUint32,
-                                                     Address,
-                                                     sizeof(PciHeader)/sizeof(UINT32),
-                                                     &PciHeader );
-
-                            Print(L" %02d     %04x     %04x     %04x     %04x", 
-                                  Bus, PciHeader.VendorId, PciHeader.DeviceId, 
-                                  DeviceHeader->SubsystemVendorID, DeviceHeader->SubsystemID);
-
-                            if (NoDatabase == FALSE) {
-                                SearchPciData( InFileHandle, 
-                                               ReadLine, 
-                                               PciHeader.VendorId, 
-                                               PciHeader.DeviceId );
-                            }
-
-                            Print(L"\n");
-
-                            if ( Func == 0 && 
-                                 ((PciHeader.HeaderType & HEADER_TYPE_MULTI_FUNCTION) == 0x00) ) {
-                               break;
-                            }
-                        }
-                    }
-                }
-            }
-
-            if ( Descriptors == NULL ) {
-                break;
-            }
+        }
+        if (PrintPciDevice( &Enum, Record, UseDatabase ? &Db : NULL,
+                            ConfigBuf, Extended, Capabilities )) {
+            Degraded++;
         }
     }
 
     Print(L"\n");
 
-Done:
-    if ( HandleBuf != NULL ) {
-        FreePool( HandleBuf );
+    if (Capabilities) {
+        Print(L"Degraded PCI Express links: %d\n", Degraded);
+        Print(L"\n");
+    }
+
+    if (Flags & PCI_ENUM_TOPOLOGY) {
+        Print(L"Topology scan: %d buses, %d probes, %d probes skipped versus scanning every bus\n",
+              Enum.BusesScanned, Enum.Probes, Enum.ProbesSkipped);
+        Print(L"\n");
     }
-    if ( NoDatabase == FALSE ) {
-        if ( ReadLine != NULL ) {
-            FreePool( ReadLine );
+
+    // calibrated once, each calibration stalls for 10 ms
+    if ((Flags & PCI_ENUM_PARALLEL) || Stats) {
+        Frequency = TscFrequency();
+    }
+
+    if (Flags & PCI_ENUM_PARALLEL) {
+        if (Enum.ApWorkers == 0) {
+            Print(L"Parallel scan: not possible (no APs or no ECAM), scanned on the BSP\n");
+        } else {
+            Print(L"Parallel scan: %d APs, %ld us", Enum.ApWorkers,
+                  TscToMicroseconds( ScanTicks, Frequency ));
+            if (Stats) {
+                Print(L"; serial scan %ld us", TscToMicroseconds( SerialTicks, Frequency ));
+            }
+            if (ScanTicks > 0 && SerialTicks > 0) {
+                Print(L"; speedup %ld.%02ldx", SerialTicks / ScanTicks,
+                      (SerialTicks * 100 / ScanTicks) % 100);
+            }
+            Print(L"\n");
         }
-        if ( FullFileName != NULL ) {
-            FreePool( FullFileName );
+        Print(L"\n");
+    }
+
+    if (Stats) {
+        if (Enum.EcamWindowCount > 0) {
+            Print(L"Config:       ECAM (%d MCFG windows)\n", Enum.EcamWindowCount);
+        } else {
+            Print(L"Config:       Root Bridge I/O\n");
         }
-        if ( InFileHandle != NULL ) {
-            ShellCloseFile( &InFileHandle );
+        Print(L"Config reads: %d dwords in %d calls\n", Enum.ConfigDwords, Enum.ConfigCalls);
+        Print(L"Devices:      %d functions (%d bytes of records)\n",
+              Enum.DeviceCount, Enum.DeviceCount * sizeof(PCI_DEVICE_RECORD));
+        if (UseDatabase) {
+            Print(L"Database:     %s (%d vendors, %d devices, %d subsystems, %d classes)\n",
+                  Db.Text ? PCIDATABASE : PCIINDEX, Db.VendorCount, Db.DeviceCount,
+                  Db.SubsystemCount, Db.ClassCount);
+            Print(L"Parse time:   %ld us\n", TscToMicroseconds( LoadTicks, Frequency ));
+            Print(L"Index size:   %d bytes (file buffer %d bytes)\n", Db.IndexSize, Db.BufferSize);
         }
+        Print(L"\n");
+    }
+
+Done:
+    PciEnumFree( &Enum );
+    if ( UseDatabase ) {
+        FreePciDatabase( &Db );
+    }
+    if ( ConfigBuf != NULL ) {
+        FreePool( ConfigBuf );
+    }
+    if ( Snapshot != NULL ) {
+        FreePool( Snapshot );
+    }
+    if ( OldBuffer != NULL ) {
+        FreePool( OldBuffer );
     }
 
     return Status;
@@ -0,0 +1,193 @@
+#!/usr/bin/env python3
+#
+#  Copyright (c) 2019   Finnbarr P. Murphy.   All rights reserved.
+#
+#  Compile the text-based pci.ids database into the compact binary index
+#  (pci.idx) used by ShowPCIx.
+#
+#  License: BSD 2 clause License
+#
+#  Usage: pciids2idx.py [pci.ids] [pci.idx]
+#
+#  Layout (all fields little-endian, see PCI_IDX_* in ShowPCIx.c):
+#
+#     header
+#     vendor table    sorted by vendor ID
+#     device table    sorted by vendor ID then device ID, each vendor's
+#                     devices are contiguous
+#     string pool     NUL-terminated UTF-8 names, duplicates shared
+#     subsystem table sorted by subvendor ID then subdevice ID, each
+#                     device's subsystems are contiguous
+#     class table     base classes, each pointing at its subclasses
+#     subclass table  subclasses, each pointing at its programming interfaces
+#     prog-if table   programming interfaces
+#
+
+import struct
+import sys
+
+PCI_IDX_SIGNATURE = b'PCIX'
+PCI_IDX_VERSION   = 2
+
+HEADER    = struct.Struct('<4sHHIIIIIIIIIIIIIII')
+VENDOR    = struct.Struct('<HHIII')
+DEVICE    = struct.Struct('<HHIII')
+SUBSYSTEM = struct.Struct('<HHI')
+CLASS     = struct.Struct('<BBHIII')
+
+
+class StringPool:
+    def __init__(self):
+        self.data = bytearray()
+        self.offsets = {}
+
+    def add(self, s):
+        b = s.encode('utf-8')
+        if b not in self.offsets:
+            self.offsets[b] = len(self.data)
+            self.data += b + b'\0'
+        return self.offsets[b]
+
+
+def split_id(text):
+    ident, _, name = text.partition(' ')
+    return int(ident, 16), name.strip()
+
+
+def parse(lines):
+    version = ''
+    vendors = {}
+    classes = {}
+    vendor = None
+    device = None
+    cls = None
+    subclass = None
+    in_classes = False
+
+    for line in lines:
+        line = line.rstrip('\r\n')
+        if line.startswith('#'):
+            if not version and 'Version:' in line:
+                version = line.split('Version:', 1)[1].strip()
+            continue
+        if not line.strip():
+            continue
+        if line.startswith('C '):
+            # device class section follows the vendor section
+            in_classes = True
+            ident, name = split_id(line[2:])
+            cls = classes.setdefault(ident, [name, {}])
+            subclass = None
+            continue
+        if in_classes:
+            if line.startswith('\t\t'):
+                if subclass is not None:
+                    ident, name = split_id(line[2:])
+                    subclass[1].setdefault(ident, name)
+            elif line.startswith('\t'):
+                if cls is not None:
+                    ident, name = split_id(line[1:])
+                    subclass = cls[1].setdefault(ident, [name, {}])
+            else:
+                # unknown section, e.g. future additions
+                cls = subclass = None
+            continue
+        if line.startswith('\t\t'):
+            if device is not None:
+                subvendor, rest = line[2:].split(None, 1)
+                ident, name = split_id(rest)
+                device[1].setdefault((int(subvendor, 16), ident), name)
+            continue
+        if line.startswith('\t'):
+            if vendor is not None:
+                ident, name = split_id(line[1:])
+                device = vendor[1].setdefault(ident, [name, {}])
+            continue
+        ident, name = split_id(line)
+        vendor = vendors.setdefault(ident, [name, {}])
+        device = None
+
+    return version, vendors, classes
+
+
+def build(version, vendors, classes):
+    pool = StringPool()
+    vendor_table = bytearray()
+    device_table = bytearray()
+    subsystem_table = bytearray()
+    class_table = bytearray()
+    subclass_table = bytearray()
+    progif_table = bytearray()
+    device_count = 0
+    subsystem_count = 0
+    subclass_count = 0
+    progif_count = 0
+
+    version_offset = pool.add(version)
+    for vid in sorted(vendors):
+        name, devices = vendors[vid]
+        vendor_table += VENDOR.pack(vid, 0, pool.add(name),
+                                    device_count, len(devices))
+        for did in sorted(devices):
+            name, subsystems = devices[did]
+            device_table += DEVICE.pack(did, 0, pool.add(name),
+                                        subsystem_count, len(subsystems))
+            device_count += 1
+            for svid, sdid in sorted(subsystems):
+                subsystem_table += SUBSYSTEM.pack(svid, sdid,
+                                                  pool.add(subsystems[(svid, sdid)]))
+                subsystem_count += 1
+
+    for cid in sorted(classes):
+        name, subclasses = classes[cid]
+        class_table += CLASS.pack(cid, 0, 0, pool.add(name),
+                                  subclass_count, len(subclasses))
+        for sid in sorted(subclasses):
+            name, progifs = subclasses[sid]
+            subclass_table += CLASS.pack(sid, 0, 0, pool.add(name),
+                                         progif_count, len(progifs))
+            subclass_count += 1
+            for pid in sorted(progifs):
+                progif_table += CLASS.pack(pid, 0, 0, pool.add(progifs[pid]), 0, 0)
+                progif_count += 1
+
+    vendor_offset = HEADER.size
+    device_offset = vendor_offset + len(vendor_table)
+    string_offset = device_offset + len(device_table)
+    subsystem_offset = string_offset + len(pool.data)
+    class_offset = subsystem_offset + len(subsystem_table)
+    subclass_offset = class_offset + len(class_table)
+    progif_offset = subclass_offset + len(subclass_table)
+
+    header = HEADER.pack(PCI_IDX_SIGNATURE, PCI_IDX_VERSION, HEADER.size,
+                         version_offset,
+                         len(vendors), vendor_offset,
+                         device_count, device_offset,
+                         len(pool.data), string_offset,
+                         subsystem_count, subsystem_offset,
+                         len(classes), class_offset,
+                         subclass_count, subclass_offset,
+                         progif_count, progif_offset)
+
+    return (header + vendor_table + device_table + pool.data +
+            subsystem_table + class_table + subclass_table + progif_table)
+
+
+def main(argv):
+    src = argv[1] if len(argv) > 1 else 'pci.ids'
+    dst = argv[2] if len(argv) > 2 else 'pci.idx'
+
+    with open(src, encoding='utf-8', errors='replace') as f:
+        version, vendors, classes = parse(f)
+
+    data = build(version, vendors, classes)
+    with open(dst, 'wb') as f:
+        f.write(data)
+
+    print('%s: %d vendors, %d classes, %d bytes' %
+          (dst, len(vendors), len(classes), len(data)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))